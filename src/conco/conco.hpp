@@ -1,10 +1,15 @@
 #pragma once
 
 #include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
 #include <span>
 #include <string_view>
 #include <tuple>
+#include <utility>
 
 #include "conco_tokenizer.hpp"
 
@@ -17,8 +22,25 @@ enum class result
 	argument_parsing_error, // One or more arguments could not be parsed
 	not_enough_arguments,   // Not enough arguments were provided for the command
 	no_matching_overload,   // Multiple overloads found, but none could be executed due to argument parsing errors
+	cannot_prepare,         // Command cannot be prepared (needs execution context or does not fit into the storage)
 };
 
+// Returns the name of a result value ("success", "command_not_found", ...)
+constexpr std::string_view to_string( result r ) noexcept
+{
+	switch ( r )
+	{
+		case result::success: return "success";
+		case result::command_not_found: return "command_not_found";
+		case result::argument_parsing_error: return "argument_parsing_error";
+		case result::not_enough_arguments: return "not_enough_arguments";
+		case result::no_matching_overload: return "no_matching_overload";
+		case result::cannot_prepare: return "cannot_prepare";
+	}
+
+	return {};
+}
+
 /**
  * Executes a command from the given command list based on the provided command line string.
  */
@@ -31,6 +53,55 @@ result execute( std::span<const struct command> commands,
                 std::string_view cmd_line,
                 std::span<char> output_buffer = {} );
 
+/**
+ * Executes a command from layered command tables, see `layered_commands`.
+ */
+result execute( const struct layered_commands &commands, std::string_view cmd_line, struct output &out );
+
+result execute( const struct layered_commands &commands,
+                std::string_view cmd_line,
+                std::span<char> output_buffer = {} );
+
+/**
+ * Executes a command line with `$name` and `${name}` references and `(cmd ...)` nested commands in arguments
+ * resolved from `variables`, see `variable_source`. Lines without `$` and `(` are executed as usual.
+ */
+result execute( std::span<const struct command> commands,
+                std::string_view cmd_line,
+                const struct variable_source &variables,
+                struct output &out );
+
+result execute( std::span<const struct command> commands,
+                std::string_view cmd_line,
+                const struct variable_source &variables,
+                std::span<char> output_buffer = {} );
+
+result execute( const struct layered_commands &commands,
+                std::string_view cmd_line,
+                const struct variable_source &variables,
+                struct output &out );
+
+result execute( const struct layered_commands &commands,
+                std::string_view cmd_line,
+                const struct variable_source &variables,
+                std::span<char> output_buffer = {} );
+
+/**
+ * Selects a command overload and parses its arguments into `storage`, without executing it.
+ * The result is a `prepared` invocation, which can be invoked later (any number of times).
+ *
+ * Nothing is allocated, the parsed arguments live in the user-provided `storage` (at most
+ * `descriptor::storage_size` bytes with `descriptor::storage_alignment`), which must outlive `p`.
+ *
+ * Returns `cannot_prepare` whenever `execute()` would try an overload which cannot be prepared (or does
+ * not fit into `storage`), such command lines have to be executed from text to keep their meaning.
+ */
+result prepare( std::span<const struct command> commands,
+                std::string_view cmd_line,
+                std::span<std::byte> storage,
+                struct prepared &p,
+                struct output &out );
+
 /**
  * Represents a single executable command.
  *
@@ -62,6 +133,45 @@ struct command final
 	  requires std::is_class_v<C>
 	command( C &callable, const char *n );
 
+	// Returns only the command name part, without argument names and description ("sum x y;..." -> "sum")
+	std::string_view name() const noexcept
+	{
+		size_t i = 0;
+		while ( name_and_args[i] && !tokenizer::is_ident_term( name_and_args[i] ) )
+			++i;
+
+		return { name_and_args, i };
+	}
+
+	// Returns the description block without leading tags ("sum x y;@math Sums two integers" -> "Sums two integers")
+	std::string_view description() const noexcept
+	{
+		std::string_view desc = description_block();
+		while ( !desc.empty() && desc[0] == '@' )
+		{
+			size_t end = desc.find( ' ' );
+			desc = ( end == std::string_view::npos ) ? std::string_view{} : desc.substr( end + 1 );
+		}
+
+		return desc;
+	}
+
+	// Checks whether the description block starts with the given `@tag` ("draw;@render @slow ..." has "render")
+	bool has_tag( std::string_view tag ) const noexcept
+	{
+		std::string_view desc = description_block();
+		while ( !desc.empty() && desc[0] == '@' )
+		{
+			size_t end = std::min( desc.find( ' ' ), desc.size() );
+			if ( desc.substr( 1, end - 1 ) == tag )
+				return true;
+
+			desc = desc.substr( std::min( end + 1, desc.size() ) );
+		}
+
+		return false;
+	}
+
 	// Compares only the command name part, ignoring optional argument names and description
 	bool operator==( std::string_view name ) const noexcept
 	{
@@ -73,6 +183,16 @@ struct command final
 	}
 
 private:
+	std::string_view description_block() const noexcept
+	{
+		// Skip name and argument names with default values, these can contain quoted semicolons
+		tokenizer tok( name_and_args );
+		while ( tok.next() )
+			;
+
+		return tok.next_char_is( ';' ) ? tok.text.substr( 1 ) : std::string_view{};
+	}
+
 	template <typename C>
 	command( const C &ctx, const descriptor &d, const char *n )
 	  : target( const_cast<C *>( &ctx ) ), desc( d ), name_and_args( n )
@@ -98,10 +218,284 @@ struct output
 	uint8_t arg_count = 0;             // Number of successfuly parsed arguments
 	bool not_enough_arguments = false; // Whether there were not enough arguments
 	bool result_error = false;         // Result stringification failed (does not mean execution failed!)
+	struct task_scheduler *scheduler = nullptr; // Runs commands returning `task<T>`, see `conco_task.hpp`
+	uint64_t task_id = 0;                       // Non-zero when the command continues as a scheduled task
+
+	// Nested command substitution (see `variable_source`): a result of `typed_result_type` is moved into
+	// `typed_result` instead of being stringified, `typed_result_type` is reset to `nullptr` then
+	const struct type_info *typed_result_type = nullptr;
+	void *typed_result = nullptr;
+	uint8_t nesting_depth = 0; // Nesting level of the executed command
 
 	bool has_error() const noexcept { return arg_error_mask || not_enough_arguments || result_error; }
 };
 
+/**
+ * Command invocation with already parsed arguments, created by `prepare()`.
+ *
+ * Invoking does not touch the command line anymore, which makes prepared invocations handy for
+ * commands parsed on one thread and executed on another one, or executed repeatedly. Commands
+ * taking `tokenizer &`, `output &` or `const context &` arguments cannot be prepared.
+ *
+ * Owns the parsed arguments (destroys them when reset), but not the memory they are stored in.
+ */
+struct prepared final
+{
+	const command *cmd = nullptr; // Prepared command overload, `nullptr` when empty
+	void *storage = nullptr;      // Parsed arguments (command-specific storage tuple)
+
+	prepared() = default;
+	prepared( const command &c, void *s ) noexcept : cmd( &c ), storage( s ) {}
+	prepared( prepared &&other ) noexcept : cmd( std::exchange( other.cmd, nullptr ) ), storage( other.storage ) {}
+	~prepared() { reset(); }
+
+	prepared &operator=( prepared &&other ) noexcept
+	{
+		if ( this != &other )
+		{
+			reset();
+			cmd = std::exchange( other.cmd, nullptr );
+			storage = other.storage;
+		}
+
+		return *this;
+	}
+
+	explicit operator bool() const noexcept { return cmd != nullptr; }
+
+	// Executes the prepared command, stringified result is written into `out.buffer`
+	result invoke( output &out );
+	result invoke( std::span<char> output_buffer = {} );
+
+	// Destroys the parsed arguments
+	void reset() noexcept;
+};
+
+/**
+ * Single layer of a `layered_commands` view - a span of commands with optional accelerated lookup.
+ */
+struct command_layer
+{
+	using iterator = std::span<const command>::iterator;
+	using find_func_t = iterator ( * )( const void *index, std::span<const command> commands, std::string_view name );
+
+	std::span<const command> commands;
+	const void *index = nullptr;     // Lookup structure for `find_func` (e.g. `command_index`)
+	find_func_t find_func = nullptr; // Returns the first overload or `commands.end()`, linear search when `nullptr`
+
+	command_layer() = default;
+
+	// Accepts anything convertible to a command span (arrays, vectors...)
+	template <typename R>
+	  requires std::is_convertible_v<R &&, std::span<const command>>
+	command_layer( R &&c, const void *i = nullptr, find_func_t f = nullptr ) noexcept
+	  : commands( std::forward<R>( c ) ), index( i ), find_func( f )
+	{}
+
+	iterator find( std::string_view name ) const noexcept
+	{
+		if ( find_func )
+			return find_func( index, commands, name );
+
+		return std::ranges::find_if( commands, [&]( const command &cmd ) { return cmd == name; } );
+	}
+};
+
+/**
+ * Read-only view over several command tables (layers), without copying them.
+ *
+ * Layers are ordered from the top-most one, lookup goes down the stack and the first layer containing
+ * a command wins - all overloads of that command come from this layer, lower layers are shadowed.
+ * Iterating over the view yields only visible (not shadowed) commands, layer by layer.
+ *
+ * Example:
+ *   const conco::command_layer layers[] = { session_overrides, module_commands, global_commands };
+ *   conco::execute( conco::layered_commands( layers ), "cmd 1 2", out );
+ */
+struct layered_commands
+{
+	layered_commands() = default;
+	layered_commands( std::span<const command> commands ) noexcept : _single( commands ) {}
+	explicit layered_commands( std::span<const command_layer> layers ) noexcept : _layers( layers ) {}
+
+	size_t layer_count() const noexcept { return _layers.empty() ? 1 : _layers.size(); }
+	const command_layer &layer( size_t i ) const noexcept { return _layers.empty() ? _single : _layers[i]; }
+
+	// Finds the top-most layer containing the command, `iter` points to the first overload
+	struct lookup
+	{
+		std::span<const command> commands; // Commands of the found layer (all of them, not only overloads)
+		command_layer::iterator iter;      // `commands.end()` when not found
+	};
+
+	lookup find( std::string_view name ) const noexcept
+	{
+		for ( size_t i = 0; i < layer_count(); ++i )
+		{
+			const command_layer &l = layer( i );
+			if ( auto iter = l.find( name ); iter != l.commands.end() )
+				return { l.commands, iter };
+		}
+
+		std::span<const command> none;
+		return { none, none.end() };
+	}
+
+	// Whether the command from layer `layer_index` is hidden by a layer above it (one lookup per layer above)
+	bool is_shadowed( const command &cmd, size_t layer_index ) const noexcept
+	{
+		std::string_view name = cmd.name();
+		for ( size_t i = 0; i < layer_index; ++i )
+			if ( layer( i ).find( name ) != layer( i ).commands.end() )
+				return true;
+
+		return false;
+	}
+
+	struct iterator
+	{
+		const layered_commands *view = nullptr;
+		size_t layer = 0;
+		size_t index = 0;
+		const command *checked = nullptr; // Last command checked for shadowing, its overloads share the result
+		bool checked_shadowed = false;
+
+		const command &operator*() const noexcept { return view->layer( layer ).commands[index]; }
+		const command *operator->() const noexcept { return &**this; }
+		bool operator==( const iterator &other ) const noexcept { return layer == other.layer && index == other.index; }
+
+		iterator &operator++() noexcept
+		{
+			++index;
+			skip();
+			return *this;
+		}
+
+		// Moves to the next visible command (or to the end)
+		void skip() noexcept
+		{
+			while ( layer < view->layer_count() )
+			{
+				if ( index >= view->layer( layer ).commands.size() )
+				{
+					++layer;
+					index = 0;
+					checked = nullptr;
+					continue;
+				}
+
+				// Overloads next to each other are looked up only once
+				const command &cmd = **this;
+				if ( !checked || *checked != cmd.name() )
+				{
+					checked = &cmd;
+					checked_shadowed = view->is_shadowed( cmd, layer );
+				}
+
+				if ( !checked_shadowed )
+					break;
+
+				++index;
+			}
+		}
+	};
+
+	iterator begin() const noexcept
+	{
+		iterator iter = { this, 0, 0 };
+		iter.skip();
+		return iter;
+	}
+
+	iterator end() const noexcept { return { this, layer_count(), 0 }; }
+
+	bool empty() const noexcept { return begin() == end(); }
+
+private:
+	command_layer _single;                  // Used when constructed from a single span
+	std::span<const command_layer> _layers; // External layers, top-most first
+};
+
+/**
+ * Source of variables for `$name` and `${name}` references in command arguments.
+ *
+ * References are resolved while the arguments are parsed, the command line is never copied. An argument
+ * which is a single reference gets the typed value of the variable when `value_func` provides it for the
+ * argument storage type, or the variable text otherwise. Arguments mixing text and references (`unit_$id`,
+ * `"hello ${name}!"`) are assembled in a small buffer. Single-quoted arguments and `\$` are left as-is.
+ *
+ * Arguments `(cmd ...)` and `$(cmd ...)` are nested commands, executed with the same commands and variables.
+ * When a nested command returns the storage type of the argument, its result is passed as it is, other
+ * results are stringified and parsed. A default-constructed source has no variables, only nested commands.
+ * Each nested command is executed once per command line, all overload attempts share its result.
+ *
+ * Example:
+ *   conco::execute( commands, "spawn $unit_type $pos", cvars.variables() );
+ *   conco::execute( commands, "sum (mul 2 3) $(sum 1 2)", conco::variable_source() );
+ */
+struct variable_source
+{
+	// Returns a view of the variable text (valid during the execution) or writes it into `buffer` and returns
+	// a view of it, `std::nullopt` when the variable does not exist or does not fit
+	using text_func_t = token ( * )( const void *source, std::string_view name, std::span<char> buffer );
+
+	// Copies the variable into `value` when its type is `ti`, returns false otherwise
+	using value_func_t = bool ( * )( const void *source,
+	                                 std::string_view name,
+	                                 const struct type_info *ti,
+	                                 void *value );
+
+	const void *source = nullptr;
+	text_func_t text_func = nullptr;
+	value_func_t value_func = nullptr; // Optional
+};
+
+/**
+ * Results of nested commands in arguments of a single command line, shared by all overload attempts.
+ *
+ * Results of a trivially copyable argument storage type are kept as values, other results as text in
+ * the interpolation buffer. When all entries are taken, further nested commands are executed per attempt.
+ */
+struct nested_results
+{
+	static constexpr size_t capacity = 8;
+	static constexpr size_t value_size = 32;
+
+	// Stringifies a cached value into the buffer, returns the text length (0 = failed)
+	using to_text_func_t = size_t ( * )( const void *value, std::span<char> buffer );
+
+	struct entry
+	{
+		const char *arg = nullptr;              // Argument token in the command line
+		token text = std::nullopt;              // Stringified result, `std::nullopt` when typed or failed
+		const struct type_info *type = nullptr; // Type of `value`, `nullptr` when not typed
+		to_text_func_t to_text = nullptr;       // Stringifies `value` for arguments of other types
+		alignas( std::max_align_t ) std::byte value[value_size] = {};
+	};
+
+	entry entries[capacity] = {};
+	size_t count = 0;
+	std::span<char> buffer = {}; // Interpolation buffer space not taken by cached text
+
+	entry *find( std::string_view arg ) noexcept
+	{
+		for ( size_t i = 0; i < count; ++i )
+			if ( entries[i].arg == arg.data() )
+				return &entries[i];
+
+		return nullptr;
+	}
+
+	entry *add( std::string_view arg ) noexcept
+	{
+		if ( count == capacity )
+			return nullptr;
+
+		entries[count].arg = arg.data();
+		return &entries[count++];
+	}
+};
+
 /**
  * Encapsulates all the context needed for command execution.
  *
@@ -111,28 +505,66 @@ struct output
  */
 struct context final
 {
-	std::span<const command> commands; // All available commands (as provided to `execute()`)
+	layered_commands commands;         // All available commands (as provided to `execute()`)
 	std::string_view raw_command_line; // Command line text buffer from the user
 	std::string_view command_name;     // Command name (first token)
 	tokenizer args;                    // Tokenizer for command arguments
 	tokenizer default_args;            // Tokenizer for default arguments (if any)
 	output &out;                       // Result of the command execution
+	struct binary_reader *binary_args = nullptr; // Binary encoded arguments, used instead of `args` when set
+	token named_args = std::nullopt; // Key-value list (`x=1 y=2` or `"x": 1, "y": 2`), used instead of `args` when set
+	const variable_source *variables = nullptr; // Resolves `$name` references in `raw_command_line` arguments
+	std::span<char> interpolation_buffer = {};  // Remaining space for assembled arguments, see `variable_source`
+	nested_results *nested = nullptr;           // Results of nested commands, shared by overload attempts
 
-	token next_arg_value() noexcept
+	token next_default_value( token *arg_name = nullptr ) noexcept
 	{
 		token default_value = std::nullopt;
-		if ( default_args.next() ) // Consume optional argument name
+		if ( token name = default_args.next(); name ) // Consume optional argument name
 		{
+			if ( arg_name )
+				*arg_name = name;
+
 			if ( default_args.try_consume_assignment() )
 				default_value = default_args.next();
 		}
 
-		token arg = args.next();
+		return default_value;
+	}
+
+	token next_arg_value() noexcept
+	{
+		token arg_name = std::nullopt;
+		token default_value = next_default_value( &arg_name );
+
+		token arg = named_args ? find_named_arg( arg_name ) : args.next();
 		if ( !arg && default_value )
 			arg = default_value;
 
 		return arg;
 	}
+
+	token find_named_arg( token name ) const noexcept
+	{
+		if ( !name )
+			return std::nullopt;
+
+		tokenizer tok( *named_args );
+		while ( token key = tok.next() )
+		{
+			if ( !tok.try_consume_assignment() )
+				break;
+
+			token value = tok.next();
+			if ( !value )
+				break;
+
+			if ( *key == *name )
+				return value;
+		}
+
+		return std::nullopt;
+	}
 };
 
 /**
@@ -146,12 +578,23 @@ struct type_info
 {
 	std::string_view name = {};                       // "int", "optional", "vector", "my_struct", etc.
 	const type_info *const inner_type_info = nullptr; // Pointer to inner type info, if any (usually the <T> type)
+	std::span<const std::string_view> keywords = {};  // All accepted values of keyword-like types (bool, enums)
 
 	// Gets the `type_info` instance for the given type `T`. `void` type results in `nullptr`.
 	template <typename T>
 	static constexpr const type_info *const get() noexcept;
 };
 
+/**
+ * How a command accesses its `command::target` object when invoked.
+ */
+enum class target_access : uint8_t
+{
+	none,      // Free function, there is no target object
+	shared,    // Const method or callable object, can run concurrently with other shared accesses
+	exclusive, // Non-const method or callable object, modifies the target
+};
+
 /**
  * Holds runtime information about the command function or method.
  *
@@ -164,21 +607,39 @@ struct descriptor final
 	using invoker_func_t = bool ( * )( struct context & );
 	invoker_func_t invoker = nullptr;
 
+	// Prepared invocation support, see `prepare()`. Arguments are parsed into a command-specific storage
+	// of `storage_size` bytes, `preparer` is `nullptr` for commands that cannot be prepared.
+	using preparer_func_t = bool ( * )( struct context &, void *storage );
+	using prepared_invoker_func_t = bool ( * )( struct context &, void *storage );
+	using destroyer_func_t = void ( * )( void *storage );
+	preparer_func_t preparer = nullptr;
+	prepared_invoker_func_t prepared_invoker = nullptr;
+	destroyer_func_t destroyer = nullptr;
+	uint32_t storage_size = 0;
+	uint32_t storage_alignment = 0;
+
 	std::span<const type_info *const> arg_type_infos;
 	const type_info *result_type_info = nullptr;
 
 	uint8_t arg_count = 0;      // Number of real (program) arguments
 	bool has_tail_args = false; // Whether the last argument is a tokenizer for variadic tail arguments
+	target_access access = target_access::none;
 
 	template <typename I, typename Traits = typename I::traits>
 	static const descriptor &get()
 	{
 		static const descriptor desc = { .invoker = &I::call,
+			                               .preparer = Traits::is_preparable ? &I::prepare : nullptr,
+			                               .prepared_invoker = &I::call_prepared,
+			                               .destroyer = &I::destroy,
+			                               .storage_size = sizeof( typename I::storage_type ),
+			                               .storage_alignment = alignof( typename I::storage_type ),
 			                               // Explicitly construct span with `arg_count` to trim the dummy element
 			                               .arg_type_infos = { Traits::arg_type_infos, Traits::arg_count },
 			                               .result_type_info = Traits::result_type_info,
 			                               .arg_count = Traits::arg_count,
-			                               .has_tail_args = Traits::has_tail_args };
+			                               .has_tail_args = Traits::has_tail_args,
+			                               .access = I::access };
 
 		return desc;
 	}
@@ -210,60 +671,419 @@ struct type_mapper
 	 */
 	using inner_type = void;
 
-	/**
-	 * The storage type used during argument parsing and invocation.
-	 * This is where the parsed argument "lives" before being forwarded into the command function.
-	 */
-	using storage_type = std::remove_cvref_t<T>;
+	/**
+	 * The storage type used during argument parsing and invocation.
+	 * This is where the parsed argument "lives" before being forwarded into the command function.
+	 */
+	using storage_type = std::remove_cvref_t<T>;
+
+	/**
+	 * Converts the stored argument value into the type expected by the command function.
+	 * For generic types, this is just an identity function. Special types can do more complex
+	 * conversions at this point (e.g., forward `std::vector<T>` storage into `std::span<T>`).
+	 */
+	static T map( storage_type &value ) noexcept { return static_cast<T>( value ); }
+};
+
+// Fallback specialization for `void` type - no storage, no forwarding
+template <>
+struct type_mapper<void>
+{
+	using inner_type = void;
+};
+
+/**
+ * Provides a human-friendly name for a specified type.
+ * This is used to fill `type_info` structures at compile-time.
+ */
+constexpr std::string_view type_name( auto ) noexcept
+{
+	return std::string_view(); // Empty fallback for unknown types
+}
+
+/**
+ * Lists all accepted string values of a keyword-like type (e.g. enum names), used for completion.
+ */
+constexpr std::span<const std::string_view> type_keywords( auto ) noexcept
+{
+	return {}; // Empty fallback for non-keyword types
+}
+
+template <typename T>
+inline static constexpr const type_info *const type_info::get() noexcept
+{
+	static constexpr const type_info ti = { .name = type_name( tag<T>{} ),
+		                                      .inner_type_info = []() noexcept -> const type_info * {
+		                                        using inner_type = typename type_mapper<T>::inner_type;
+
+		                                        if constexpr ( std::is_same_v<inner_type, void> == false )
+			                                        return type_info::get<typename type_mapper<T>::inner_type>();
+		                                        else
+			                                        return nullptr;
+		                                      }(),
+		                                      .keywords = type_keywords( tag<T>{} ) };
+
+	return &ti;
+}
+
+} // namespace conco
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco::detail {
+
+constexpr bool is_variable_char( char ch ) noexcept
+{
+	return ( ch >= 'a' && ch <= 'z' ) || ( ch >= 'A' && ch <= 'Z' ) || ( ch >= '0' && ch <= '9' ) || ch == '_';
+}
+
+// Length of a `$name` or `${name}` reference at the start of `text` (0 = not a reference), sets `name`
+inline size_t parse_variable_reference( std::string_view text, std::string_view &name ) noexcept
+{
+	if ( text.size() < 2 || text[0] != '$' )
+		return 0;
+
+	if ( text[1] == '{' )
+	{
+		size_t end = text.find( '}', 2 );
+		if ( end == std::string_view::npos || end == 2 )
+			return 0;
+
+		name = text.substr( 2, end - 2 );
+		return end + 1;
+	}
+
+	size_t end = 1;
+	while ( end < text.size() && is_variable_char( text[end] ) )
+		++end;
+
+	name = text.substr( 1, end - 1 );
+	return end > 1 ? end : 0;
+}
+
+// Whether an argument token contains references or a nested command (fast path for lines without any)
+inline bool needs_interpolation( const context &ctx, std::string_view arg ) noexcept
+{
+	// Default values and other tokens from outside of the command line are never interpolated
+	const char *line = ctx.raw_command_line.data();
+	if ( !ctx.variables || arg.data() <= line || arg.data() > line + ctx.raw_command_line.size() )
+		return false;
+
+	return arg.data()[-1] != '\'' && ( arg.starts_with( '(' ) || arg.find( '$' ) != std::string_view::npos );
+}
+
+// Command line of a `(cmd ...)` or `$(cmd ...)` argument
+inline token nested_command( std::string_view arg ) noexcept
+{
+	size_t open = arg.starts_with( "$(" ) ? 1 : 0;
+	if ( !arg.substr( open ).starts_with( '(' ) || open + tokenizer::group_length( arg.substr( open ) ) != arg.size() )
+		return std::nullopt;
+
+	return arg.substr( open + 1, arg.size() - open - 2 );
+}
+
+// Stringified result without the quotes of a string
+inline std::string_view result_text( std::string_view text ) noexcept
+{
+	if ( text.size() >= 2 && text.front() == '"' && text.back() == '"' )
+		return text.substr( 1, text.size() - 2 );
+
+	return text;
+}
+
+// Executes a nested command, stringified result is written into `out.buffer` (without quotes of strings)
+inline token substitute( const context &ctx, std::string_view cmd_line, output &out ) noexcept
+{
+	static constexpr uint8_t max_nesting_depth = 16;
+
+	bool typed = out.typed_result_type != nullptr;
+	out.nesting_depth = ctx.out.nesting_depth + 1;
+
+	if ( out.nesting_depth > max_nesting_depth ||
+	     execute( ctx.commands, cmd_line, *ctx.variables, out ) != result::success )
+		return std::nullopt;
+
+	if ( typed && !out.typed_result_type )
+		return std::string_view(); // Passed as a typed value
+
+	if ( out.buffer.empty() || out.result_error )
+		return std::nullopt;
+
+	size_t size = static_cast<size_t>( std::ranges::find( out.buffer, '\0' ) - out.buffer.begin() );
+	return result_text( std::string_view( out.buffer.data(), size ) );
+}
+
+// Marks the end of `text` written into `buffer` as used
+inline void consume( std::span<char> &buffer, std::string_view text ) noexcept
+{
+	if ( text.data() >= buffer.data() && text.data() < buffer.data() + buffer.size() )
+		buffer = buffer.subspan( static_cast<size_t>( text.data() + text.size() - buffer.data() ) );
+}
+
+// Resolves references and nested commands in an argument. A single reference is returned as the variable text,
+// only arguments mixing text and references are assembled in `context::interpolation_buffer`.
+inline token interpolate( context &ctx, std::string_view arg ) noexcept
+{
+	const variable_source &vars = *ctx.variables;
+	std::span<char> &buffer = ctx.interpolation_buffer;
+	std::string_view name;
+
+	// Text of `$name`, `${name}` or `$(cmd ...)` at the start of `ref`, written into `space` or kept by the source
+	auto resolve = [&]( std::string_view ref, size_t length, std::span<char> space ) -> token {
+		if ( ref[1] == '(' )
+		{
+			output out = { space };
+			out.nesting_depth = ctx.out.nesting_depth;
+			return substitute( ctx, ref.substr( 2, length - 3 ), out );
+		}
+
+		return vars.text_func ? vars.text_func( vars.source, name, space ) : std::nullopt;
+	};
+
+	// Length of a reference at the start of `ref`, 0 = not a reference
+	auto reference_length = [&]( std::string_view ref ) -> size_t {
+		if ( ref.starts_with( "$(" ) )
+		{
+			size_t length = tokenizer::group_length( ref.substr( 1 ) );
+			return length != std::string_view::npos ? length + 1 : 0;
+		}
+
+		return parse_variable_reference( ref, name );
+	};
+
+	if ( reference_length( arg ) == arg.size() )
+	{
+		token text = resolve( arg, arg.size(), buffer );
+		if ( text )
+			consume( buffer, *text );
+
+		return text;
+	}
+
+	size_t size = 0;
+	auto append = [&]( std::string_view part ) {
+		if ( size + part.size() > buffer.size() )
+			return false;
+
+		// Text written by `text_func` may already be in place
+		if ( part.data() != buffer.data() + size )
+			std::copy( part.begin(), part.end(), buffer.data() + size );
+
+		size += part.size();
+		return true;
+	};
+
+	while ( !arg.empty() )
+	{
+		size_t pos = std::min( arg.find( '$' ), arg.size() );
+		bool escaped = pos > 0 && pos < arg.size() && arg[pos - 1] == '\\';
+
+		if ( !append( arg.substr( 0, pos - escaped ) ) )
+			return std::nullopt;
+
+		arg.remove_prefix( pos );
+		if ( arg.empty() )
+			break;
+
+		size_t length = escaped ? 0 : reference_length( arg );
+		if ( length == 0 )
+		{
+			if ( !append( "$" ) )
+				return std::nullopt;
+
+			arg.remove_prefix( 1 );
+			continue;
+		}
+
+		token text = resolve( arg, length, buffer.subspan( size ) );
+		if ( !text || !append( *text ) )
+			return std::nullopt;
+
+		arg.remove_prefix( length );
+	}
+
+	token result = std::string_view( buffer.data(), size );
+	buffer = buffer.subspan( size );
+	return result;
+}
+
+// Interpolated text of an argument, arguments with nested commands are interpolated once per command line
+inline token interpolate_once( context &ctx, std::string_view arg ) noexcept
+{
+	if ( !ctx.nested || arg.find( "$(" ) == std::string_view::npos )
+		return interpolate( ctx, arg );
+
+	if ( nested_results::entry *e = ctx.nested->find( arg ) )
+		return e->text;
+
+	token text = interpolate( ctx, arg );
+	ctx.nested->buffer = ctx.interpolation_buffer; // Keep the text for other overloads
+
+	if ( nested_results::entry *e = ctx.nested->add( arg ) )
+		e->text = text;
+
+	return text;
+}
+
+// Stringifies a cached nested command result of type `S`
+template <typename S>
+size_t value_to_text( const void *value, std::span<char> buffer ) noexcept
+{
+	if constexpr ( requires( const S &v ) { to_chars( tag<S>{}, buffer, v ); } )
+		return buffer.empty() ? 0 : to_chars( tag<S>{}, buffer, *static_cast<const S *>( value ) );
+	else
+		return 0;
+}
+
+// Result of a nested command argument, executed only once per command line (see `nested_results`).
+// Sets `typed` when the result was stored in `value`, returns its text otherwise.
+template <typename S>
+token nested_result( context &ctx, std::string_view arg, std::string_view cmd_line, S &value, bool &typed ) noexcept
+{
+	constexpr bool cacheable = std::is_trivially_copyable_v<S> && sizeof( S ) <= nested_results::value_size &&
+	                           alignof( S ) <= alignof( std::max_align_t );
+
+	nested_results *results = ctx.nested;
+	nested_results::entry *e = results ? results->find( arg ) : nullptr;
+
+	// Text written into the interpolation buffer is kept for other overloads
+	auto keep_text = [&]( std::string_view text ) {
+		consume( ctx.interpolation_buffer, text );
+		if ( results )
+			results->buffer = ctx.interpolation_buffer;
+
+		return text;
+	};
+
+	auto stringify = [&]( size_t length ) -> token {
+		return length ? token( keep_text( result_text( { ctx.interpolation_buffer.data(), length } ) ) )
+		              : std::nullopt;
+	};
+
+	if ( !e )
+	{
+		output out = { ctx.interpolation_buffer };
+		out.typed_result_type = type_info::get<S>();
+		out.typed_result = &value;
+		out.nesting_depth = ctx.out.nesting_depth;
+
+		token text = substitute( ctx, cmd_line, out );
+		typed = text && !out.typed_result_type;
+
+		if ( !typed )
+		{
+			if ( text )
+				keep_text( *text );
+
+			if ( results && ( e = results->add( arg ) ) )
+				e->text = text;
+		}
+		else if constexpr ( cacheable )
+		{
+			if ( results && ( e = results->add( arg ) ) )
+			{
+				e->type = type_info::get<S>();
+				e->to_text = value_to_text<S>;
+				std::memcpy( e->value, &value, sizeof( S ) );
+			}
+		}
+		else if ( results ) // Other overloads get the result as text
+		{
+			if ( token kept = stringify( value_to_text<S>( &value, ctx.interpolation_buffer ) ) )
+				if ( ( e = results->add( arg ) ) )
+					e->text = kept;
+		}
+
+		return text;
+	}
 
-	/**
-	 * Converts the stored argument value into the type expected by the command function.
-	 * For generic types, this is just an identity function. Special types can do more complex
-	 * conversions at this point (e.g., forward `std::vector<T>` storage into `std::span<T>`).
-	 */
-	static T map( storage_type &value ) noexcept { return static_cast<T>( value ); }
-};
+	if constexpr ( cacheable )
+	{
+		if ( ( typed = e->type == type_info::get<S>() ) )
+		{
+			std::memcpy( &value, e->value, sizeof( S ) );
+			return std::string_view();
+		}
+	}
 
-// Fallback specialization for `void` type - no storage, no forwarding
-template <>
-struct type_mapper<void>
-{
-	using inner_type = void;
-};
+	// Typed result of another type is stringified on first use
+	if ( !e->text && e->to_text )
+		e->text = stringify( e->to_text( e->value, ctx.interpolation_buffer ) );
 
-/**
- * Provides a human-friendly name for a specified type.
- * This is used to fill `type_info` structures at compile-time.
- */
-constexpr std::string_view type_name( auto ) noexcept
-{
-	return std::string_view(); // Empty fallback for unknown types
+	return e->text;
 }
 
-template <typename T>
-inline static constexpr const type_info *const type_info::get() noexcept
+// Parses an argument token into its storage type, resolving variable references and nested commands first
+template <typename S>
+std::optional<S> parse_arg( context &ctx, std::string_view arg ) noexcept
 {
-	static constexpr const type_info ti = { .name = type_name( tag<T>{} ),
-		                                      .inner_type_info = []() noexcept -> const type_info * {
-		                                        using inner_type = typename type_mapper<T>::inner_type;
+	if ( needs_interpolation( ctx, arg ) )
+	{
+		const variable_source &vars = *ctx.variables;
+		std::string_view name;
+		S value{};
 
-		                                        if constexpr ( std::is_same_v<inner_type, void> == false )
-			                                        return type_info::get<typename type_mapper<T>::inner_type>();
-		                                        else
-			                                        return nullptr;
-		                                      }() };
+		// Typed value of a single reference or nested command, no text round trip
+		if ( token cmd_line = nested_command( arg ) )
+		{
+			bool typed = false;
+			token text = nested_result( ctx, arg, *cmd_line, value, typed );
+			if ( !text )
+				return std::nullopt;
 
-	return &ti;
+			if ( typed )
+				return value;
+
+			arg = *text;
+		}
+		else if ( vars.value_func && parse_variable_reference( arg, name ) == arg.size() &&
+		          vars.value_func( vars.source, name, type_info::get<S>(), &value ) )
+			return value;
+		else if ( token text = interpolate_once( ctx, arg ); text )
+			arg = *text;
+		else
+			return std::nullopt;
+	}
+
+	return from_string( tag<S>{}, arg );
 }
 
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+/**
+ * Storage types which can be decoded from binary arguments (see `conco_binary.hpp`) - types with
+ * `from_binary()` overloads, or `from_string()` overloads for values sent as binary strings.
+ */
+template <typename S>
+concept binary_decodable = requires( const struct binary_value &value ) { from_binary( tag<S>{}, value ); } ||
+                           requires( std::string_view text ) { from_string( tag<S>{}, text ); };
+
 template <typename T, typename S = typename type_mapper<T>::storage_type>
 static S parse( tag<T>, context &ctx ) noexcept
 {
+	if ( ctx.binary_args )
+	{
+		S out{};
+		if constexpr ( binary_decodable<S> )
+		{
+			if ( !decode_binary_arg( tag<S>{}, ctx, out ) )
+				ctx.out.not_enough_arguments = true;
+		}
+		else
+			ctx.out.not_enough_arguments = true;
+
+		return out;
+	}
+
 	if ( token arg = ctx.next_arg_value(); arg )
 	{
 		++ctx.out.arg_count;
 
-		if ( auto parsed_opt = from_string( tag<S>{}, *arg ); parsed_opt )
+		if ( auto parsed_opt = detail::parse_arg<S>( ctx, *arg ); parsed_opt )
 			return *parsed_opt;
 
 		ctx.out.arg_error_mask |= static_cast<uint32_t>( 1u << ( ctx.out.arg_count - 1 ) );
@@ -326,6 +1146,12 @@ struct command_traits<RT( Args... )>
 
 	static constexpr bool has_tail_args = ( std::is_same_v<std::remove_cvref_t<Args>, tokenizer> || ... || false );
 
+	// Arguments referring to the execution context cannot outlive it, such commands cannot be prepared
+	static constexpr bool is_preparable = !( ( std::is_same_v<std::remove_cvref_t<Args>, tokenizer> ||
+	                                           std::is_same_v<std::remove_cvref_t<Args>, output> ||
+	                                           std::is_same_v<std::remove_cvref_t<Args>, context> ) ||
+	                                         ... || false );
+
 	static constexpr const type_info *const arg_type_infos[sizeof...( Args ) + 1] = {
 		type_info::get<std::remove_cvref_t<Args>>()..., {} // Dummy +1 so the array is not empty
 	};
@@ -363,6 +1189,23 @@ args_tuple_t<Args...> make_args_tuple( context &ctx, storage_tuple_t<Args...> &s
 	}( std::make_index_sequence<sizeof...( Args )>{} );
 }
 
+// Moves the result of a nested command into `output::typed_result` when it has the expected type
+template <typename T>
+bool store_typed_result( output &out, T &r ) noexcept( std::is_nothrow_move_assignable_v<T> )
+{
+	if constexpr ( std::is_move_assignable_v<T> )
+	{
+		if ( out.typed_result_type && out.typed_result_type == type_info::get<T>() )
+		{
+			*static_cast<T *>( out.typed_result ) = std::move( r );
+			out.typed_result_type = nullptr;
+			return true;
+		}
+	}
+
+	return false;
+}
+
 // Applies given tuple of arguments to the callable (function/method) and handles result stringification
 template <typename RT>
 static void apply( context &ctx, auto &callable, auto &&args_tuple )
@@ -378,18 +1221,28 @@ static void apply( context &ctx, auto &callable, auto &&args_tuple )
 	else
 	{
 		auto r = std::apply( callable, args_tuple );
-		if ( !ctx.out.buffer.empty() )
+
+		// Results which are not simply stringified (like `task<T>`) provide their own `handle_result()`
+		if constexpr ( requires { handle_result( tag<RT>{}, ctx, std::move( r ) ); } )
+			handle_result( tag<RT>{}, ctx, std::move( r ) );
+		else if ( store_typed_result( ctx.out, r ) )
+			return;
+		else if ( !ctx.out.buffer.empty() )
 			ctx.out.result_error = ( to_chars( tag<RT>{}, ctx.out.buffer, r ) == 0 );
 	}
 }
 
-template <typename F>
-struct function_invoker;
-
-template <typename RT, typename... Args>
-struct function_invoker<RT ( * )( Args... )> : command_traits<RT( Args... )>
+/**
+ * Common part of all invokers - parses arguments, maps them and calls the target.
+ *
+ * `Target` is the concrete invoker type, providing `call_target( void *target, args... )` which
+ * forwards the arguments into a function, a callable object or a method.
+ */
+template <typename Target, typename RT, typename... Args>
+struct invoker_base : command_traits<RT( Args... )>
 {
 	using traits = command_traits<RT( Args... )>;
+	using storage_type = storage_tuple_t<Args...>;
 
 	static bool call( context &ctx )
 	{
@@ -397,102 +1250,84 @@ struct function_invoker<RT ( * )( Args... )> : command_traits<RT( Args... )>
 		if ( ctx.out.has_error() )
 			return false;
 
+		return invoke( ctx, storage_tuple );
+	}
+
+	// Parses arguments into a storage tuple constructed in-place at `storage`
+	static bool prepare( context &ctx, void *storage )
+	{
+		auto *storage_tuple = new ( storage ) storage_type( make_storage_tuple<Args...>( ctx ) );
+		if ( !ctx.out.has_error() )
+			return true;
+
+		storage_tuple->~storage_type();
+		return false;
+	}
+
+	static bool call_prepared( context &ctx, void *storage )
+	{
+		return invoke( ctx, *static_cast<storage_type *>( storage ) );
+	}
+
+	static void destroy( void *storage ) noexcept { static_cast<storage_type *>( storage )->~storage_type(); }
+
+	static bool invoke( context &ctx, storage_type &storage_tuple )
+	{
 		auto args_tuple = make_args_tuple<Args...>( ctx, storage_tuple );
 		if ( ctx.out.has_error() )
 			return false;
 
-		auto *target = static_cast<RT ( * )( Args... )>( ctx.out.cmd->target );
-
-		if constexpr ( std::is_void_v<RT> )
-		{
-			auto callable = [target]( auto &&...args ) { target( std::forward<decltype( args )>( args )... ); };
-			apply<RT>( ctx, callable, std::move( args_tuple ) );
-		}
-		else
-		{
-			auto callable = [target]( auto &&...args ) -> RT { return target( std::forward<decltype( args )>( args )... ); };
-			apply<RT>( ctx, callable, std::move( args_tuple ) );
-		}
+		auto callable = [target = ctx.out.cmd->target]( auto &&...args ) -> RT {
+			return Target::call_target( target, std::forward<decltype( args )>( args )... );
+		};
 
+		apply<RT>( ctx, callable, std::move( args_tuple ) );
 		return true;
 	}
 };
 
-template <typename C, typename F>
-struct callable_invoker_impl;
+template <typename F>
+struct function_invoker;
 
-template <typename C, typename RT, typename... Args>
-struct callable_invoker_impl<C, RT( Args... )> : command_traits<RT( Args... )>
+template <typename RT, typename... Args>
+struct function_invoker<RT ( * )( Args... )> : invoker_base<function_invoker<RT ( * )( Args... )>, RT, Args...>
 {
-	using traits = command_traits<RT( Args... )>;
+	static constexpr target_access access = target_access::none;
 
-	static bool call( context &ctx )
+	static RT call_target( void *target, auto &&...args )
 	{
-		auto storage_tuple = make_storage_tuple<Args...>( ctx );
-		if ( ctx.out.has_error() )
-			return false;
-
-		auto args_tuple = make_args_tuple<Args...>( ctx, storage_tuple );
-		if ( ctx.out.has_error() )
-			return false;
-
-		auto *target = static_cast<C *>( ctx.out.cmd->target );
+		return static_cast<RT ( * )( Args... )>( target )( std::forward<decltype( args )>( args )... );
+	}
+};
 
-		if constexpr ( std::is_void_v<RT> )
-		{
-			auto callable = [target]( auto &&...args ) { ( *target )( std::forward<decltype( args )>( args )... ); };
-			apply<RT>( ctx, callable, std::move( args_tuple ) );
-		}
-		else
-		{
-			auto callable = [target]( auto &&...args ) -> RT {
-				return ( *target )( std::forward<decltype( args )>( args )... );
-			};
-			apply<RT>( ctx, callable, std::move( args_tuple ) );
-		}
+template <typename C, typename F>
+struct callable_invoker_impl;
 
-		return true;
+template <typename C, typename RT, typename... Args>
+struct callable_invoker_impl<C, RT( Args... )> : invoker_base<callable_invoker_impl<C, RT( Args... )>, RT, Args...>
+{
+	static RT call_target( void *target, auto &&...args )
+	{
+		return ( *static_cast<C *>( target ) )( std::forward<decltype( args )>( args )... );
 	}
 };
 
 template <typename C>
 struct callable_invoker : callable_invoker_impl<C, typename signature_helper<decltype( &C::operator() )>::type>
-{};
+{
+	static constexpr target_access access =
+	  signature_helper<decltype( &C::operator() )>::is_const ? target_access::shared : target_access::exclusive;
+};
 
 template <typename C, auto M, typename F>
 struct method_invoker_impl;
 
 template <typename C, auto M, typename RT, typename... Args>
-struct method_invoker_impl<C, M, RT( Args... )> : command_traits<RT( Args... )>
+struct method_invoker_impl<C, M, RT( Args... )> : invoker_base<method_invoker_impl<C, M, RT( Args... )>, RT, Args...>
 {
-	using traits = command_traits<RT( Args... )>;
-
-	static bool call( context &ctx )
+	static RT call_target( void *target, auto &&...args )
 	{
-		auto storage_tuple = make_storage_tuple<Args...>( ctx );
-		if ( ctx.out.has_error() )
-			return false;
-
-		auto args_tuple = make_args_tuple<Args...>( ctx, storage_tuple );
-		if ( ctx.out.has_error() )
-			return false;
-
-		auto *target = static_cast<C *>( ctx.out.cmd->target );
-
-		if constexpr ( std::is_void_v<RT> )
-		{
-			auto callable = [target]( auto &&...args ) { ( target->*M )( std::forward<decltype( args )>( args )... ); };
-			apply<RT>( ctx, callable, std::move( args_tuple ) );
-		}
-		else
-		{
-			auto callable = [target]( auto &&...args ) -> RT {
-				return ( target->*M )( std::forward<decltype( args )>( args )... );
-			};
-			apply<RT>( ctx, callable, std::move( args_tuple ) );
-		}
-
-		return true;
+		return ( static_cast<C *>( target )->*M )( std::forward<decltype( args )>( args )... );
 	}
 };
 
@@ -502,6 +1337,8 @@ struct method_invoker : method_invoker_impl<C, M, typename signature_helper<decl
 	using method_traits = signature_helper<decltype( M )>;
 	static_assert( !std::is_const_v<C> || method_traits::is_const,
 	               "Non-const method invoker instantiated for const instance!" );
+
+	static constexpr target_access access = method_traits::is_const ? target_access::shared : target_access::exclusive;
 };
 
 template <typename T>
@@ -558,14 +1395,26 @@ command method( const C &ctx, const char *n )
 	return { ctx, descriptor::get<detail::method_invoker<const C, M>>(), n };
 }
 
-inline result execute( std::span<const command> commands, std::string_view cmd_line, output &out )
+} // namespace conco
+
+namespace conco::detail {
+
+/**
+ * Tries all overloads of a command, starting at `cmd_iter`, until one of them succeeds.
+ *
+ * `try_overload` is called for every overload attempt with `out` already reset for the given command.
+ * It must build a fresh `context` (with its own copy of argument tokenizers/readers), run the command
+ * (or do anything else with it, like preparing) and return whether it succeeded.
+ */
+template <typename F>
+result execute_overloads( std::span<const command> commands,
+                          std::span<const command>::iterator cmd_iter,
+                          std::string_view command_name,
+                          output &out,
+                          F &&try_overload )
 {
 	size_t overload_count = 0;
 
-	tokenizer tok( cmd_line );
-	std::string_view command_name = tok.next().value_or( std::string_view() );
-
-	auto cmd_iter = std::ranges::find_if( commands, [&]( const command &cmd ) { return cmd == command_name; } );
 	if ( cmd_iter == commands.end() )
 		return result::command_not_found;
 
@@ -573,12 +1422,14 @@ inline result execute( std::span<const command> commands, std::string_view cmd_l
 	{
 		++overload_count;
 
-		tokenizer default_args( cmd_iter->name_and_args + command_name.size() );
-		context ctx = { commands, cmd_line, command_name, tok, default_args, out };
-
-		out = { out.buffer, &*cmd_iter };
+		out = { .buffer = out.buffer,
+		        .cmd = &*cmd_iter,
+		        .scheduler = out.scheduler,
+		        .typed_result_type = out.typed_result_type,
+		        .typed_result = out.typed_result,
+		        .nesting_depth = out.nesting_depth };
 
-		if ( out.cmd->desc.invoker( ctx ) )
+		if ( try_overload( *cmd_iter ) )
 			return result::success;
 
 		++cmd_iter;
@@ -593,12 +1444,179 @@ inline result execute( std::span<const command> commands, std::string_view cmd_l
 	return overload_count > 1 ? result::no_matching_overload : result::command_not_found;
 }
 
+} // namespace conco::detail
+
+namespace conco {
+
+inline result execute( std::span<const command> commands, std::string_view cmd_line, output &out )
+{
+	tokenizer tok( cmd_line );
+	std::string_view command_name = tok.next().value_or( std::string_view() );
+
+	auto cmd_iter = std::ranges::find_if( commands, [&]( const command &cmd ) { return cmd == command_name; } );
+
+	return detail::execute_overloads( commands, cmd_iter, command_name, out, [&]( const command &cmd ) {
+		tokenizer default_args( cmd.name_and_args + command_name.size() );
+		context ctx = { commands, cmd_line, command_name, tok, default_args, out };
+		return cmd.desc.invoker( ctx );
+	} );
+}
+
 inline result execute( std::span<const command> commands, std::string_view cmd_line, std::span<char> output_buffer )
 {
 	output out = { output_buffer };
 	return execute( commands, cmd_line, out );
 }
 
+inline result execute( const layered_commands &commands, std::string_view cmd_line, output &out )
+{
+	tokenizer tok( cmd_line );
+	std::string_view command_name = tok.next().value_or( std::string_view() );
+
+	auto [layer, cmd_iter] = commands.find( command_name );
+
+	return detail::execute_overloads( layer, cmd_iter, command_name, out, [&]( const command &cmd ) {
+		tokenizer default_args( cmd.name_and_args + command_name.size() );
+		context ctx = { commands, cmd_line, command_name, tok, default_args, out };
+		return cmd.desc.invoker( ctx );
+	} );
+}
+
+inline result execute( const layered_commands &commands, std::string_view cmd_line, std::span<char> output_buffer )
+{
+	output out = { output_buffer };
+	return execute( commands, cmd_line, out );
+}
+
+inline result execute( const layered_commands &commands,
+                       std::string_view cmd_line,
+                       const variable_source &variables,
+                       output &out )
+{
+	// Space for arguments mixing text and references, single references are not copied
+	static constexpr size_t interpolation_buffer_size = 1024;
+
+	if ( cmd_line.find_first_of( "$(" ) == std::string_view::npos )
+		return execute( commands, cmd_line, out );
+
+	char buffer[interpolation_buffer_size];
+	nested_results nested;
+	nested.buffer = buffer;
+
+	tokenizer tok( cmd_line, true );
+	std::string_view command_name = tok.next().value_or( std::string_view() );
+
+	auto [layer, cmd_iter] = commands.find( command_name );
+
+	return detail::execute_overloads( layer, cmd_iter, command_name, out, [&]( const command &cmd ) {
+		tokenizer default_args( cmd.name_and_args + command_name.size() );
+		context ctx = { commands, cmd_line, command_name, tok, default_args, out };
+		ctx.variables = &variables;
+		ctx.interpolation_buffer = nested.buffer;
+		ctx.nested = &nested;
+		return cmd.desc.invoker( ctx );
+	} );
+}
+
+inline result execute( const layered_commands &commands,
+                       std::string_view cmd_line,
+                       const variable_source &variables,
+                       std::span<char> output_buffer )
+{
+	output out = { output_buffer };
+	return execute( commands, cmd_line, variables, out );
+}
+
+inline result execute( std::span<const command> commands,
+                       std::string_view cmd_line,
+                       const variable_source &variables,
+                       output &out )
+{
+	return execute( layered_commands( commands ), cmd_line, variables, out );
+}
+
+inline result execute( std::span<const command> commands,
+                       std::string_view cmd_line,
+                       const variable_source &variables,
+                       std::span<char> output_buffer )
+{
+	output out = { output_buffer };
+	return execute( layered_commands( commands ), cmd_line, variables, out );
+}
+
+inline result prepare( std::span<const command> commands,
+                       std::string_view cmd_line,
+                       std::span<std::byte> storage,
+                       prepared &p,
+                       output &out )
+{
+	p.reset();
+
+	tokenizer tok( cmd_line );
+	std::string_view command_name = tok.next().value_or( std::string_view() );
+
+	auto cmd_iter = std::ranges::find_if( commands, [&]( const command &cmd ) { return cmd == command_name; } );
+
+	// Overloads which cannot be prepared are skipped, but `execute()` would try them
+	bool skipped = false;
+
+	result r = detail::execute_overloads( commands, cmd_iter, command_name, out, [&]( const command &cmd ) {
+		void *ptr = storage.data();
+		size_t space = storage.size();
+
+		if ( !cmd.desc.preparer || !std::align( cmd.desc.storage_alignment, cmd.desc.storage_size, ptr, space ) )
+		{
+			skipped = true;
+			return false;
+		}
+
+		tokenizer default_args( cmd.name_and_args + command_name.size() );
+		context ctx = { commands, cmd_line, command_name, tok, default_args, out };
+
+		if ( !cmd.desc.preparer( ctx, ptr ) )
+			return false;
+
+		p = prepared( cmd, ptr );
+		return true;
+	} );
+
+	// Selecting another overload than `execute()` would change the meaning of the command line
+	if ( skipped && r != result::command_not_found )
+	{
+		p.reset();
+		return result::cannot_prepare;
+	}
+
+	return r;
+}
+
+inline result prepared::invoke( output &out )
+{
+	if ( !cmd )
+		return result::command_not_found;
+
+	out = { .buffer = out.buffer, .cmd = cmd, .scheduler = out.scheduler };
+
+	context ctx = { {}, {}, cmd->name(), tokenizer( std::string_view{} ), tokenizer( std::string_view{} ), out };
+	return cmd->desc.prepared_invoker( ctx, storage ) ? result::success : result::argument_parsing_error;
+}
+
+inline result prepared::invoke( std::span<char> output_buffer )
+{
+	output out = { output_buffer };
+	return invoke( out );
+}
+
+inline void prepared::reset() noexcept
+{
+	if ( cmd )
+		cmd->desc.destroyer( storage );
+
+	cmd = nullptr;
+	storage = nullptr;
+}
+
 } // namespace conco
 
 #include "conco_basic_types.hpp"
+#include "conco_binary.hpp"
@@ -0,0 +1,368 @@
+#pragma once
+
+#include "conco_script.hpp"
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace conco::detail {
+
+// Splits an alias body into statements separated by `;` or newlines (outside of quotes and brackets)
+template <typename F>
+void for_each_alias_statement( std::string_view body, F &&fn )
+{
+	size_t begin = 0, depth = 0;
+	char quote_char = '\0';
+	bool escaped = false;
+
+	for ( size_t i = 0; i <= body.size(); ++i )
+	{
+		char ch = i < body.size() ? body[i] : '\n';
+
+		if ( escaped )
+			escaped = false;
+		else if ( ch == '\\' )
+			escaped = true;
+		else if ( quote_char )
+			quote_char = ch == quote_char ? '\0' : quote_char;
+		else if ( ch == '"' || ch == '\'' )
+			quote_char = ch;
+		else if ( ch == '{' || ch == '[' )
+			++depth;
+		else if ( ( ch == '}' || ch == ']' ) && depth > 0 )
+			--depth;
+		else if ( ( ch == ';' || ch == '\n' ) && depth == 0 )
+		{
+			std::string_view statement = body.substr( begin, i - begin );
+			begin = i + 1;
+
+			if ( !tokenizer( statement ).empty() )
+				fn( statement );
+		}
+	}
+}
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+/**
+ * Result of `alias_table::define()`.
+ */
+struct alias_result
+{
+	bool success = false;
+	const char *message = ""; // Error description
+	size_t line = 0;          // Line of the body statement which failed to compile (1-based)
+
+	explicit operator bool() const noexcept { return success; }
+};
+
+/**
+ * Quake-style aliases - named command sequences with parameters.
+ *
+ *   alias spawn_pair "spawn $1 $2; spawn $1 $3"
+ *   spawn_pair orc 10 20
+ *
+ * Alias bodies are compiled by `conco::script` when they are defined: command lines without parameters
+ * are prepared, parameters (`$1` ... `$9`) are passed to commands as typed values, never as text spliced
+ * into the body. Statements can be separated by `;` or newlines and can use `set`, `if` and `for`.
+ * Variables are shared by all statements of the body and local to a single call of the alias.
+ *
+ * Statements calling other aliases are bound to them directly, so aliases used by other aliases must be
+ * defined first. Redefining an alias updates all its callers, a definition which would make an alias
+ * (directly or indirectly) call itself is rejected.
+ *
+ * Not thread-safe.
+ *
+ * Example:
+ *   conco::alias_table aliases( commands );
+ *   aliases.define( "heal_all", "heal player 100; heal pet 100" );
+ *   aliases.execute( "heal_all" );
+ */
+struct alias_table
+{
+	static constexpr size_t max_params = 9;
+
+	explicit alias_table( std::span<const command> commands ) : _base_commands( commands )
+	{
+		_commands.push_back( method<&alias_table::define_command>( *this, "alias name body;Defines an alias" ) );
+		_commands.push_back( method<&alias_table::remove>( *this, "unalias name;Removes an alias" ) );
+	}
+
+	alias_table( const alias_table & ) = delete;
+	alias_table &operator=( const alias_table & ) = delete;
+
+	alias_result define( std::string_view name, std::string_view body )
+	{
+		if ( name.empty() || std::ranges::any_of( name, tokenizer::is_ident_term ) || name.starts_with( '$' ) )
+			return { .message = "invalid alias name" };
+
+		auto [iter, inserted] = _aliases.try_emplace( std::string( name ) );
+		if ( inserted )
+			iter->second = std::make_unique<alias>();
+
+		alias &a = *iter->second;
+
+		// Compile into a new definition first, the old one stays when this one fails
+		auto def = std::make_unique<definition>();
+		def->body = body;
+
+		alias_result r = { .success = true };
+
+		detail::for_each_alias_statement( def->body, [&]( std::string_view statement ) {
+			if ( r.success )
+				r = compile_step( *def, statement );
+
+			if ( !r.success && r.line == 0 )
+			{
+				size_t offset = static_cast<size_t>( statement.data() - def->body.data() );
+				r.line = 1 + static_cast<size_t>( std::ranges::count( def->body.substr( 0, offset ), '\n' ) );
+			}
+		} );
+
+		if ( r.success && std::ranges::any_of( def->steps, [&]( const step &s ) { return calls( s.target, a ); } ) )
+			r = { .message = "alias would call itself" };
+
+		if ( r.success )
+			a.def = std::move( def );
+		else if ( inserted )
+			_aliases.erase( iter );
+
+		return r;
+	}
+
+	// Removes an alias, aliases calling it fail with `command_not_found` until it is defined again
+	bool remove( std::string_view name )
+	{
+		auto iter = _aliases.find( name );
+		if ( iter == _aliases.end() || !iter->second->def )
+			return false;
+
+		iter->second->def.reset();
+		return true;
+	}
+
+	bool contains( std::string_view name ) const noexcept
+	{
+		auto iter = _aliases.find( name );
+		return iter != _aliases.end() && iter->second->def;
+	}
+
+	// `alias` and `unalias` commands, available through `execute()`
+	std::span<const command> commands() const noexcept { return _commands; }
+
+	/**
+	 * Executes an alias call (arguments become `$1` ... `$9`), or a command line from the base commands
+	 * and `commands()`. Alias calls return the first failure of their commands, the output belongs to
+	 * the last executed command.
+	 */
+	result execute( std::string_view cmd_line, output &out )
+	{
+		tokenizer tok( cmd_line );
+		std::string_view name = tok.next().value_or( std::string_view() );
+
+		auto iter = _aliases.find( name );
+		if ( iter == _aliases.end() )
+		{
+			const command_layer layers[] = { _commands, _base_commands };
+			return conco::execute( layered_commands( layers ), cmd_line, out );
+		}
+
+		script_value params[max_params];
+		size_t count = 0;
+
+		while ( token t = tok.next() )
+		{
+			if ( count == max_params )
+				return result::argument_parsing_error;
+
+			char prefix = t->data() > cmd_line.data() ? t->data()[-1] : '\0';
+			params[count++] = prefix == '"' || prefix == '\'' ? script_value( *t ) : script_value::parse( *t );
+		}
+
+		return call( *iter->second, { params, count }, out );
+	}
+
+	result execute( std::string_view cmd_line, std::span<char> output_buffer = {} )
+	{
+		output out = { output_buffer };
+		return execute( cmd_line, out );
+	}
+
+private:
+	struct alias;
+
+	// Argument of a nested alias call - a constant or a parameter of the calling alias
+	struct call_arg
+	{
+		size_t param = 0; // 1-based parameter index, 0 = constant `value`
+		script_value value = {};
+	};
+
+	// Variable of `code`, loaded from and stored into the variables of the alias call around each run
+	struct shared_variable
+	{
+		size_t index = 0;              // Index into the variables of the call
+		script_value *value = nullptr; // Register of the variable in `code`
+	};
+
+	struct step
+	{
+		std::unique_ptr<script> code;          // Statement compiled by `conco::script`
+		script_value *params[max_params] = {}; // Parameter variables used by `code`
+		std::vector<shared_variable> shared;   // Other variables used by `code`
+		const alias *target = nullptr;         // Called alias (instead of `code`)
+		std::vector<call_arg> args;            // Arguments of the called alias
+	};
+
+	struct definition
+	{
+		std::string body;
+		std::vector<step> steps;
+		std::vector<std::string_view> variables; // Names of variables shared by the steps (views into `body`)
+	};
+
+	struct alias
+	{
+		std::unique_ptr<definition> def; // `nullptr` when removed
+	};
+
+	std::span<const command> _base_commands;
+	std::vector<command> _commands;
+	std::map<std::string, std::unique_ptr<alias>, std::less<>> _aliases;
+
+	alias_result compile_step( definition &def, std::string_view statement )
+	{
+		tokenizer tok( statement );
+		std::string_view name = *tok.next();
+		step s;
+
+		if ( auto iter = _aliases.find( name ); iter != _aliases.end() )
+		{
+			s.target = iter->second.get();
+
+			while ( token t = tok.next() )
+			{
+				char prefix = t->data()[-1];
+				bool quoted = prefix == '"' || prefix == '\'';
+
+				if ( !quoted && t->size() == 2 && ( *t )[0] == '$' && ( *t )[1] >= '1' && ( *t )[1] <= '9' )
+					s.args.push_back( { .param = static_cast<size_t>( ( *t )[1] - '0' ) } );
+				else
+					s.args.push_back( { .value = quoted ? script_value( *t ) : script_value::parse( *t ) } );
+			}
+
+			if ( s.args.size() > max_params )
+				return { .message = "too many alias arguments" };
+		}
+		else
+		{
+			s.code = std::make_unique<script>( _base_commands );
+
+			script_result r = s.code->compile( statement );
+			if ( !r )
+				return { .message = r.message };
+
+			for ( size_t i = 0; i < max_params; ++i )
+			{
+				char param_name = static_cast<char>( '1' + i );
+				s.params[i] = s.code->variable( std::string_view( &param_name, 1 ) );
+			}
+
+			s.code->for_each_variable( [&]( std::string_view name, script_value &value ) {
+				if ( name.size() == 1 && name[0] >= '1' && name[0] <= '9' )
+					return;
+
+				auto iter = std::ranges::find( def.variables, name );
+				if ( iter == def.variables.end() )
+					iter = def.variables.insert( iter, name );
+
+				s.shared.push_back( { static_cast<size_t>( iter - def.variables.begin() ), &value } );
+			} );
+		}
+
+		def.steps.push_back( std::move( s ) );
+		return { .success = true };
+	}
+
+	// Whether calling `from` can reach `to`
+	static bool calls( const alias *from, const alias &to ) noexcept
+	{
+		if ( !from )
+			return false;
+
+		if ( from == &to )
+			return true;
+
+		return from->def &&
+		       std::ranges::any_of( from->def->steps, [&]( const step &s ) { return calls( s.target, to ); } );
+	}
+
+	result call( const alias &a, std::span<const script_value> params, output &out )
+	{
+		if ( !a.def )
+			return result::command_not_found;
+
+		std::vector<script_value> variables( a.def->variables.size() );
+
+		result first_failure = result::success;
+		auto track = [&]( result r ) {
+			if ( first_failure == result::success )
+				first_failure = r;
+		};
+
+		for ( const step &s : a.def->steps )
+		{
+			if ( s.target )
+			{
+				script_value args[max_params];
+				for ( size_t i = 0; i < s.args.size(); ++i )
+				{
+					const call_arg &arg = s.args[i];
+					if ( arg.param == 0 )
+						args[i] = arg.value;
+					else if ( arg.param <= params.size() )
+						args[i] = params[arg.param - 1];
+				}
+
+				track( call( *s.target, { args, s.args.size() }, out ) );
+				continue;
+			}
+
+			for ( size_t i = 0; i < max_params; ++i )
+			{
+				if ( s.params[i] )
+					*s.params[i] = i < params.size() ? params[i] : script_value();
+			}
+
+			for ( const shared_variable &v : s.shared )
+				*v.value = variables[v.index];
+
+			script_result r = s.code->run( [&]( std::string_view, result res, const output &o ) {
+				track( res );
+				out = o;
+			}, out.buffer );
+
+			for ( const shared_variable &v : s.shared )
+				variables[v.index] = *v.value;
+
+			if ( !r )
+				track( result::argument_parsing_error );
+		}
+
+		return first_failure;
+	}
+
+	std::string_view define_command( std::string_view name, std::string_view body )
+	{
+		alias_result r = define( name, body );
+		return r ? "ok" : r.message;
+	}
+};
+
+} // namespace conco
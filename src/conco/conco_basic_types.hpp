@@ -59,6 +59,62 @@ struct has_n_members_t<std::tuple<Args...>, N> : std::bool_constant<sizeof...( A
 template <typename T, std::size_t N>
 constexpr bool has_n_members_v = has_n_members_t<T, N>::value;
 
+// Calls `f` for every member of structured-bindable object, stops when `f` returns false
+template <typename T, typename F>
+bool for_each_member( T &obj, F &&f )
+{
+	using U = std::remove_cvref_t<T>;
+
+	if constexpr ( has_n_members_v<U, 9> )
+	{
+		static_assert( false, "Too many members in this class type!" );
+	}
+	else if constexpr ( has_n_members_v<U, 8> )
+	{
+		auto &[m0, m1, m2, m3, m4, m5, m6, m7] = obj;
+		return f( m0 ) && f( m1 ) && f( m2 ) && f( m3 ) && f( m4 ) && f( m5 ) && f( m6 ) && f( m7 );
+	}
+	else if constexpr ( has_n_members_v<U, 7> )
+	{
+		auto &[m0, m1, m2, m3, m4, m5, m6] = obj;
+		return f( m0 ) && f( m1 ) && f( m2 ) && f( m3 ) && f( m4 ) && f( m5 ) && f( m6 );
+	}
+	else if constexpr ( has_n_members_v<U, 6> )
+	{
+		auto &[m0, m1, m2, m3, m4, m5] = obj;
+		return f( m0 ) && f( m1 ) && f( m2 ) && f( m3 ) && f( m4 ) && f( m5 );
+	}
+	else if constexpr ( has_n_members_v<U, 5> )
+	{
+		auto &[m0, m1, m2, m3, m4] = obj;
+		return f( m0 ) && f( m1 ) && f( m2 ) && f( m3 ) && f( m4 );
+	}
+	else if constexpr ( has_n_members_v<U, 4> )
+	{
+		auto &[m0, m1, m2, m3] = obj;
+		return f( m0 ) && f( m1 ) && f( m2 ) && f( m3 );
+	}
+	else if constexpr ( has_n_members_v<U, 3> )
+	{
+		auto &[m0, m1, m2] = obj;
+		return f( m0 ) && f( m1 ) && f( m2 );
+	}
+	else if constexpr ( has_n_members_v<U, 2> )
+	{
+		auto &[m0, m1] = obj;
+		return f( m0 ) && f( m1 );
+	}
+	else if constexpr ( has_n_members_v<U, 1> )
+	{
+		auto &[m0] = obj;
+		return f( m0 );
+	}
+	else
+	{
+		static_assert( false, "Class type has no members!" );
+	}
+}
+
 } // namespace conco::detail
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -67,6 +123,10 @@ namespace conco {
 
 constexpr std::string_view type_name( tag<bool> ) noexcept { return "bool"; }
 
+inline constexpr std::string_view bool_keywords[] = { "false", "no", "off", "on", "true", "yes" };
+
+constexpr std::span<const std::string_view> type_keywords( tag<bool> ) noexcept { return bool_keywords; }
+
 std::optional<bool> from_string( tag<bool>, std::string_view str ) noexcept
 {
 	if ( str == "true" || str == "1" || str == "yes" || str == "on" )
@@ -324,11 +384,23 @@ size_t to_chars( tag<std::optional<T>>, std::span<char> buff, const std::optiona
 template <typename T, typename S = typename type_mapper<T>::storage_type>
 static std::optional<S> parse( tag<std::optional<T>>, context &ctx ) noexcept
 {
+	if ( ctx.binary_args )
+	{
+		S out{};
+		if constexpr ( binary_decodable<S> )
+		{
+			if ( decode_binary_arg( tag<S>{}, ctx, out ) )
+				return out;
+		}
+
+		return std::nullopt;
+	}
+
 	if ( token arg = ctx.next_arg_value(); arg )
 	{
 		++ctx.out.arg_count;
 
-		if ( auto parsed_opt = from_string( tag<S>{}, *arg ); parsed_opt )
+		if ( auto parsed_opt = detail::parse_arg<S>( ctx, *arg ); parsed_opt )
 			return *parsed_opt;
 
 		ctx.out.arg_error_mask |= static_cast<uint32_t>( 1u << ( ctx.out.arg_count - 1 ) );
@@ -353,96 +425,21 @@ std::optional<T> from_string( tag<T>, std::string_view str ) noexcept
 	T obj{};
 	conco::tokenizer tok{ str };
 
-#define PARSE_MEMBER( _M ) \
-	do \
-	{ \
-		auto arg = tok.next(); \
-		if ( !arg ) \
-			return std::nullopt; \
-		auto parsed_opt = from_string( tag<std::remove_cvref_t<decltype( _M )>>{}, *arg ); \
-		if ( !parsed_opt ) \
-			return std::nullopt; \
-		_M = *parsed_opt; \
-	} while ( false )
-
-	if constexpr ( detail::has_n_members_v<T, 9> )
-	{
-		static_assert( false, "Too many members in this class type!" );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 8> )
-	{
-		auto &[m0, m1, m2, m3, m4, m5, m6, m7] = obj;
-		PARSE_MEMBER( m0 );
-		PARSE_MEMBER( m1 );
-		PARSE_MEMBER( m2 );
-		PARSE_MEMBER( m3 );
-		PARSE_MEMBER( m4 );
-		PARSE_MEMBER( m5 );
-		PARSE_MEMBER( m6 );
-		PARSE_MEMBER( m7 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 7> )
-	{
-		auto &[m0, m1, m2, m3, m4, m5, m6] = obj;
-		PARSE_MEMBER( m0 );
-		PARSE_MEMBER( m1 );
-		PARSE_MEMBER( m2 );
-		PARSE_MEMBER( m3 );
-		PARSE_MEMBER( m4 );
-		PARSE_MEMBER( m5 );
-		PARSE_MEMBER( m6 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 6> )
-	{
-		auto &[m0, m1, m2, m3, m4, m5] = obj;
-		PARSE_MEMBER( m0 );
-		PARSE_MEMBER( m1 );
-		PARSE_MEMBER( m2 );
-		PARSE_MEMBER( m3 );
-		PARSE_MEMBER( m4 );
-		PARSE_MEMBER( m5 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 5> )
-	{
-		auto &[m0, m1, m2, m3, m4] = obj;
-		PARSE_MEMBER( m0 );
-		PARSE_MEMBER( m1 );
-		PARSE_MEMBER( m2 );
-		PARSE_MEMBER( m3 );
-		PARSE_MEMBER( m4 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 4> )
-	{
-		auto &[m0, m1, m2, m3] = obj;
-		PARSE_MEMBER( m0 );
-		PARSE_MEMBER( m1 );
-		PARSE_MEMBER( m2 );
-		PARSE_MEMBER( m3 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 3> )
-	{
-		auto &[m0, m1, m2] = obj;
-		PARSE_MEMBER( m0 );
-		PARSE_MEMBER( m1 );
-		PARSE_MEMBER( m2 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 2> )
-	{
-		auto &[m0, m1] = obj;
-		PARSE_MEMBER( m0 );
-		PARSE_MEMBER( m1 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 1> )
-	{
-		auto &[m0] = obj;
-		PARSE_MEMBER( m0 );
-	}
-	else
-	{
-		static_assert( false, "Class type has no members!" );
-	}
+	bool ok = detail::for_each_member( obj, [&]( auto &member ) {
+		auto arg = tok.next();
+		if ( !arg )
+			return false;
 
-#undef PARSE_MEMBER
+		auto parsed_opt = from_string( tag<std::remove_cvref_t<decltype( member )>>{}, *arg );
+		if ( !parsed_opt )
+			return false;
+
+		member = *parsed_opt;
+		return true;
+	} );
+
+	if ( !ok )
+		return std::nullopt;
 
 	return obj;
 }
@@ -456,92 +453,12 @@ size_t to_chars( tag<T>, std::span<char> buff, const T &value ) noexcept
 
 	auto b = buff;
 
-#define TO_CHARS_MEMBER( _M ) \
-	do \
-	{ \
-		size_t len = detail::to_chars_append( b, _M, ',' ); \
-		if ( len == 0 ) \
-			return 0; \
-	} while ( false )
-
-	if constexpr ( detail::has_n_members_v<T, 9> )
-	{
-		static_assert( false, "Too many members in this class type!" );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 8> )
-	{
-		const auto &[m0, m1, m2, m3, m4, m5, m6, m7] = value;
-		TO_CHARS_MEMBER( m0 );
-		TO_CHARS_MEMBER( m1 );
-		TO_CHARS_MEMBER( m2 );
-		TO_CHARS_MEMBER( m3 );
-		TO_CHARS_MEMBER( m4 );
-		TO_CHARS_MEMBER( m5 );
-		TO_CHARS_MEMBER( m6 );
-		TO_CHARS_MEMBER( m7 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 7> )
-	{
-		const auto &[m0, m1, m2, m3, m4, m5, m6] = value;
-		TO_CHARS_MEMBER( m0 );
-		TO_CHARS_MEMBER( m1 );
-		TO_CHARS_MEMBER( m2 );
-		TO_CHARS_MEMBER( m3 );
-		TO_CHARS_MEMBER( m4 );
-		TO_CHARS_MEMBER( m5 );
-		TO_CHARS_MEMBER( m6 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 6> )
-	{
-		const auto &[m0, m1, m2, m3, m4, m5] = value;
-		TO_CHARS_MEMBER( m0 );
-		TO_CHARS_MEMBER( m1 );
-		TO_CHARS_MEMBER( m2 );
-		TO_CHARS_MEMBER( m3 );
-		TO_CHARS_MEMBER( m4 );
-		TO_CHARS_MEMBER( m5 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 5> )
-	{
-		const auto &[m0, m1, m2, m3, m4] = value;
-		TO_CHARS_MEMBER( m0 );
-		TO_CHARS_MEMBER( m1 );
-		TO_CHARS_MEMBER( m2 );
-		TO_CHARS_MEMBER( m3 );
-		TO_CHARS_MEMBER( m4 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 4> )
-	{
-		const auto &[m0, m1, m2, m3] = value;
-		TO_CHARS_MEMBER( m0 );
-		TO_CHARS_MEMBER( m1 );
-		TO_CHARS_MEMBER( m2 );
-		TO_CHARS_MEMBER( m3 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 3> )
-	{
-		const auto &[m0, m1, m2] = value;
-		TO_CHARS_MEMBER( m0 );
-		TO_CHARS_MEMBER( m1 );
-		TO_CHARS_MEMBER( m2 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 2> )
-	{
-		const auto &[m0, m1] = value;
-		TO_CHARS_MEMBER( m0 );
-		TO_CHARS_MEMBER( m1 );
-	}
-	else if constexpr ( detail::has_n_members_v<T, 1> )
-	{
-		const auto &[m0] = value;
-		TO_CHARS_MEMBER( m0 );
-	}
-	else
-	{
-		static_assert( false, "Class type has no members!" );
-	}
+	bool ok = detail::for_each_member( value, [&]( const auto &member ) {
+		return detail::to_chars_append( b, member, ',' ) != 0;
+	} );
 
-#undef TO_CHARS_MEMBER
+	if ( !ok )
+		return 0;
 
 	if ( b.size() < 2 ) // Not enough space for closing '}' and null-terminator
 		return 0;
@@ -0,0 +1,570 @@
+#pragma once
+
+#include "conco.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <optional>
+#include <utility>
+
+namespace conco {
+
+/**
+ * Binary command protocol.
+ *
+ * Programmatic clients can skip text formatting (and our tokenization and `from_string` parsing)
+ * completely by sending requests in the following format (all numbers are little-endian):
+ *
+ *   request := name_length:u8 ( name:u8[name_length] | command_index:u16 ) value*
+ *   value   := kind:u8 size:u32 payload:u8[size]
+ *
+ * When `name_length` is zero, the command is selected by its index in the command list instead of
+ * its name. Values are decoded straight into the storage types of command arguments (see
+ * `from_binary()` functions below), no intermediate text is involved. Arguments that are missing
+ * or sent as `binary_kind::none` fall back to their default values, just like with text commands.
+ *
+ * Use `binary_writer` to build requests on the client side.
+ */
+enum class binary_kind : uint8_t
+{
+	none,     // No value, default argument value is used (or `std::nullopt` for optional arguments)
+	boolean,  // 1 byte: 0 = false, 1 = true
+	integer,  // 8 bytes: signed 64-bit integer
+	uinteger, // 8 bytes: unsigned 64-bit integer
+	floating, // 8 bytes: IEEE-754 double
+	string,   // Raw characters without null-terminator, also used as text fallback for any type
+	list,     // Sequence of nested values (arrays, vectors, structs, tuples, maps, ...)
+};
+
+/**
+ * Executes a binary encoded request (see above) from the given command list.
+ */
+result execute_binary( std::span<const struct command> commands, std::span<const std::byte> request, output &out );
+
+/**
+ * Same as above, but creates an `output` structure internally.
+ */
+result execute_binary( std::span<const struct command> commands,
+                       std::span<const std::byte> request,
+                       std::span<char> output_buffer = {} );
+
+/**
+ * Single decoded value of the binary protocol. Payload is a view into the original request.
+ */
+struct binary_value
+{
+	binary_kind kind = binary_kind::none;
+	std::span<const std::byte> data;
+
+	std::string_view text() const noexcept { return { reinterpret_cast<const char *>( data.data() ), data.size() }; }
+};
+
+} // namespace conco
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco::detail {
+
+template <typename T>
+T load_le( const std::byte *src ) noexcept
+{
+	T value;
+	std::memcpy( &value, src, sizeof( T ) );
+
+	if constexpr ( std::endian::native == std::endian::big )
+		value = std::byteswap( value );
+
+	return value;
+}
+
+template <typename T>
+void store_le( std::byte *dst, T value ) noexcept
+{
+	if constexpr ( std::endian::native == std::endian::big )
+		value = std::byteswap( value );
+
+	std::memcpy( dst, &value, sizeof( T ) );
+}
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+/**
+ * Sequential reader of binary values. Does not copy anything, values are views into `data`.
+ */
+struct binary_reader
+{
+	static constexpr size_t header_size = 5; // kind:u8 + size:u32
+
+	std::span<const std::byte> data;
+	bool error = false; // Set when the input ends in the middle of a value
+
+	bool empty() const noexcept { return data.empty(); }
+
+	std::optional<binary_value> next() noexcept
+	{
+		if ( data.size() < header_size )
+		{
+			error = error || !data.empty();
+			data = {};
+			return std::nullopt;
+		}
+
+		auto kind = static_cast<binary_kind>( data[0] );
+		uint32_t size = detail::load_le<uint32_t>( data.data() + 1 );
+		if ( data.size() - header_size < size )
+		{
+			error = true;
+			data = {};
+			return std::nullopt;
+		}
+
+		binary_value value = { kind, data.subspan( header_size, size ) };
+		data = data.subspan( header_size + size );
+		return value;
+	}
+};
+
+/**
+ * Builds binary requests into a user-provided buffer. No memory is allocated.
+ *
+ * Example:
+ *   std::byte buffer[256];
+ *   conco::binary_writer writer{ buffer };
+ *   writer.request( "set_transform", std::array{ 1.0f, 2.0f, 3.0f }, std::array{ 0, 0, 0, 1 } );
+ *   conco::execute_binary( commands, writer.bytes() );
+ */
+struct binary_writer
+{
+	std::span<std::byte> buffer;
+	size_t size = 0;
+	bool overflow = false; // Set when the buffer is too small, all further writes are ignored
+
+	std::span<const std::byte> bytes() const noexcept { return buffer.first( size ); }
+
+	// Starts a new request for a command with given name, discards any previous content
+	bool begin_request( std::string_view name ) noexcept
+	{
+		size = 0;
+		overflow = false;
+
+		if ( name.empty() || name.size() > 255 )
+			return !( overflow = true );
+
+		auto length = static_cast<std::byte>( name.size() );
+		return write_raw( &length, 1 ) && write_raw( name.data(), name.size() );
+	}
+
+	// Starts a new request for a command at given index in the command list
+	bool begin_request( uint16_t command_index ) noexcept
+	{
+		size = 0;
+		overflow = false;
+
+		std::byte header[3] = { std::byte{ 0 } };
+		detail::store_le( header + 1, command_index );
+		return write_raw( header, sizeof( header ) );
+	}
+
+	bool write( binary_kind kind, const void *payload, size_t payload_size ) noexcept
+	{
+		if ( payload_size > UINT32_MAX )
+			return !( overflow = true );
+
+		std::byte header[binary_reader::header_size] = { static_cast<std::byte>( kind ) };
+		detail::store_le( header + 1, static_cast<uint32_t>( payload_size ) );
+		return write_raw( header, sizeof( header ) ) && write_raw( payload, payload_size );
+	}
+
+	template <typename T>
+	bool write_number( binary_kind kind, T value ) noexcept
+	{
+		std::byte payload[sizeof( T )];
+		detail::store_le( payload, value );
+		return write( kind, payload, sizeof( T ) );
+	}
+
+	// Opens a nested list value, returned position must be passed to `end_list()`
+	size_t begin_list() noexcept
+	{
+		size_t pos = size;
+		write( binary_kind::list, nullptr, 0 );
+		return pos;
+	}
+
+	bool end_list( size_t pos ) noexcept
+	{
+		if ( overflow )
+			return false;
+
+		detail::store_le( buffer.data() + pos + 1, static_cast<uint32_t>( size - pos - binary_reader::header_size ) );
+		return true;
+	}
+
+	template <typename T>
+	bool value( const T &v ) noexcept
+	{
+		return to_binary( tag<std::remove_cvref_t<T>>{}, *this, v );
+	}
+
+	// Writes the whole request at once, e.g.: `writer.request( "sum", 1, 2 )`
+	template <typename... Args>
+	bool request( std::string_view name, const Args &...args ) noexcept
+	{
+		return begin_request( name ) && ( value( args ) && ... && true );
+	}
+
+	template <typename... Args>
+	bool request( uint16_t command_index, const Args &...args ) noexcept
+	{
+		return begin_request( command_index ) && ( value( args ) && ... && true );
+	}
+
+private:
+	bool write_raw( const void *src, size_t len ) noexcept
+	{
+		if ( overflow || buffer.size() - size < len )
+			return !( overflow = true );
+
+		if ( len )
+			std::memcpy( buffer.data() + size, src, len );
+
+		size += len;
+		return true;
+	}
+};
+
+} // namespace conco
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco::detail {
+
+/**
+ * Decodes a binary value into `out`. Types without `from_binary()` overload can still be sent
+ * as `binary_kind::string` values, which are parsed by regular `from_string()` functions.
+ */
+template <typename T>
+bool decode_binary_value( const binary_value &value, T &out ) noexcept
+{
+	if constexpr ( requires { from_binary( tag<T>{}, value ); } )
+	{
+		if ( auto parsed_opt = from_binary( tag<T>{}, value ); parsed_opt )
+		{
+			out = std::move( *parsed_opt );
+			return true;
+		}
+	}
+
+	if ( value.kind == binary_kind::string )
+	{
+		if ( auto parsed_opt = from_string( tag<T>{}, value.text() ); parsed_opt )
+		{
+			out = std::move( *parsed_opt );
+			return true;
+		}
+	}
+
+	return false;
+}
+
+template <typename R>
+bool encode_list( binary_writer &writer, const R &values ) noexcept
+{
+	size_t pos = writer.begin_list();
+	for ( const auto &v : values )
+	{
+		if ( !writer.value( v ) )
+			return false;
+	}
+
+	return writer.end_list( pos );
+}
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+// Binary counterpart of `parse()` - decodes next argument from `ctx.binary_args` into `out`.
+// Returns false when the argument is missing and there is no default value for it.
+template <typename S>
+bool decode_binary_arg( tag<S>, context &ctx, S &out ) noexcept
+{
+	token default_value = ctx.next_default_value();
+
+	if ( auto value = ctx.binary_args->next(); value && value->kind != binary_kind::none )
+	{
+		++ctx.out.arg_count;
+
+		if ( !detail::decode_binary_value( *value, out ) )
+			ctx.out.arg_error_mask |= static_cast<uint32_t>( 1u << ( ctx.out.arg_count - 1 ) );
+
+		return true;
+	}
+
+	if ( default_value )
+	{
+		++ctx.out.arg_count;
+
+		if ( auto parsed_opt = from_string( tag<S>{}, *default_value ); parsed_opt )
+			out = std::move( *parsed_opt );
+		else
+			ctx.out.arg_error_mask |= static_cast<uint32_t>( 1u << ( ctx.out.arg_count - 1 ) );
+
+		return true;
+	}
+
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline std::optional<bool> from_binary( tag<bool>, const binary_value &value ) noexcept
+{
+	if ( value.kind != binary_kind::boolean || value.data.size() != 1 )
+		return std::nullopt;
+
+	return value.data[0] != std::byte{ 0 };
+}
+
+inline bool to_binary( tag<bool>, binary_writer &writer, bool value ) noexcept
+{
+	std::byte payload = static_cast<std::byte>( value ? 1 : 0 );
+	return writer.write( binary_kind::boolean, &payload, 1 );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+  requires std::is_integral_v<T>
+std::optional<T> from_binary( tag<T>, const binary_value &value ) noexcept
+{
+	// `std::in_range()` does not accept character types, use the integer type of the same size
+	using I = std::conditional_t<std::is_signed_v<T>, std::make_signed_t<T>, std::make_unsigned_t<T>>;
+
+	if ( value.data.size() != 8 )
+		return std::nullopt;
+
+	if ( value.kind == binary_kind::integer )
+	{
+		auto v = detail::load_le<int64_t>( value.data.data() );
+		if ( std::in_range<I>( v ) )
+			return static_cast<T>( v );
+	}
+	else if ( value.kind == binary_kind::uinteger )
+	{
+		auto v = detail::load_le<uint64_t>( value.data.data() );
+		if ( std::in_range<I>( v ) )
+			return static_cast<T>( v );
+	}
+
+	return std::nullopt;
+}
+
+template <typename T>
+  requires std::is_integral_v<T>
+bool to_binary( tag<T>, binary_writer &writer, T value ) noexcept
+{
+	if constexpr ( std::is_signed_v<T> )
+		return writer.write_number( binary_kind::integer, static_cast<int64_t>( value ) );
+	else
+		return writer.write_number( binary_kind::uinteger, static_cast<uint64_t>( value ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+  requires std::is_floating_point_v<T>
+std::optional<T> from_binary( tag<T>, const binary_value &value ) noexcept
+{
+	if ( value.data.size() != 8 )
+		return std::nullopt;
+
+	switch ( value.kind )
+	{
+		case binary_kind::floating:
+			return static_cast<T>( std::bit_cast<double>( detail::load_le<uint64_t>( value.data.data() ) ) );
+		case binary_kind::integer: return static_cast<T>( detail::load_le<int64_t>( value.data.data() ) );
+		case binary_kind::uinteger: return static_cast<T>( detail::load_le<uint64_t>( value.data.data() ) );
+		default: break;
+	}
+
+	return std::nullopt;
+}
+
+template <typename T>
+  requires std::is_floating_point_v<T>
+bool to_binary( tag<T>, binary_writer &writer, T value ) noexcept
+{
+	return writer.write_number( binary_kind::floating, std::bit_cast<uint64_t>( static_cast<double>( value ) ) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline std::optional<std::string_view> from_binary( tag<std::string_view>, const binary_value &value ) noexcept
+{
+	if ( value.kind != binary_kind::string )
+		return std::nullopt;
+
+	return value.text();
+}
+
+inline bool to_binary( tag<std::string_view>, binary_writer &writer, std::string_view value ) noexcept
+{
+	return writer.write( binary_kind::string, value.data(), value.size() );
+}
+
+inline bool to_binary( tag<const char *>, binary_writer &writer, const char *value ) noexcept
+{
+	return to_binary( tag<std::string_view>{}, writer, value ? std::string_view{ value } : std::string_view{} );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T, size_t N>
+std::optional<std::array<T, N>> from_binary( tag<std::array<T, N>>, const binary_value &value ) noexcept
+{
+	if ( value.kind != binary_kind::list )
+		return std::nullopt;
+
+	std::array<T, N> out = {};
+	binary_reader reader = { value.data };
+
+	for ( size_t i = 0; i < N; ++i )
+	{
+		auto item = reader.next();
+		if ( !item || !detail::decode_binary_value( *item, out[i] ) )
+			return std::nullopt;
+	}
+
+	return out;
+}
+
+template <typename T, size_t N>
+bool to_binary( tag<std::array<T, N>>, binary_writer &writer, const std::array<T, N> &value ) noexcept
+{
+	return detail::encode_list( writer, std::span<const T>{ value.data(), N } );
+}
+
+template <typename T>
+bool to_binary( tag<std::span<T>>, binary_writer &writer, std::span<T> value ) noexcept
+{
+	return detail::encode_list( writer, std::span<const T>{ value.data(), value.size() } );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+std::optional<std::optional<T>> from_binary( tag<std::optional<T>>, const binary_value &value ) noexcept
+{
+	if ( value.kind == binary_kind::none )
+		return std::optional<T>{};
+
+	T out{};
+	if ( !detail::decode_binary_value( value, out ) )
+		return std::nullopt;
+
+	return std::optional<T>{ std::move( out ) };
+}
+
+template <typename T>
+bool to_binary( tag<std::optional<T>>, binary_writer &writer, const std::optional<T> &value ) noexcept
+{
+	if ( value )
+		return writer.value( *value );
+
+	return writer.write( binary_kind::none, nullptr, 0 );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+  requires std::is_class_v<T> && detail::is_struct_bindable<T>
+std::optional<T> from_binary( tag<T>, const binary_value &value ) noexcept
+{
+	if ( value.kind != binary_kind::list )
+		return std::nullopt;
+
+	T obj{};
+	binary_reader reader = { value.data };
+
+	bool ok = detail::for_each_member( obj, [&]( auto &member ) {
+		auto item = reader.next();
+		return item && detail::decode_binary_value( *item, member );
+	} );
+
+	return ok ? std::optional<T>{ std::move( obj ) } : std::nullopt;
+}
+
+template <typename T>
+  requires std::is_class_v<T> && detail::is_struct_bindable<T>
+bool to_binary( tag<T>, binary_writer &writer, const T &value ) noexcept
+{
+	size_t pos = writer.begin_list();
+
+	if ( !detail::for_each_member( value, [&]( const auto &member ) { return writer.value( member ); } ) )
+		return false;
+
+	return writer.end_list( pos );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+inline result execute_binary( std::span<const command> commands, std::span<const std::byte> request, output &out )
+{
+	if ( request.empty() )
+		return result::command_not_found;
+
+	auto cmd_iter = commands.end();
+	std::string_view command_name;
+	size_t name_length = static_cast<size_t>( request[0] );
+
+	if ( name_length )
+	{
+		if ( request.size() < 1 + name_length )
+			return result::command_not_found;
+
+		command_name = { reinterpret_cast<const char *>( request.data() + 1 ), name_length };
+		cmd_iter = std::ranges::find_if( commands, [&]( const command &cmd ) { return cmd == command_name; } );
+		request = request.subspan( 1 + name_length );
+	}
+	else
+	{
+		if ( request.size() < 3 )
+			return result::command_not_found;
+
+		size_t index = detail::load_le<uint16_t>( request.data() + 1 );
+		if ( index >= commands.size() )
+			return result::command_not_found;
+
+		cmd_iter = commands.begin() + index;
+		command_name = cmd_iter->name();
+		request = request.subspan( 3 );
+	}
+
+	binary_reader args = {};
+
+	return detail::execute_overloads( commands, cmd_iter, command_name, out, [&]( const command &cmd ) {
+		args = { request };
+
+		tokenizer default_args( cmd.name_and_args + command_name.size() );
+		context ctx = { commands, {}, command_name, tokenizer( std::string_view{} ), default_args, out, &args };
+		return cmd.desc.invoker( ctx );
+	} );
+}
+
+inline result execute_binary( std::span<const command> commands,
+                              std::span<const std::byte> request,
+                              std::span<char> output_buffer )
+{
+	output out = { output_buffer };
+	return execute_binary( commands, request, out );
+}
+
+} // namespace conco
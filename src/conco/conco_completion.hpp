@@ -0,0 +1,294 @@
+#pragma once
+
+#include "conco.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace conco {
+
+/**
+ * Result of `completer::complete()`, valid until the next call.
+ */
+struct completion_result
+{
+	std::vector<std::string_view> candidates; // Sorted matches, at most `completer::max_candidates`
+	size_t total_count = 0;                   // Number of all matches, can be more than `candidates.size()`
+	size_t replace_offset = 0;                // Offset of the completed token in the command line
+	std::string_view common_prefix;           // Longest common prefix of all matches
+	std::vector<std::string> hints;           // Signatures of the command overloads ("sum x:int y:int")
+	int arg_index = -1;                       // Completed argument, -1 = command name
+};
+
+/**
+ * Tab-completion of command names and argument values.
+ *
+ * Command names are kept in a sorted index, a prefix maps to a contiguous range found by binary search.
+ * While the user keeps typing, the range of the previous call is narrowed instead of searching the whole
+ * index again.
+ *
+ * Argument values are completed from `type_info::keywords` (bool, enums with `type_keywords()`) and from
+ * candidate generators registered for the argument `type_info`.
+ *
+ * Example:
+ *   conco::completer completer( commands );
+ *   completer.set_generator( conco::type_info::get<asset_path>(), list_assets );
+ *
+ *   const auto &r = completer.complete( "render.sh" );
+ *   // r.candidates = { "render.shadows", "render.sharpen" }, r.common_prefix = "render.sh"
+ */
+struct completer
+{
+	// Appends candidates starting with `prefix` (others are filtered out anyway)
+	using generator = std::function<void( std::string_view prefix, std::vector<std::string> &candidates )>;
+
+	size_t max_candidates = 64;
+
+	explicit completer( std::span<const command> commands ) : _commands( commands )
+	{
+		for ( size_t i = 0; i < commands.size(); ++i )
+		{
+			// Only the first overload group is reachable by `execute()`
+			if ( i == 0 || commands[i - 1] != commands[i].name() )
+				_names.push_back( { commands[i].name(), static_cast<uint32_t>( i ) } );
+		}
+
+		std::ranges::stable_sort( _names, {}, &name_entry::name );
+
+		auto duplicates = std::ranges::unique( _names, {}, &name_entry::name );
+		_names.erase( duplicates.begin(), duplicates.end() );
+
+		_range_end = _names.size();
+	}
+
+	// Registers a generator of argument values for a type, replaces the previous one
+	void set_generator( const type_info *ti, generator gen ) { _generators[ti] = std::move( gen ); }
+
+	// Completes the last token of a command line, an empty token when the line ends with a space
+	const completion_result &complete( std::string_view cmd_line )
+	{
+		_result.candidates.clear();
+		_result.hints.clear();
+		_result.total_count = 0;
+		_result.common_prefix = {};
+
+		std::string_view tokens[sizeof( output::arg_count ) * 8 + 2];
+		size_t token_count = 0;
+
+		tokenizer tok( cmd_line );
+		while ( token t = tok.next() )
+		{
+			if ( token_count == std::size( tokens ) )
+				return _result;
+
+			tokens[token_count++] = *t;
+		}
+
+		// A new (empty) token is started after a separator
+		const char *line_end = cmd_line.data() + cmd_line.size();
+		if ( token_count == 0 || tokens[token_count - 1].data() + tokens[token_count - 1].size() < line_end )
+			tokens[token_count++] = cmd_line.substr( cmd_line.size() );
+
+		std::string_view prefix = tokens[token_count - 1];
+		_result.replace_offset = static_cast<size_t>( prefix.data() - cmd_line.data() );
+		_result.arg_index = static_cast<int>( token_count ) - 2;
+
+		if ( _result.arg_index < 0 )
+			complete_name( prefix );
+		else
+			complete_argument( tokens[0], static_cast<size_t>( _result.arg_index ), prefix );
+
+		return _result;
+	}
+
+	// Signature hint for a command, e.g. "sum x:int y:int=2"
+	static std::string signature( const command &cmd )
+	{
+		std::string text( cmd.name() );
+		tokenizer arg_names( cmd.name_and_args + text.size() );
+
+		for ( const type_info *ti : cmd.desc.arg_type_infos )
+		{
+			if ( ti == type_info::get<context>() || ti == type_info::get<output>() )
+				continue;
+
+			text += ' ';
+
+			if ( ti == type_info::get<tokenizer>() )
+			{
+				text += "...";
+				continue;
+			}
+
+			token default_value = std::nullopt;
+			if ( token name = arg_names.next() )
+			{
+				text += *name;
+				text += ':';
+
+				if ( arg_names.try_consume_assignment() )
+					default_value = arg_names.next();
+			}
+
+			text += ti->name.empty() ? std::string_view( "?" ) : ti->name;
+
+			if ( default_value )
+			{
+				text += '=';
+				text += *default_value;
+			}
+		}
+
+		return text;
+	}
+
+private:
+	struct name_entry
+	{
+		std::string_view name;
+		uint32_t command = 0; // Index of the first overload
+	};
+
+	std::span<const command> _commands;
+	std::vector<name_entry> _names; // Sorted by name
+	std::unordered_map<const type_info *, generator> _generators;
+
+	// Range of `_names` matching `_last_prefix`, narrowed by subsequent calls
+	std::string _last_prefix;
+	size_t _range_begin = 0;
+	size_t _range_end = 0;
+
+	completion_result _result;
+	std::vector<std::string> _generated;
+
+	std::span<const name_entry> find_prefix( std::string_view prefix )
+	{
+		if ( !prefix.starts_with( _last_prefix ) )
+		{
+			_range_begin = 0;
+			_range_end = _names.size();
+		}
+
+		auto range = std::span<const name_entry>( _names ).subspan( _range_begin, _range_end - _range_begin );
+
+		auto first = std::ranges::lower_bound( range, prefix, {}, &name_entry::name );
+		auto last = std::partition_point( first, range.end(), [&]( const name_entry &e ) {
+			return e.name.starts_with( prefix );
+		} );
+
+		// Matches of a longer prefix stay within the range, so the search can start there next time
+		_last_prefix = prefix;
+		_range_end = _range_begin + static_cast<size_t>( last - range.begin() );
+		_range_begin += static_cast<size_t>( first - range.begin() );
+
+		return { first, last };
+	}
+
+	void complete_name( std::string_view prefix )
+	{
+		auto matches = find_prefix( prefix );
+
+		_result.total_count = matches.size();
+		for ( const name_entry &e : matches.first( std::min( matches.size(), max_candidates ) ) )
+			_result.candidates.push_back( e.name );
+
+		if ( !matches.empty() )
+		{
+			_result.common_prefix = common_prefix( matches.front().name, matches.back().name );
+
+			// Unique match, show its signature right away
+			if ( matches.size() == 1 )
+				add_hints( matches.front() );
+		}
+	}
+
+	void complete_argument( std::string_view command_name, size_t arg_index, std::string_view prefix )
+	{
+		auto iter = std::ranges::lower_bound( _names, command_name, {}, &name_entry::name );
+		if ( iter == _names.end() || iter->name != command_name )
+			return;
+
+		add_hints( *iter );
+
+		std::vector<std::string_view> &candidates = _result.candidates;
+		_generated.clear();
+
+		// Generated strings are referenced only after all of them are generated
+		std::vector<const type_info *> types;
+		for ( size_t i = iter->command; i < _commands.size() && _commands[i] == command_name; ++i )
+		{
+			if ( const type_info *ti = value_arg_type( _commands[i], arg_index ) )
+			{
+				types.push_back( ti );
+
+				if ( auto gen = _generators.find( ti ); gen != _generators.end() )
+					gen->second( prefix, _generated );
+			}
+		}
+
+		for ( const type_info *ti : types )
+		{
+			// Keywords of wrapper types like `std::optional<bool>` come from the inner type
+			while ( ti && ti->keywords.empty() )
+				ti = ti->inner_type_info;
+
+			if ( ti )
+				std::ranges::copy_if( ti->keywords, std::back_inserter( candidates ), [&]( std::string_view k ) {
+					return k.starts_with( prefix );
+				} );
+		}
+
+		for ( const std::string &s : _generated )
+		{
+			if ( std::string_view( s ).starts_with( prefix ) )
+				candidates.push_back( s );
+		}
+
+		std::ranges::sort( candidates );
+		auto duplicates = std::ranges::unique( candidates );
+		candidates.erase( duplicates.begin(), duplicates.end() );
+
+		_result.total_count = candidates.size();
+		if ( !candidates.empty() )
+			_result.common_prefix = common_prefix( candidates.front(), candidates.back() );
+
+		if ( candidates.size() > max_candidates )
+			candidates.resize( max_candidates );
+	}
+
+	void add_hints( const name_entry &e )
+	{
+		for ( size_t i = e.command; i < _commands.size() && _commands[i] == e.name; ++i )
+			_result.hints.push_back( signature( _commands[i] ) );
+	}
+
+	// Type of the `arg_index`-th argument read from the command line, skipping context arguments
+	static const type_info *value_arg_type( const command &cmd, size_t arg_index ) noexcept
+	{
+		for ( const type_info *ti : cmd.desc.arg_type_infos )
+		{
+			if ( ti == type_info::get<context>() || ti == type_info::get<output>() )
+				continue;
+
+			if ( ti == type_info::get<tokenizer>() )
+				return nullptr; // Tail arguments are not typed
+
+			if ( arg_index-- == 0 )
+				return ti;
+		}
+
+		return nullptr;
+	}
+
+	// Sorted candidates share the common prefix of the first and the last one
+	static std::string_view common_prefix( std::string_view first, std::string_view last ) noexcept
+	{
+		auto mismatch = std::ranges::mismatch( first, last );
+		return first.substr( 0, static_cast<size_t>( mismatch.in1 - first.begin() ) );
+	}
+};
+
+} // namespace conco
@@ -0,0 +1,466 @@
+#pragma once
+
+#include "conco.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace conco::detail {
+
+template <typename T>
+struct cvar_storage;
+
+// Lock-free atomic types, reads and writes are wait-free
+template <typename T>
+  requires std::is_trivially_copyable_v<T> && std::atomic<T>::is_always_lock_free
+struct cvar_storage<T>
+{
+	explicit cvar_storage( const T &v ) noexcept : _value( v ) {}
+
+	T load() const noexcept { return _value.load( std::memory_order_acquire ); }
+	void store( const T &v ) noexcept { _value.store( v, std::memory_order_release ); }
+
+private:
+	std::atomic<T> _value;
+};
+
+// Larger trivially copyable types (vectors, colors...), guarded by a seqlock. Readers never block
+// writers, they only retry when a write was in progress.
+template <typename T>
+  requires std::is_trivially_copyable_v<T> && ( !std::atomic<T>::is_always_lock_free )
+struct cvar_storage<T>
+{
+	explicit cvar_storage( const T &v ) noexcept { store( v ); }
+
+	T load() const noexcept
+	{
+		uint64_t words[word_count];
+
+		while ( true )
+		{
+			uint32_t sequence = _sequence.load( std::memory_order_acquire );
+			if ( sequence & 1 )
+				continue; // Write in progress
+
+			for ( size_t i = 0; i < word_count; ++i )
+				words[i] = _words[i].load( std::memory_order_relaxed );
+
+			std::atomic_thread_fence( std::memory_order_acquire );
+			if ( _sequence.load( std::memory_order_relaxed ) == sequence )
+				break;
+		}
+
+		T out;
+		std::memcpy( &out, words, sizeof( T ) );
+		return out;
+	}
+
+	void store( const T &v ) noexcept
+	{
+		uint64_t words[word_count] = {};
+		std::memcpy( words, &v, sizeof( T ) );
+
+		// Odd sequence marks a write in progress, it also serializes writers
+		uint32_t sequence = _sequence.load( std::memory_order_relaxed );
+		while ( ( sequence & 1 ) ||
+		        !_sequence.compare_exchange_weak( sequence, sequence + 1, std::memory_order_acquire ) )
+			sequence = _sequence.load( std::memory_order_relaxed );
+
+		std::atomic_thread_fence( std::memory_order_release );
+
+		for ( size_t i = 0; i < word_count; ++i )
+			_words[i].store( words[i], std::memory_order_relaxed );
+
+		_sequence.store( sequence + 2, std::memory_order_release );
+	}
+
+private:
+	static constexpr size_t word_count = ( sizeof( T ) + 7 ) / 8;
+
+	std::atomic<uint32_t> _sequence = 0;
+	std::atomic<uint64_t> _words[word_count] = {};
+};
+
+// Other types (strings...) are guarded by a mutex
+template <typename T>
+  requires( !std::is_trivially_copyable_v<T> )
+struct cvar_storage<T>
+{
+	explicit cvar_storage( const T &v ) : _value( v ) {}
+
+	T load() const
+	{
+		std::lock_guard lock( _mutex );
+		return _value;
+	}
+
+	void store( const T &v )
+	{
+		std::lock_guard lock( _mutex );
+		_value = v;
+	}
+
+private:
+	mutable std::mutex _mutex;
+	T _value;
+};
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+struct cvar_table;
+
+/**
+ * Type-erased part of `cvar<T>`, used by `cvar_table`.
+ */
+struct cvar_base
+{
+	// Name with optional description, same as `command::name_and_args` ("r_quality;Render quality")
+	const char *const name_and_desc;
+
+	cvar_base( const cvar_base & ) = delete;
+	cvar_base &operator=( const cvar_base & ) = delete;
+
+	std::string_view name() const noexcept
+	{
+		size_t i = 0;
+		while ( name_and_desc[i] && !tokenizer::is_ident_term( name_and_desc[i] ) )
+			++i;
+
+		return { name_and_desc, i };
+	}
+
+protected:
+	friend struct cvar_table;
+
+	// Type-specific operations, filled by `cvar<T>`
+	struct operations
+	{
+		void ( *notify )( cvar_base & );
+		size_t ( *write )( const cvar_base &, std::span<char> buffer ); // Same as `to_chars()`
+		bool ( *read )( cvar_base &, std::string_view text );           // Parses and sets the value
+		bool ( *is_default )( const cvar_base & );
+		bool ( *copy )( const cvar_base &, const type_info *ti, void *value ); // Copies the value if its type is `ti`
+	};
+
+	cvar_base( const char *n, const operations &ops ) noexcept : name_and_desc( n ), _ops( ops ) {}
+
+	// Queues the change notification in the owning table
+	void mark_changed() noexcept;
+
+private:
+	const operations &_ops;
+	std::atomic<cvar_table *> _table = nullptr;
+	std::atomic<bool> _changed = false;
+	cvar_base *_next_changed = nullptr; // Intrusive list of changed variables
+};
+
+/**
+ * Console variable - a tuning value which can be read by hot code on any thread while the console changes it.
+ *
+ * Lock-free atomic types are read with a single atomic load, larger trivially copyable types through a seqlock,
+ * other types (e.g. strings) under a mutex. Change callbacks do not run on the writing thread, they are
+ * batched and called by `cvar_table::sync()` - once per variable, no matter how many times it changed.
+ *
+ * Example:
+ *   conco::cvar<int> shadow_quality( "r_shadow_quality;Shadow map quality", 2 );
+ *   cvars.add( shadow_quality ); // Adds `r_shadow_quality` and `r_shadow_quality <value>` commands
+ *
+ *   // Render thread
+ *   int quality = shadow_quality.get();
+ */
+template <typename T>
+struct cvar final : cvar_base
+{
+	std::function<void( const T & )> on_change; // Called by `cvar_table::sync()`
+
+	explicit cvar( const char *name_and_desc, T default_value = {} )
+	  : cvar_base( name_and_desc, ops ), _storage( default_value ), _default( std::move( default_value ) )
+	{}
+
+	T get() const noexcept( noexcept( _storage.load() ) ) { return _storage.load(); }
+
+	void set( T value )
+	{
+		_storage.store( value );
+		mark_changed();
+	}
+
+	void reset() { set( _default ); }
+
+	const T &default_value() const noexcept { return _default; }
+
+private:
+	detail::cvar_storage<T> _storage;
+	const T _default;
+
+	static void notify( cvar_base &base )
+	{
+		auto &self = static_cast<cvar &>( base );
+		if ( self.on_change )
+			self.on_change( self.get() );
+	}
+
+	static size_t write( const cvar_base &base, std::span<char> buffer )
+	{
+		return to_chars( tag<T>{}, buffer, static_cast<const cvar &>( base ).get() );
+	}
+
+	static bool read( cvar_base &base, std::string_view text )
+	{
+		auto value = from_string( tag<T>{}, text );
+		if ( !value )
+			return false;
+
+		static_cast<cvar &>( base ).set( std::move( *value ) );
+		return true;
+	}
+
+	static bool is_default( const cvar_base &base )
+	{
+		auto &self = static_cast<const cvar &>( base );
+
+		if constexpr ( std::equality_comparable<T> )
+			return self.get() == self._default;
+		else
+		{
+			// Types without `operator==` are compared by their text form
+			char current[256], initial[256];
+			size_t size = to_chars( tag<T>{}, current, self.get() );
+			return size != 0 && size == to_chars( tag<T>{}, initial, self._default ) &&
+			       std::memcmp( current, initial, size ) == 0;
+		}
+	}
+
+	static bool copy( const cvar_base &base, const type_info *ti, void *value )
+	{
+		if ( ti != type_info::get<T>() )
+			return false;
+
+		*static_cast<T *>( value ) = static_cast<const cvar &>( base ).get();
+		return true;
+	}
+
+	static constexpr operations ops = { &notify, &write, &read, &is_default, &copy };
+};
+
+/**
+ * Result of `cvar_table::load()`.
+ */
+struct cvar_load_result
+{
+	size_t loaded = 0;  // Variables set
+	size_t unknown = 0; // Lines with unknown variable names
+	size_t invalid = 0; // Lines with values which could not be parsed
+};
+
+/**
+ * Set of console variables with generated getter/setter commands and batched change callbacks.
+ *
+ * Registered variables must outlive the table. Adding variables is not thread-safe, reading and
+ * writing them is.
+ */
+struct cvar_table
+{
+	cvar_table() = default;
+	cvar_table( const cvar_table & ) = delete;
+	cvar_table &operator=( const cvar_table & ) = delete;
+
+	// Registers a variable and generates its `name` (getter) and `name <value>` (setter) commands
+	template <typename T>
+	void add( cvar<T> &v )
+	{
+		v._table.store( this, std::memory_order_release );
+		_vars.push_back( &v );
+		_index.emplace( v.name(), &v );
+
+		// Setter first, without arguments it fails and the getter overload is used
+		_commands.push_back( method<&cvar<T>::set>( v, v.name_and_desc ) );
+		_commands.push_back( method<&cvar<T>::get>( v, v.name_and_desc ) );
+	}
+
+	std::span<cvar_base *const> vars() const noexcept { return _vars; }
+
+	cvar_base *find( std::string_view name ) const noexcept
+	{
+		auto iter = _index.find( name );
+		return iter != _index.end() ? iter->second : nullptr;
+	}
+
+	// Generated commands, pass these to `execute()` (directly or as a layer of `layered_commands`)
+	std::span<const command> commands() const noexcept { return _commands; }
+
+	/**
+	 * Variables for `$name` references in command lines, see `variable_source`. Arguments of the same
+	 * type as the variable get its value directly, others its text written by `to_chars()`.
+	 *
+	 * Example:
+	 *   conco::execute( commands, "spawn orc $sv_difficulty", cvars.variables() );
+	 */
+	variable_source variables() const noexcept
+	{
+		return { .source = this, .text_func = &variable_text, .value_func = &variable_value };
+	}
+
+	// Calls change callbacks of variables changed since the last call, returns their number.
+	// Call from the thread which should run the callbacks, usually once per frame.
+	size_t sync()
+	{
+		cvar_base *list = _changed.exchange( nullptr, std::memory_order_acquire );
+
+		// Restore the order of changes
+		cvar_base *reversed = nullptr;
+		while ( list )
+		{
+			cvar_base *next = list->_next_changed;
+			list->_next_changed = reversed;
+			reversed = list;
+			list = next;
+		}
+
+		size_t count = 0;
+		for ( cvar_base *v = reversed; v; ++count )
+		{
+			cvar_base *next = v->_next_changed;
+
+			// Changes made from now on (even by the callback) are queued again
+			v->_changed.store( false, std::memory_order_release );
+			v->_ops.notify( *v );
+			v = next;
+		}
+
+		return count;
+	}
+
+	/**
+	 * Appends `name value` lines of all variables (or only of those which differ from their defaults)
+	 * to `out`. Values are stringified by `to_chars()` right into the output string, in a single pass.
+	 * Returns the number of written variables.
+	 */
+	size_t save( std::string &out, bool only_changed = false ) const
+	{
+		size_t count = 0;
+
+		for ( const cvar_base *v : _vars )
+		{
+			if ( only_changed && v->_ops.is_default( *v ) )
+				continue;
+
+			std::string_view name = v->name();
+			size_t line_start = out.size();
+
+			out.append( name );
+			out += ' ';
+
+			// Grow the output until the value fits, `to_chars()` also writes a null-terminator
+			size_t value_start = out.size();
+			size_t written = 0;
+
+			for ( size_t space = 64; written == 0 && space <= max_value_size; space *= 2 )
+			{
+				out.resize( value_start + space );
+				written = v->_ops.write( *v, std::span<char>( out ).subspan( value_start ) );
+			}
+
+			if ( written == 0 )
+			{
+				out.resize( line_start ); // Cannot be stringified
+				continue;
+			}
+
+			out.resize( value_start + written - 1 );
+			out += '\n';
+			++count;
+		}
+
+		return count;
+	}
+
+	/**
+	 * Sets variables from `name value` lines (as written by `save()`). Variables are looked up directly
+	 * in the name index, without command lookup and overload resolution. Empty lines and lines starting
+	 * with `#` or `//` are skipped.
+	 */
+	cvar_load_result load( std::string_view text )
+	{
+		cvar_load_result r;
+
+		while ( !text.empty() )
+		{
+			size_t end = std::min( text.find( '\n' ), text.size() );
+			std::string_view line = text.substr( 0, end );
+			text.remove_prefix( std::min( end + 1, text.size() ) );
+
+			tokenizer tok( line );
+			token name = tok.next();
+
+			if ( !name || name->starts_with( '#' ) || name->starts_with( "//" ) )
+				continue;
+
+			cvar_base *v = find( *name );
+			token value = tok.next();
+
+			if ( !v )
+				++r.unknown;
+			else if ( value && v->_ops.read( *v, *value ) )
+				++r.loaded;
+			else
+				++r.invalid;
+		}
+
+		return r;
+	}
+
+private:
+	friend struct cvar_base;
+
+	static constexpr size_t max_value_size = 64 * 1024;
+
+	static token variable_text( const void *source, std::string_view name, std::span<char> buffer )
+	{
+		const cvar_base *v = static_cast<const cvar_table *>( source )->find( name );
+		size_t written = v ? v->_ops.write( *v, buffer ) : 0;
+		if ( written == 0 )
+			return std::nullopt;
+
+		// Strings are written quoted, references resolve to their content
+		std::string_view text( buffer.data(), written - 1 );
+		if ( text.size() >= 2 && text.front() == '"' && text.back() == '"' )
+			text = text.substr( 1, text.size() - 2 );
+
+		return text;
+	}
+
+	static bool variable_value( const void *source, std::string_view name, const type_info *ti, void *value )
+	{
+		const cvar_base *v = static_cast<const cvar_table *>( source )->find( name );
+		return v && v->_ops.copy( *v, ti, value );
+	}
+
+	std::vector<cvar_base *> _vars;
+	std::unordered_map<std::string_view, cvar_base *> _index;
+	std::vector<command> _commands;
+	std::atomic<cvar_base *> _changed = nullptr; // Lock-free stack of changed variables
+};
+
+inline void cvar_base::mark_changed() noexcept
+{
+	cvar_table *table = _table.load( std::memory_order_acquire );
+	if ( !table || _changed.exchange( true, std::memory_order_acq_rel ) )
+		return;
+
+	_next_changed = table->_changed.load( std::memory_order_relaxed );
+	while ( !table->_changed.compare_exchange_weak( _next_changed, this, std::memory_order_release,
+	                                                std::memory_order_relaxed ) )
+		;
+}
+
+} // namespace conco
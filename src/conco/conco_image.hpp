@@ -0,0 +1,309 @@
+#pragma once
+
+#include "conco_binary.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <vector>
+
+namespace conco {
+
+/**
+ * Precompiled script images.
+ *
+ * Scripts that never change between runs (autoexec, level configs...) can be compiled into a binary
+ * image once and executed without tokenizing and parsing them again. Statements are stored as binary
+ * requests (see `execute_binary()`) with resolved command indices and arguments already converted
+ * into binary values where the argument type is known (bool, int, uint, float). Other arguments are
+ * stored as text views and parsed by `from_string` when executed.
+ *
+ *   image     := magic:u32 version:u16 reserved:u16 table_hash:u64 statement_count:u32 text_size:u32
+ *                text:u8[text_size] statement*
+ *   statement := value of `binary_kind::list` (binary request) or `binary_kind::string` (text line)
+ *
+ * Lines which cannot be compiled (unknown commands, overloads, commands taking `context`, `tokenizer`
+ * or `output` arguments...) are stored as text and executed as usual. The original script is embedded
+ * too - when the command table changes (see `command_table_hash()`), the image falls back to it.
+ *
+ * Images contain no pointers, so they can be memory-mapped and executed in place.
+ */
+struct image_header
+{
+	static constexpr uint32_t magic_value = 0x4d49'4343; // "CCIM"
+	static constexpr uint16_t format_version = 1;
+	static constexpr size_t size = 24;
+
+	uint32_t magic = 0;
+	uint16_t version = 0;
+	uint64_t table_hash = 0;
+	uint32_t statement_count = 0;
+	uint32_t text_size = 0;
+};
+
+/**
+ * Result of `execute_image()`.
+ */
+struct image_result
+{
+	bool valid = false;         // Image header and statements were well-formed
+	bool text_fallback = false; // Command table changed, the embedded script text was executed instead
+	size_t executed = 0;        // Executed statements
+	size_t failed = 0;          // Statements which did not return `result::success`
+};
+
+} // namespace conco
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco::detail {
+
+inline uint64_t fnv1a( uint64_t h, std::string_view text ) noexcept
+{
+	for ( char ch : text )
+		h = ( h ^ static_cast<uint8_t>( ch ) ) * 1099511628211ull;
+
+	return ( h ^ 0xff ) * 1099511628211ull; // Terminator, "ab" + "c" differs from "a" + "bc"
+}
+
+// Calls `fn( line )` for every script line which is not empty and not a comment (`#` or `//`)
+template <typename F>
+void for_each_script_line( std::string_view script, F &&fn )
+{
+	while ( !script.empty() )
+	{
+		size_t end = std::min( script.find( '\n' ), script.size() );
+		std::string_view line = script.substr( 0, end );
+		script.remove_prefix( std::min( end + 1, script.size() ) );
+
+		if ( line.ends_with( '\r' ) )
+			line.remove_suffix( 1 );
+
+		token first = tokenizer( line ).next();
+		if ( first && !first->starts_with( '#' ) && !first->starts_with( "//" ) )
+			fn( line );
+	}
+}
+
+template <typename... T>
+bool is_type_of( const type_info *ti ) noexcept
+{
+	return ( ( ti == type_info::get<T>() ) || ... );
+}
+
+// Converts a text argument into a binary value of its storage type, text is kept when the type is unknown
+inline bool write_image_arg( binary_writer &writer, const type_info *ti, std::string_view text ) noexcept
+{
+	if ( is_type_of<bool>( ti ) )
+	{
+		if ( auto v = from_string( tag<bool>{}, text ) )
+			return writer.value( *v );
+	}
+	else if ( is_type_of<signed char, short, int, long, long long>( ti ) )
+	{
+		if ( auto v = from_string( tag<int64_t>{}, text ) )
+			return writer.value( *v );
+	}
+	else if ( is_type_of<unsigned char, unsigned short, unsigned int, unsigned long, unsigned long long>( ti ) )
+	{
+		if ( auto v = from_string( tag<uint64_t>{}, text ) )
+			return writer.value( *v );
+	}
+	else if ( is_type_of<float, double>( ti ) )
+	{
+		// Values out of `float` range are left for `from_string`, which rejects them for `float` arguments
+		if ( auto v = from_string( tag<double>{}, text ); v && std::abs( *v ) <= FLT_MAX )
+			return writer.value( *v );
+	}
+
+	return writer.value( text );
+}
+
+// Encodes a script line as a binary request, returns false when it has to stay text
+inline bool compile_image_statement( std::span<const command> commands, std::string_view line, binary_writer &writer )
+{
+	tokenizer tok( line );
+	std::string_view command_name = tok.next().value_or( std::string_view() );
+
+	auto cmd_iter = std::ranges::find_if( commands, [&]( const command &cmd ) { return cmd == command_name; } );
+	if ( cmd_iter == commands.end() )
+		return false;
+
+	size_t index = static_cast<size_t>( cmd_iter - commands.begin() );
+	const descriptor &desc = cmd_iter->desc;
+
+	// Overload resolution depends on the arguments, context-dependent commands need the command line
+	if ( index > UINT16_MAX || ( cmd_iter + 1 != commands.end() && cmd_iter[1] == command_name ) ||
+	     !desc.preparer || desc.has_tail_args )
+		return false;
+
+	writer.begin_request( static_cast<uint16_t>( index ) );
+
+	size_t arg_index = 0;
+	while ( token arg = tok.next() )
+	{
+		// Extra or key-value arguments are handled by the text path
+		if ( arg_index >= desc.arg_type_infos.size() || *arg == "=" || *arg == ":" )
+			return false;
+
+		write_image_arg( writer, desc.arg_type_infos[arg_index++], *arg );
+	}
+
+	return !writer.overflow;
+}
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+/**
+ * Hash of command names, argument names and argument types. Images compiled for a table with
+ * a different hash are executed from the embedded script text.
+ */
+inline uint64_t command_table_hash( std::span<const command> commands ) noexcept
+{
+	uint64_t h = 14695981039346656037ull;
+
+	for ( const command &cmd : commands )
+	{
+		h = detail::fnv1a( h, cmd.name_and_args );
+		for ( const type_info *ti : cmd.desc.arg_type_infos )
+			h = detail::fnv1a( h, ti ? ti->name : std::string_view( "void" ) );
+	}
+
+	return h;
+}
+
+/**
+ * Compiles a script (one command per line) into an image, appended to `image`.
+ * Returns false when the script is too large for the image format.
+ */
+inline bool compile_image( std::span<const command> commands, std::string_view script, std::vector<std::byte> &image )
+{
+	if ( script.size() > UINT32_MAX )
+		return false;
+
+	size_t start = image.size();
+	image.resize( start + image_header::size + script.size() );
+	std::memcpy( image.data() + start + image_header::size, script.data(), script.size() );
+
+	std::byte scratch[4096];
+	binary_writer writer{ scratch };
+	uint32_t statement_count = 0;
+
+	auto append = [&]( binary_kind kind, std::span<const std::byte> payload ) {
+		size_t pos = image.size();
+		image.resize( pos + binary_reader::header_size + payload.size() );
+		image[pos] = static_cast<std::byte>( kind );
+		detail::store_le( image.data() + pos + 1, static_cast<uint32_t>( payload.size() ) );
+		std::memcpy( image.data() + pos + binary_reader::header_size, payload.data(), payload.size() );
+		++statement_count;
+	};
+
+	detail::for_each_script_line( script, [&]( std::string_view line ) {
+		if ( detail::compile_image_statement( commands, line, writer ) )
+			append( binary_kind::list, writer.bytes() );
+		else
+			append( binary_kind::string, std::as_bytes( std::span( line ) ) );
+	} );
+
+	std::byte *header = image.data() + start;
+	detail::store_le( header, image_header::magic_value );
+	detail::store_le( header + 4, image_header::format_version );
+	detail::store_le( header + 6, uint16_t( 0 ) );
+	detail::store_le( header + 8, command_table_hash( commands ) );
+	detail::store_le( header + 16, statement_count );
+	detail::store_le( header + 20, static_cast<uint32_t>( script.size() ) );
+	return true;
+}
+
+/**
+ * Reads and validates the image header, `std::nullopt` when the image is malformed.
+ */
+inline std::optional<image_header> read_image_header( std::span<const std::byte> image ) noexcept
+{
+	if ( image.size() < image_header::size )
+		return std::nullopt;
+
+	image_header h;
+	h.magic = detail::load_le<uint32_t>( image.data() );
+	h.version = detail::load_le<uint16_t>( image.data() + 4 );
+	h.table_hash = detail::load_le<uint64_t>( image.data() + 8 );
+	h.statement_count = detail::load_le<uint32_t>( image.data() + 16 );
+	h.text_size = detail::load_le<uint32_t>( image.data() + 20 );
+
+	if ( h.magic != image_header::magic_value || h.version != image_header::format_version ||
+	     image.size() - image_header::size < h.text_size )
+		return std::nullopt;
+
+	return h;
+}
+
+/**
+ * Executes a compiled image. `on_result( statement_index, result, output )` is called after every
+ * statement, stringified results are written into `output_buffer`.
+ *
+ * Example:
+ *   auto file = conco::mapped_file( "autoexec.cci" );
+ *   conco::execute_image( commands, file.bytes(), []( size_t, conco::result r, const conco::output & ) {} );
+ */
+template <typename F>
+image_result execute_image( std::span<const command> commands,
+                            std::span<const std::byte> image,
+                            F &&on_result,
+                            std::span<char> output_buffer = {} )
+{
+	image_result r;
+
+	auto header = read_image_header( image );
+	if ( !header )
+		return r;
+
+	auto finish = [&]( result res, const output &out ) {
+		if ( res != result::success )
+			++r.failed;
+
+		on_result( r.executed++, res, out );
+	};
+
+	if ( header->table_hash != command_table_hash( commands ) )
+	{
+		r.valid = r.text_fallback = true;
+
+		auto text = image.subspan( image_header::size, header->text_size );
+		detail::for_each_script_line( { reinterpret_cast<const char *>( text.data() ), text.size() },
+		                              [&]( std::string_view line ) {
+			                              output out = { output_buffer };
+			                              finish( execute( commands, line, out ), out );
+		                              } );
+
+		return r;
+	}
+
+	binary_reader statements = { image.subspan( image_header::size + header->text_size ) };
+
+	while ( auto statement = statements.next() )
+	{
+		output out = { output_buffer };
+
+		if ( statement->kind == binary_kind::list )
+			finish( execute_binary( commands, statement->data, out ), out );
+		else if ( statement->kind == binary_kind::string )
+			finish( execute( commands, statement->text(), out ), out );
+		else
+			return r;
+	}
+
+	r.valid = !statements.error && r.executed == header->statement_count;
+	return r;
+}
+
+inline image_result execute_image( std::span<const command> commands,
+                                   std::span<const std::byte> image,
+                                   std::span<char> output_buffer = {} )
+{
+	return execute_image( commands, image, []( size_t, result, const output & ) {}, output_buffer );
+}
+
+} // namespace conco
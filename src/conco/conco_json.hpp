@@ -0,0 +1,312 @@
+#pragma once
+
+#include "conco.hpp"
+
+namespace conco {
+
+/**
+ * JSON front-end.
+ *
+ * Executes JSON-RPC style requests without converting them into a command line first:
+ *
+ *   { "cmd": "sum", "args": [1, 2], "id": 7 }                 -> { "id": 7, "result": 3 }
+ *   { "method": "sum", "params": { "x": 1, "y": 2 } }         -> { "result": 3 }
+ *   { "cmd": "xyz" }                                          -> { "error": "command_not_found" }
+ *
+ * The request is scanned in a single pass by the regular `tokenizer` (JSON is a subset of what it
+ * understands) and argument values are parsed by `from_string` directly from views into the request.
+ * Named arguments are matched against argument names from `command::name_and_args`. Nothing is
+ * copied or allocated.
+ *
+ * Command result is stringified into `out.buffer` as usual and then converted into JSON response
+ * (structs and tuples become arrays, maps become objects). When the response does not fit into
+ * the `response` buffer, an empty string is written instead.
+ *
+ * Note: just like with text commands, escape sequences in string arguments are not unescaped.
+ */
+result execute_json( std::span<const struct command> commands,
+                     std::string_view request,
+                     output &out,
+                     std::span<char> response );
+
+/**
+ * Simple JSON writer into a user-provided buffer. Output is always null-terminated.
+ */
+struct json_writer
+{
+	std::span<char> buffer;
+	size_t size = 0;
+	bool overflow = false; // Set when the buffer is too small, all further writes are ignored
+
+	std::string_view view() const noexcept { return { buffer.data(), size }; }
+
+	bool raw( std::string_view str ) noexcept
+	{
+		if ( overflow || buffer.size() - size < str.size() + 1 ) // Always keep space for null-terminator
+			return !( overflow = true );
+
+		std::copy_n( str.data(), str.size(), buffer.data() + size );
+		size += str.size();
+		buffer[size] = '\0';
+		return true;
+	}
+
+	// Writes quoted and escaped JSON string. With `unescape`, backslash escapes from conco tokens
+	// are resolved first (`\'` -> `'`).
+	bool string( std::string_view str, bool unescape = false ) noexcept
+	{
+		constexpr char hex_digits[] = "0123456789abcdef";
+
+		if ( !raw( "\"" ) )
+			return false;
+
+		for ( size_t i = 0; i < str.size(); ++i )
+		{
+			char ch = str[i];
+			if ( unescape && ch == '\\' && i + 1 < str.size() )
+				ch = str[++i];
+
+			if ( ch == '"' || ch == '\\' )
+			{
+				const char escaped[] = { '\\', ch };
+				raw( { escaped, 2 } );
+			}
+			else if ( static_cast<unsigned char>( ch ) < 0x20 )
+			{
+				const char escaped[] = { '\\', 'u', '0', '0', hex_digits[( ch >> 4 ) & 0xF], hex_digits[ch & 0xF] };
+				raw( { escaped, 6 } );
+			}
+			else
+				raw( { &ch, 1 } );
+		}
+
+		return raw( "\"" );
+	}
+};
+
+} // namespace conco
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco::detail {
+
+struct json_request
+{
+	token command = std::nullopt; // "cmd" or "method"
+	token args = std::nullopt;    // Body of "args" or "params" array/object
+	token id = std::nullopt;      // Raw "id" value, echoed back in the response
+	bool named_args = false;      // Arguments were provided as an object
+	bool id_is_string = false;
+};
+
+inline bool is_json_quote( char ch ) noexcept
+{
+	return ch == '"' || ch == '\'';
+}
+
+inline bool parse_json_request( std::string_view json, json_request &req ) noexcept
+{
+	tokenizer outer( json );
+	if ( !outer.next_char_is( '{' ) )
+		return false;
+
+	token body = outer.next();
+	if ( !body )
+		return false;
+
+	tokenizer tok( *body );
+	while ( !tok.empty() )
+	{
+		token key = tok.next();
+		if ( !key || !tok.try_consume_assignment() || tok.empty() )
+			return false;
+
+		// The first character tells us the value kind, tokenizer strips quotes and brackets
+		char first = tok.text[0];
+
+		token value = tok.next();
+		if ( !value )
+			return false;
+
+		if ( *key == "cmd" || *key == "method" )
+			req.command = value;
+		else if ( *key == "args" || *key == "params" )
+		{
+			if ( first != '[' && first != '{' )
+				return false;
+
+			req.args = value;
+			req.named_args = ( first == '{' );
+		}
+		else if ( *key == "id" )
+		{
+			req.id = value;
+			req.id_is_string = is_json_quote( first );
+		}
+	}
+
+	return req.command.has_value();
+}
+
+inline bool write_json_literal( json_writer &w, std::string_view str ) noexcept
+{
+	if ( str == "true" || str == "false" || str == "null" )
+		return w.raw( str );
+
+	// Numbers are passed as they are, anything else (`inf`, `nan`, identifiers) becomes a string
+	bool has_digit = false;
+	bool is_number = !str.empty();
+
+	for ( char ch : str )
+	{
+		has_digit = has_digit || ( ch >= '0' && ch <= '9' );
+		is_number = is_number && ( ( ch >= '0' && ch <= '9' ) || ch == '-' || ch == '+' || ch == '.' || ch == 'e' ||
+		                           ch == 'E' );
+	}
+
+	return ( is_number && has_digit ) ? w.raw( str ) : w.string( str );
+}
+
+inline bool write_json_token( json_writer &w, tokenizer &tok ) noexcept;
+
+inline bool write_json_list( json_writer &w, std::string_view body, bool braces ) noexcept
+{
+	tokenizer tok( body );
+
+	// Only `{key: value}` lists become objects, other braced values (structs, tuples) become arrays
+	bool is_object = false;
+	if ( braces )
+	{
+		tokenizer probe = tok;
+		is_object = probe.next() && probe.try_consume_assignment();
+	}
+
+	w.raw( is_object ? "{" : "[" );
+
+	for ( bool first = true; !tok.empty(); first = false )
+	{
+		if ( !first )
+			w.raw( "," );
+
+		if ( is_object )
+		{
+			bool quoted = is_json_quote( tok.text[0] );
+
+			token key = tok.next();
+			if ( !key || !tok.try_consume_assignment() )
+				return false;
+
+			w.string( *key, quoted );
+			w.raw( ":" );
+		}
+
+		if ( !write_json_token( w, tok ) )
+			return false;
+	}
+
+	return w.raw( is_object ? "}" : "]" );
+}
+
+inline bool write_json_token( json_writer &w, tokenizer &tok ) noexcept
+{
+	if ( tok.empty() )
+		return false;
+
+	char first = tok.text[0];
+
+	token value = tok.next();
+	if ( !value )
+		return false;
+
+	switch ( first )
+	{
+		case '"':
+		case '\'': return w.string( *value, true );
+		case '[': return write_json_list( w, *value, false );
+		case '{': return write_json_list( w, *value, true );
+		default: break;
+	}
+
+	return write_json_literal( w, *value );
+}
+
+// Converts a value in `to_chars` format ("123", "'abc'", "[1,2]", "{1,2}", "{\"a\":1}") into JSON
+inline bool write_json_value( json_writer &w, std::string_view text ) noexcept
+{
+	tokenizer tok( text );
+	if ( tok.empty() )
+		return w.raw( "null" );
+
+	return write_json_token( w, tok );
+}
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+inline result execute_json( std::span<const command> commands,
+                            std::string_view request,
+                            output &out,
+                            std::span<char> response )
+{
+	result r = result::command_not_found;
+
+	detail::json_request req;
+	if ( detail::parse_json_request( request, req ) )
+	{
+		std::string_view command_name = *req.command;
+		std::string_view args = req.args.value_or( std::string_view{} );
+
+		auto cmd_iter = std::ranges::find_if( commands, [&]( const command &cmd ) { return cmd == command_name; } );
+
+		r = detail::execute_overloads( commands, cmd_iter, command_name, out, [&]( const command &cmd ) {
+			tokenizer default_args( cmd.name_and_args + command_name.size() );
+			context ctx = {
+				commands, request, command_name, tokenizer( req.named_args ? std::string_view{} : args ), default_args, out
+			};
+
+			if ( req.named_args )
+				ctx.named_args = args;
+
+			return cmd.desc.invoker( ctx );
+		} );
+	}
+
+	json_writer w = { response };
+	w.raw( "{" );
+
+	if ( req.id )
+	{
+		w.raw( "\"id\":" );
+		req.id_is_string ? w.string( *req.id, true ) : detail::write_json_literal( w, *req.id );
+		w.raw( "," );
+	}
+
+	if ( r == result::success && !out.result_error )
+	{
+		std::string_view text = out.buffer.empty() ? std::string_view{} : std::string_view{ out.buffer.data() };
+
+		w.raw( "\"result\":" );
+		if ( !detail::write_json_value( w, text ) && !w.overflow )
+		{
+			w.size = 0;
+			w.raw( "{\"error\":\"result_error\"" );
+		}
+	}
+	else
+	{
+		w.raw( "\"error\":" );
+		w.string( r == result::success ? "result_error" : to_string( r ) );
+	}
+
+	w.raw( "}" );
+
+	if ( w.overflow && !response.empty() )
+		response[0] = '\0';
+
+	return r;
+}
+
+} // namespace conco
@@ -0,0 +1,358 @@
+#pragma once
+
+#include "conco.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace conco::detail {
+
+// Matches text against a pattern with `*` (any characters) and `?` (single character) wildcards
+inline bool glob_match( std::string_view pattern, std::string_view text ) noexcept
+{
+	size_t p = 0, t = 0;
+	size_t star = std::string_view::npos, star_text = 0;
+
+	while ( t < text.size() )
+	{
+		if ( p < pattern.size() && ( pattern[p] == '?' || pattern[p] == text[t] ) )
+		{
+			++p;
+			++t;
+		}
+		else if ( p < pattern.size() && pattern[p] == '*' )
+		{
+			star = p++;
+			star_text = t;
+		}
+		else if ( star != std::string_view::npos )
+		{
+			// Let the last `*` consume one more character
+			p = star + 1;
+			t = ++star_text;
+		}
+		else
+			return false;
+	}
+
+	while ( p < pattern.size() && pattern[p] == '*' )
+		++p;
+
+	return p == pattern.size();
+}
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+/**
+ * Tree of commands keyed by `.`-separated name segments (`render.shadows.quality`).
+ *
+ * Lookup walks the segments of a command name, comparing only short segments among siblings.
+ * Subtrees can be registered lazily - `add_lazy()` stores a loader which runs the first time
+ * a command under its prefix is looked up, so modules nobody uses never build their tables.
+ * Loaders add commands with full names and can register further lazy subtrees.
+ *
+ * Not thread-safe, lookups can modify the tree by running loaders.
+ *
+ * Example:
+ *   conco::command_namespace ns;
+ *   ns.add_lazy( "render", []( conco::command_namespace &ns ) { ns.add( render_commands ); } );
+ *
+ *   ns.execute( "render.shadows.quality 2" ); // Loads render commands first
+ */
+struct command_namespace
+{
+	using loader = std::function<void( command_namespace & )>;
+
+	command_namespace() = default;
+	command_namespace( std::span<const command> commands ) { add( commands ); }
+
+	command_namespace( const command_namespace & ) = delete;
+	command_namespace &operator=( const command_namespace & ) = delete;
+
+	// Adds commands, overloads of the same name are kept in the order of addition
+	void add( std::span<const command> commands )
+	{
+		for ( const command &cmd : commands )
+		{
+			walk( cmd.name(), true, false )->commands.push_back( cmd );
+
+			// Overloads are kept next to each other in the flat list too (commands are not assignable,
+			// so the list is rebuilt when an overload is added after other commands)
+			auto last = std::ranges::find_if( _commands.rbegin(), _commands.rend(), [&]( const command &c ) {
+				return c == cmd.name();
+			} );
+
+			if ( last == _commands.rend() || last == _commands.rbegin() )
+				_commands.push_back( cmd );
+			else
+			{
+				std::vector<command> list( _commands.begin(), last.base() );
+				list.reserve( _commands.size() + 1 );
+				list.push_back( cmd );
+				for ( auto iter = last.base(); iter != _commands.end(); ++iter )
+					list.push_back( *iter );
+
+				_commands = std::move( list );
+			}
+		}
+	}
+
+	void add( const command &cmd ) { add( std::span<const command>( &cmd, 1 ) ); }
+
+	// Registers a loader for all commands under `prefix` (`render` covers `render.*`, `render.shadows.*` etc.)
+	void add_lazy( std::string_view prefix, loader load )
+	{
+		walk( prefix, true, false )->load = std::move( load );
+	}
+
+	// Whether all loaders on the path to `prefix` (including its own) have run
+	bool is_loaded( std::string_view prefix ) const noexcept
+	{
+		const node *n = &_root;
+
+		for ( std::string_view segment : segments( prefix ) )
+		{
+			if ( n->load )
+				return false;
+
+			n = find_child( *n, segment );
+			if ( !n )
+				return true; // Nothing to load there
+		}
+
+		return !n->load;
+	}
+
+	// Returns all overloads of a command (empty when not found), running loaders on the way
+	std::span<const command> find( std::string_view name )
+	{
+		node *n = walk( name, false, true );
+		return n ? std::span<const command>( n->commands ) : std::span<const command>();
+	}
+
+	// All commands added so far (not the ones of pending loaders), overloads are next to each other
+	std::span<const command> commands() const noexcept { return _commands; }
+
+	// Commands taking `const context &` see all loaded commands in `context::commands`
+	result execute( std::string_view cmd_line, output &out )
+	{
+		tokenizer tok( cmd_line );
+		std::string_view command_name = tok.next().value_or( std::string_view() );
+
+		std::span<const command> overloads = find( command_name );
+
+		return detail::execute_overloads( overloads, overloads.begin(), command_name, out, [&]( const command &cmd ) {
+			tokenizer default_args( cmd.name_and_args + command_name.size() );
+			context ctx = { commands(), cmd_line, command_name, tok, default_args, out };
+			return cmd.desc.invoker( ctx );
+		} );
+	}
+
+	result execute( std::string_view cmd_line, std::span<char> output_buffer = {} )
+	{
+		output out = { output_buffer };
+		return execute( cmd_line, out );
+	}
+
+	/**
+	 * Calls `fn( overloads )` for every command whose name matches a glob pattern, running loaders on the way.
+	 * Pattern segments can contain `*` (any characters) and `?` (single character), but never match across
+	 * a `.` - `stats.*.reset` matches `stats.net.reset`, but not `stats.net.tcp.reset`.
+	 *
+	 * Literal segments are looked up directly, wildcard segments only scan siblings sharing their literal
+	 * prefix, so the cost depends on the number of matches rather than on the total number of commands.
+	 */
+	template <typename F>
+	void match( std::string_view pattern, F &&fn )
+	{
+		match( _root, pattern, fn );
+	}
+
+	/**
+	 * Executes all commands matching the glob pattern in the first token of `cmd_line` (see `match()`)
+	 * with the same arguments. `on_result( command_name, result, output )` is called after each command,
+	 * stringified results are written into `output_buffer`. Returns the number of matched commands.
+	 *
+	 * Example:
+	 *   ns.execute_glob( "log.*.enable 0", []( std::string_view name, conco::result r, const conco::output & ) {} );
+	 */
+	template <typename F>
+	size_t execute_glob( std::string_view cmd_line, F &&on_result, std::span<char> output_buffer = {} )
+	{
+		tokenizer tok( cmd_line );
+		std::string_view pattern = tok.next().value_or( std::string_view() );
+
+		size_t count = 0;
+
+		match( pattern, [&]( std::span<const command> overloads ) {
+			std::string_view command_name = overloads.front().name();
+			output out = { output_buffer };
+
+			// Every overload gets a copy of the argument tokenizer, the command line is split only once
+			auto try_overload = [&]( const command &cmd ) {
+				tokenizer default_args( cmd.name_and_args + command_name.size() );
+				context ctx = { commands(), cmd_line, command_name, tok, default_args, out };
+				return cmd.desc.invoker( ctx );
+			};
+
+			result r = detail::execute_overloads( overloads, overloads.begin(), command_name, out, try_overload );
+
+			++count;
+			on_result( command_name, r, std::as_const( out ) );
+		} );
+
+		return count;
+	}
+
+private:
+	struct node
+	{
+		std::string segment;
+		std::vector<std::unique_ptr<node>> children; // Sorted by segment
+		std::vector<command> commands;               // Overloads of the command named by the path to this node
+		loader load;                                 // Pending lazy loader
+	};
+
+	node _root;
+	std::vector<command> _commands; // Flat list of all added commands, see `commands()`
+
+	// Splits a name into segments, `a.b.c` -> `a`, `b`, `c`
+	struct segments
+	{
+		std::string_view name;
+
+		struct iterator
+		{
+			std::string_view rest;
+			size_t length = 0;
+			bool done = false;
+
+			iterator( std::string_view name, bool end ) : rest( name ), done( end ) { length = rest.find( '.' ); }
+
+			std::string_view operator*() const noexcept { return rest.substr( 0, length ); }
+			bool operator==( const iterator &other ) const noexcept { return done == other.done; }
+
+			iterator &operator++() noexcept
+			{
+				if ( length == std::string_view::npos )
+					done = true;
+				else
+				{
+					rest.remove_prefix( length + 1 );
+					length = rest.find( '.' );
+				}
+
+				return *this;
+			}
+		};
+
+		iterator begin() const noexcept { return { name, name.empty() }; }
+		iterator end() const noexcept { return { name, true }; }
+	};
+
+	static auto lower_bound( const node &n, std::string_view segment ) noexcept
+	{
+		return std::ranges::lower_bound( n.children, segment, {}, []( const auto &c ) {
+			return std::string_view( c->segment );
+		} );
+	}
+
+	static node *find_child( const node &n, std::string_view segment ) noexcept
+	{
+		auto iter = lower_bound( n, segment );
+		return iter != n.children.end() && ( *iter )->segment == segment ? iter->get() : nullptr;
+	}
+
+	// Runs a pending loader, the loader itself can add commands (and loaders) to this node
+	void load( node &n )
+	{
+		if ( n.load )
+		{
+			loader l = std::move( n.load );
+			n.load = nullptr;
+			l( *this );
+		}
+	}
+
+	template <typename F>
+	void match( node &n, std::string_view pattern, F &fn )
+	{
+		load( n );
+
+		size_t dot = pattern.find( '.' );
+		std::string_view segment = pattern.substr( 0, dot );
+		size_t wildcard = segment.find_first_of( "*?" );
+
+		// Matching children are collected first, loaders and commands can modify the tree
+		std::vector<node *> matches;
+
+		if ( wildcard == std::string_view::npos )
+		{
+			if ( node *child = find_child( n, segment ) )
+				matches.push_back( child );
+		}
+		else
+		{
+			std::string_view prefix = segment.substr( 0, wildcard );
+			for ( auto iter = lower_bound( n, prefix ); iter != n.children.end(); ++iter )
+			{
+				if ( !( *iter )->segment.starts_with( prefix ) )
+					break;
+
+				if ( detail::glob_match( segment, ( *iter )->segment ) )
+					matches.push_back( iter->get() );
+			}
+		}
+
+		for ( node *child : matches )
+		{
+			if ( dot != std::string_view::npos )
+				match( *child, pattern.substr( dot + 1 ), fn );
+			else
+			{
+				load( *child );
+				if ( !child->commands.empty() )
+					fn( std::span<const command>( child->commands ) );
+			}
+		}
+	}
+
+	node *walk( std::string_view name, bool create, bool run_loaders )
+	{
+		node *n = &_root;
+
+		for ( std::string_view segment : segments( name ) )
+		{
+			if ( run_loaders )
+				load( *n );
+
+			node *child = find_child( *n, segment );
+			if ( !child )
+			{
+				if ( !create )
+					return nullptr;
+
+				auto iter = lower_bound( *n, segment );
+				child = n->children.insert( iter, std::make_unique<node>() )->get();
+				child->segment = segment;
+			}
+
+			n = child;
+		}
+
+		if ( run_loaders )
+			load( *n );
+
+		return n;
+	}
+};
+
+} // namespace conco
@@ -0,0 +1,384 @@
+#pragma once
+
+#include "conco.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace conco {
+
+/**
+ * Hashed name index over a command span, turns command lookup into a hash table probe.
+ *
+ * Overloads must be next to each other (as `execute()` expects), only the first one is indexed.
+ * The index stores positions, so it is valid as long as the indexed span does not change.
+ */
+struct command_index
+{
+	std::vector<uint32_t> slots; // Open addressing table, first overload index + 1 (0 = empty slot)
+
+	command_index() = default;
+	explicit command_index( std::span<const command> commands ) { build( commands ); }
+
+	void build( std::span<const command> commands )
+	{
+		size_t capacity = 4;
+		while ( capacity < commands.size() * 2 )
+			capacity *= 2;
+
+		slots.assign( capacity, 0 );
+
+		for ( size_t c = 0; c < commands.size(); ++c )
+		{
+			std::string_view name = commands[c].name();
+			if ( c > 0 && commands[c - 1] == name )
+				continue;
+
+			size_t i = hash( name ) & ( capacity - 1 );
+			while ( slots[i] != 0 )
+				i = ( i + 1 ) & ( capacity - 1 );
+
+			slots[i] = static_cast<uint32_t>( c + 1 );
+		}
+	}
+
+	std::span<const command>::iterator find( std::span<const command> commands, std::string_view name ) const noexcept
+	{
+		if ( slots.empty() )
+			return commands.end();
+
+		size_t mask = slots.size() - 1;
+		for ( size_t i = hash( name ) & mask; slots[i] != 0; i = ( i + 1 ) & mask )
+			if ( commands[slots[i] - 1] == name )
+				return commands.begin() + ( slots[i] - 1 );
+
+		return commands.end();
+	}
+
+	// Layer for `layered_commands` using this index, `commands` must be the indexed span
+	command_layer layer( std::span<const command> commands ) const noexcept
+	{
+		return { commands, this, []( const void *index, std::span<const command> c, std::string_view name ) {
+			        return static_cast<const command_index *>( index )->find( c, name );
+		        } };
+	}
+
+	// FNV-1a hash of a command name
+	static constexpr size_t hash( std::string_view name ) noexcept
+	{
+		uint64_t h = 14695981039346656037ull;
+		for ( char ch : name )
+			h = ( h ^ static_cast<uint8_t>( ch ) ) * 1099511628211ull;
+
+		return static_cast<size_t>( h );
+	}
+};
+
+/**
+ * Immutable set of commands with a hashed name index.
+ *
+ * Overloads are stored next to each other (as `execute()` expects), `find()` returns the first one.
+ */
+struct command_snapshot
+{
+	std::vector<command> commands;
+	command_index index;
+	uint64_t version = 0;
+
+	std::span<const command> span() const noexcept { return commands; }
+
+	std::span<const command>::iterator find( std::string_view name ) const noexcept
+	{
+		return index.find( commands, name );
+	}
+
+	command_layer layer() const noexcept { return index.layer( commands ); }
+
+	// Builds the hashed index, call after `commands` are filled in
+	void build_index() { index.build( commands ); }
+};
+
+} // namespace conco
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco::detail {
+
+inline constexpr size_t reader_stripe_count = 16;
+
+// Spreads reader counters of different threads over separate cache lines
+inline size_t reader_stripe() noexcept
+{
+	static std::atomic<size_t> next_stripe = 0;
+	thread_local size_t stripe = next_stripe.fetch_add( 1, std::memory_order_relaxed ) % reader_stripe_count;
+	return stripe;
+}
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+/**
+ * Dynamic command registry, commands can be added and removed while other threads execute them.
+ *
+ * Readers never block and never wait: they pin the current immutable `command_snapshot` with
+ * a `reader` guard (one atomic increment of a striped reader counter) and look commands up by hash.
+ * Writers (serialized by a mutex) build a new snapshot, publish it atomically and retire the old one,
+ * which is freed once no reader can see it anymore (RCU with two alternating reader counter sets).
+ * A retired snapshot waits until every reader counter of both sets has been seen at zero, because
+ * readers can register on a stale set.
+ *
+ * Commands removed from the registry can still be executing in other threads, call `synchronize()`
+ * before unloading code or data they refer to.
+ *
+ * Example:
+ *   conco::registry reg;
+ *   reg.add( plugin_commands );
+ *
+ *   // Any thread
+ *   reg.execute( "plugin_cmd 1 2", buffer );
+ *
+ *   reg.remove( plugin_commands );
+ *   reg.synchronize();
+ *   unload_plugin();
+ */
+struct registry
+{
+	// Keeps a snapshot alive while reading it
+	struct reader
+	{
+		reader( const reader & ) = delete;
+		reader &operator=( const reader & ) = delete;
+		~reader() { _counter->fetch_sub( 1, std::memory_order_release ); }
+
+		const command_snapshot &snapshot() const noexcept { return *_snapshot; }
+		std::span<const command> commands() const noexcept { return _snapshot->span(); }
+
+		// Indexed layer for `layered_commands`, valid while the reader is alive
+		command_layer layer() const noexcept { return _snapshot->layer(); }
+
+		// Returns the first overload of a command, or `nullptr`
+		const command *find( std::string_view name ) const noexcept
+		{
+			auto iter = _snapshot->find( name );
+			return iter != commands().end() ? &*iter : nullptr;
+		}
+
+	private:
+		friend struct registry;
+
+		reader( const command_snapshot *s, std::atomic<uint32_t> *counter ) noexcept
+		  : _snapshot( s ), _counter( counter )
+		{}
+
+		const command_snapshot *_snapshot;
+		std::atomic<uint32_t> *_counter;
+	};
+
+	registry() : _current( new command_snapshot() ) { _current.load()->build_index(); }
+
+	registry( std::span<const command> commands ) : registry() { add( commands ); }
+
+	// No readers can be active at this point
+	~registry()
+	{
+		delete _current.load();
+		for ( auto &r : _retired )
+			delete r.snapshot;
+	}
+
+	registry( const registry & ) = delete;
+	registry &operator=( const registry & ) = delete;
+
+	// Pins the current snapshot. Wait-free.
+	reader read() const noexcept
+	{
+		uint32_t parity = _parity.load( std::memory_order_seq_cst );
+		auto *counter = &_counters[detail::reader_stripe()].count[parity];
+		counter->fetch_add( 1, std::memory_order_seq_cst );
+		return { _current.load( std::memory_order_seq_cst ), counter };
+	}
+
+	// Adds commands, overloads of existing commands are placed next to them
+	void add( std::span<const command> commands )
+	{
+		update( [&]( const command_snapshot &old, command_snapshot &s ) {
+			// Group overloads by name, in the order of their first appearance
+			std::unordered_map<std::string_view, size_t> group_indices;
+			std::vector<std::vector<const command *>> groups;
+
+			auto add_to_group = [&]( const command &cmd ) {
+				auto [iter, inserted] = group_indices.try_emplace( cmd.name(), groups.size() );
+				if ( inserted )
+					groups.emplace_back();
+
+				groups[iter->second].push_back( &cmd );
+			};
+
+			std::ranges::for_each( old.commands, add_to_group );
+			std::ranges::for_each( commands, add_to_group );
+
+			s.commands.reserve( old.commands.size() + commands.size() );
+			for ( const auto &group : groups )
+				for ( const command *cmd : group )
+					s.commands.push_back( *cmd );
+		} );
+	}
+
+	void add( const command &cmd ) { add( std::span<const command>( &cmd, 1 ) ); }
+
+	// Removes all overloads of a command, returns number of removed commands
+	size_t remove( std::string_view name )
+	{
+		return remove_if( [&]( const command &cmd ) { return cmd == name; } );
+	}
+
+	// Removes commands equal (same target, descriptor and name) to the given ones
+	size_t remove( std::span<const command> commands )
+	{
+		return remove_if( [&]( const command &cmd ) {
+			return std::ranges::any_of( commands, [&]( const command &c ) {
+				return c.target == cmd.target && &c.desc == &cmd.desc && c.name_and_args == cmd.name_and_args;
+			} );
+		} );
+	}
+
+	template <typename P>
+	size_t remove_if( P &&pred )
+	{
+		size_t removed = 0;
+
+		update( [&]( const command_snapshot &old, command_snapshot &s ) {
+			for ( const command &cmd : old.commands )
+			{
+				if ( pred( cmd ) )
+					++removed;
+				else
+					s.commands.push_back( cmd );
+			}
+		} );
+
+		return removed;
+	}
+
+	// Version of the current snapshot, incremented by every change
+	uint64_t version() const noexcept { return read().snapshot().version; }
+
+	// Waits until no reader can see commands removed before this call
+	void synchronize()
+	{
+		while ( true )
+		{
+			{
+				std::lock_guard lock( _write_mutex );
+				collect();
+
+				if ( _retired.empty() )
+					return;
+
+				// New readers go to the other counter set, so the current one can drain too
+				_parity.fetch_xor( 1, std::memory_order_seq_cst );
+			}
+
+			std::this_thread::yield();
+		}
+	}
+
+	// Executes a command from the current snapshot
+	result execute( std::string_view cmd_line, output &out ) const
+	{
+		reader r = read();
+
+		tokenizer tok( cmd_line );
+		std::string_view command_name = tok.next().value_or( std::string_view() );
+
+		std::span<const command> commands = r.commands();
+		auto cmd_iter = r.snapshot().find( command_name );
+
+		return detail::execute_overloads( commands, cmd_iter, command_name, out, [&]( const command &cmd ) {
+			tokenizer default_args( cmd.name_and_args + command_name.size() );
+			context ctx = { commands, cmd_line, command_name, tok, default_args, out };
+			return cmd.desc.invoker( ctx );
+		} );
+	}
+
+	result execute( std::string_view cmd_line, std::span<char> output_buffer = {} ) const
+	{
+		output out = { output_buffer };
+		return execute( cmd_line, out );
+	}
+
+private:
+	struct alignas( 64 ) reader_counters
+	{
+		std::atomic<uint32_t> count[2] = {}; // Active readers for each parity
+	};
+
+	// Bit `stripe * 2 + parity` for every reader counter
+	static_assert( detail::reader_stripe_count * 2 <= 32 );
+	static constexpr uint32_t all_counters = uint32_t( ( uint64_t( 1 ) << ( detail::reader_stripe_count * 2 ) ) - 1 );
+
+	struct retired_snapshot
+	{
+		command_snapshot *snapshot = nullptr;
+		uint32_t pending = all_counters; // Reader counters not seen at zero since the snapshot was retired
+	};
+
+	std::atomic<command_snapshot *> _current;
+	std::atomic<uint32_t> _parity = 0;
+	mutable reader_counters _counters[detail::reader_stripe_count];
+
+	std::mutex _write_mutex;
+	std::vector<retired_snapshot> _retired;
+
+	template <typename F>
+	void update( F &&build )
+	{
+		std::lock_guard lock( _write_mutex );
+
+		command_snapshot *old = _current.load( std::memory_order_relaxed );
+
+		auto s = std::make_unique<command_snapshot>();
+		build( *old, *s );
+		s->version = old->version + 1;
+		s->build_index();
+
+		// Readers of the old snapshot have incremented their counter before this store - on either parity, as
+		// the parity they have read can be stale. Once a counter is seen at zero after the store, none of its
+		// readers can hold the old snapshot. The parity flip lets counters of the previous set drain.
+		_current.store( s.release(), std::memory_order_seq_cst );
+		_parity.fetch_xor( 1, std::memory_order_seq_cst );
+
+		_retired.push_back( { old, all_counters } );
+		collect();
+	}
+
+	// Frees retired snapshots no reader can see anymore
+	void collect()
+	{
+		uint32_t idle = 0;
+		for ( size_t i = 0; i < detail::reader_stripe_count; ++i )
+			for ( uint32_t parity = 0; parity < 2; ++parity )
+				if ( _counters[i].count[parity].load( std::memory_order_seq_cst ) == 0 )
+					idle |= uint32_t( 1 ) << ( i * 2 + parity );
+
+		for ( retired_snapshot &r : _retired )
+			r.pending &= ~idle;
+
+		std::erase_if( _retired, []( const retired_snapshot &r ) {
+			if ( r.pending != 0 )
+				return false;
+
+			delete r.snapshot;
+			return true;
+		} );
+	}
+};
+
+} // namespace conco
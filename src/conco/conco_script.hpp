@@ -0,0 +1,824 @@
+#pragma once
+
+#include "conco_image.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace conco {
+
+/**
+ * Value of a script variable. Strings are views into the script source (or into text provided by the host).
+ */
+struct script_value
+{
+	enum class kind : uint8_t
+	{
+		none, // Passed as a missing argument, default argument value is used
+		integer,
+		floating,
+		string,
+	};
+
+	kind type = kind::none;
+	int64_t integer = 0;
+	double floating = 0.0;
+	std::string_view string;
+
+	script_value() = default;
+
+	template <typename T>
+	  requires std::is_integral_v<T>
+	script_value( T v ) noexcept : type( kind::integer ), integer( static_cast<int64_t>( v ) )
+	{}
+
+	template <typename T>
+	  requires std::is_floating_point_v<T>
+	script_value( T v ) noexcept : type( kind::floating ), floating( static_cast<double>( v ) )
+	{}
+
+	script_value( std::string_view v ) noexcept : type( kind::string ), string( v ) {}
+	script_value( const char *v ) noexcept : script_value( std::string_view( v ) ) {}
+
+	// Integer or float literal, any other text is a string
+	static script_value parse( std::string_view text ) noexcept
+	{
+		const char *end = text.data() + text.size();
+
+		int64_t i = 0;
+		if ( auto [ptr, ec] = std::from_chars( text.data(), end, i ); ec == std::errc() && ptr == end )
+			return i;
+
+		double f = 0.0;
+		if ( auto [ptr, ec] = std::from_chars( text.data(), end, f ); ec == std::errc() && ptr == end )
+			return f;
+
+		return text;
+	}
+
+	bool is_number() const noexcept { return type == kind::integer || type == kind::floating; }
+	double as_double() const noexcept { return type == kind::integer ? static_cast<double>( integer ) : floating; }
+
+	bool operator==( const script_value &other ) const noexcept
+	{
+		if ( is_number() && other.is_number() )
+		{
+			return type == kind::integer && other.type == kind::integer ? integer == other.integer
+			                                                            : as_double() == other.as_double();
+		}
+
+		return type == other.type && string == other.string;
+	}
+};
+
+/**
+ * Result of `script::compile()` and `script::run()`.
+ */
+struct script_result
+{
+	bool success = false;
+	std::string_view statement = {}; // Statement which failed
+	size_t line = 0;                 // Line of the failed statement (1-based)
+	const char *message = "";        // Error description
+
+	size_t executed = 0; // Executed commands (`run()` only)
+	size_t failed = 0;   // Commands which did not return `result::success` (`run()` only)
+
+	explicit operator bool() const noexcept { return success; }
+};
+
+/**
+ * Small scripting layer with variables, conditionals and loops, compiled into bytecode.
+ *
+ *   set x 10                      // Variables hold integers, floats or strings
+ *   set y $x * 2                  // `+`, `-`, `*`, `/` and `%` of two operands
+ *   for i 0 $y 2 {                // From (inclusive), to (exclusive) and optional step
+ *     spawn orc $i
+ *   }
+ *   if $x >= 10 { log big } else if $x { log small } else { log zero }
+ *
+ * Blocks use the usual `{}` token syntax, statements inside are separated by newlines. `set`, `if`,
+ * `for` and `else` are keywords, all other statements are command lines whose arguments can be
+ * variables (`$name`, whole arguments only).
+ *
+ * Command lines without variables are prepared once by `compile()` and only invoked by `run()`.
+ * Command lines with variables are turned into binary requests (see `execute_binary()`) with constant
+ * arguments already encoded, variables are encoded straight from their typed values - numbers are
+ * formatted as text only when the argument type needs it. Commands which cannot take binary requests
+ * (overloads, `context` or `tokenizer` arguments) are executed from text with variables substituted.
+ *
+ * The source must outlive the script, compiled code refers to it.
+ *
+ * Example:
+ *   conco::script s( commands );
+ *   if ( auto r = s.compile( source ); !r )
+ *     std::println( "{}: {}", r.line, r.message );
+ *
+ *   *s.variable( "count" ) = 10;
+ *   s.run();
+ */
+struct script
+{
+	// `run()` stops when a script executes this many instructions (e.g. a loop which never ends)
+	size_t instruction_limit = 100'000'000;
+
+	explicit script( std::span<const command> commands ) : _commands( commands ) {}
+
+	script( const script & ) = delete;
+	script &operator=( const script & ) = delete;
+
+	script_result compile( std::string_view source )
+	{
+		_source = source;
+		_code.clear();
+		_registers.clear();
+		_variables.clear();
+		_invocations.clear();
+		_constants.clear();
+
+		script_result r = { .success = true };
+		compile_block( source, r );
+
+		if ( !r.success )
+		{
+			r.line = 1 + static_cast<size_t>( std::count( source.data(), r.statement.data(), '\n' ) );
+			_code.clear();
+		}
+
+		return r;
+	}
+
+	// Variable used by the compiled script, `nullptr` when the script does not use it
+	script_value *variable( std::string_view name ) noexcept
+	{
+		auto iter = _variables.find( name );
+		return iter != _variables.end() ? &_registers[iter->second] : nullptr;
+	}
+
+	// Calls `fn( name, value )` for every variable used by the compiled script
+	template <typename F>
+	void for_each_variable( F &&fn )
+	{
+		for ( auto &[name, index] : _variables )
+			fn( name, _registers[index] );
+	}
+
+	/**
+	 * Runs the compiled script. `on_result( statement, result, output )` is called after every executed
+	 * command, stringified results are written into `output_buffer`. Variables keep their values between runs.
+	 */
+	template <typename F>
+	script_result run( F &&on_result, std::span<char> output_buffer = {} )
+	{
+		script_result r = { .success = true };
+		size_t steps = 0;
+
+		auto fail = [&]( const instruction &ins, const char *message ) {
+			r.success = false;
+			r.statement = ins.statement;
+			r.line = 1 + static_cast<size_t>( std::count( _source.data(), ins.statement.data(), '\n' ) );
+			r.message = message;
+			return r;
+		};
+
+		for ( size_t pc = 0; pc < _code.size(); )
+		{
+			const instruction &ins = _code[pc++];
+
+			if ( ++steps > instruction_limit )
+				return fail( ins, "instruction limit exceeded" );
+
+			switch ( ins.op )
+			{
+				case opcode::invoke:
+				{
+					output out = { output_buffer };
+					result res = invoke( _invocations[ins.a], out );
+
+					++r.executed;
+					if ( res != result::success )
+						++r.failed;
+
+					on_result( ins.statement, res, std::as_const( out ) );
+					break;
+				}
+
+				case opcode::copy: _registers[ins.dst] = _registers[ins.a]; break;
+
+				case opcode::arithmetic:
+					if ( !arithmetic( ins.sub_op, _registers[ins.a], _registers[ins.b], _registers[ins.dst] ) )
+						return fail( ins, "invalid arithmetic operands" );
+					break;
+
+				case opcode::jump: pc = ins.target; break;
+
+				case opcode::jump_unless:
+				{
+					bool condition = false;
+					if ( !test( ins, condition ) )
+						return fail( ins, "invalid comparison operands" );
+
+					if ( !condition )
+						pc = ins.target;
+
+					break;
+				}
+
+				case opcode::loop:
+				{
+					const script_value &i = _registers[ins.a], &end = _registers[ins.b], &step = _registers[ins.dst];
+					if ( !i.is_number() || !end.is_number() || !step.is_number() || step.as_double() == 0.0 )
+						return fail( ins, "invalid loop range" );
+
+					if ( step.as_double() > 0.0 ? !( i.as_double() < end.as_double() )
+					                            : !( i.as_double() > end.as_double() ) )
+						pc = ins.target;
+
+					break;
+				}
+			}
+		}
+
+		return r;
+	}
+
+	script_result run( std::span<char> output_buffer = {} )
+	{
+		return run( []( std::string_view, result, const output & ) {}, output_buffer );
+	}
+
+private:
+	enum class opcode : uint8_t
+	{
+		invoke,      // Invokes `_invocations[a]`
+		copy,        // dst = a
+		arithmetic,  // dst = a <sub_op> b
+		jump,        // Continues at `target`
+		jump_unless, // Continues at `target` unless `a` is true (or `a <sub_op> b` when `b` is set)
+		loop,        // Continues at `target` unless `a` is before `b` in the direction of step `dst`
+	};
+
+	static constexpr uint32_t no_register = UINT32_MAX;
+
+	struct instruction
+	{
+		opcode op = opcode::jump;
+		char sub_op = 0; // Arithmetic or comparison operator (`<`, `l` for `<=`, `>`, `g` for `>=`, `=`, `!`)
+		uint32_t dst = no_register;
+		uint32_t a = no_register;
+		uint32_t b = no_register;
+		size_t target = 0;
+		std::string_view statement;
+	};
+
+	struct argument
+	{
+		uint32_t reg = no_register; // Variable, or `no_register` for a constant
+		const type_info *type = nullptr;
+		binary_kind kind = binary_kind::none; // Encoded constant in `_constants`
+		size_t offset = 0;
+		size_t size = 0;
+		std::string_view text; // Token in the statement
+	};
+
+	struct invocation
+	{
+		enum class mode : uint8_t
+		{
+			prepared, // Parsed by `compile()`
+			binary,   // Binary request built from constants and variables
+			text,     // Text with variables substituted
+		};
+
+		mode how = mode::text;
+		std::string_view statement;
+		uint16_t command_index = 0;
+		std::vector<argument> args;
+
+		prepared p;
+		std::unique_ptr<std::byte[]> storage;
+	};
+
+	std::span<const command> _commands;
+	std::string_view _source;
+
+	std::vector<instruction> _code;
+	std::vector<script_value> _registers; // Variables, constants and temporaries
+	std::unordered_map<std::string_view, uint32_t> _variables;
+	std::vector<invocation> _invocations;
+	std::vector<std::byte> _constants; // Encoded constant arguments of binary invocations
+
+	std::vector<std::byte> _request; // Reused request buffer
+	std::string _line;               // Reused command line buffer
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	// Tokens are views into the source, the preceding character tells how they were written
+	char prefix( std::string_view t ) const noexcept { return t.data() > _source.data() ? t.data()[-1] : '\0'; }
+
+	bool is_block( std::string_view t ) const noexcept { return prefix( t ) == '{'; }
+	bool is_quoted( std::string_view t ) const noexcept { return prefix( t ) == '"' || prefix( t ) == '\''; }
+	bool is_variable( std::string_view t ) const noexcept { return t.size() > 1 && t[0] == '$' && !is_quoted( t ); }
+
+	uint32_t add_register( script_value v = {} )
+	{
+		_registers.push_back( v );
+		return static_cast<uint32_t>( _registers.size() - 1 );
+	}
+
+	uint32_t variable_register( std::string_view name )
+	{
+		auto [iter, inserted] = _variables.try_emplace( name, 0 );
+		if ( inserted )
+			iter->second = add_register();
+
+		return iter->second;
+	}
+
+	// Register of a `$variable` or a constant literal
+	uint32_t operand( std::string_view t )
+	{
+		if ( is_variable( t ) )
+			return variable_register( t.substr( 1 ) );
+
+		return add_register( is_quoted( t ) ? script_value( t ) : script_value::parse( t ) );
+	}
+
+	size_t emit( instruction ins )
+	{
+		_code.push_back( ins );
+		return _code.size() - 1;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	void compile_block( std::string_view text, script_result &r )
+	{
+		stream_framer framer;
+
+		while ( r.success && !text.empty() )
+		{
+			size_t end = std::min( framer.find_end( text ), text.size() );
+			std::string_view statement = text.substr( 0, end );
+			text.remove_prefix( std::min( end + 1, text.size() ) );
+			framer.reset();
+
+			// Indentation is not a part of the statement
+			while ( !statement.empty() && tokenizer::is_whitespace( statement.front() ) )
+				statement.remove_prefix( 1 );
+
+			while ( !statement.empty() && tokenizer::is_whitespace( statement.back() ) )
+				statement.remove_suffix( 1 );
+
+			token first = tokenizer( statement ).next();
+			if ( first && !first->starts_with( '#' ) && !first->starts_with( "//" ) )
+				compile_statement( statement, r );
+		}
+	}
+
+	// Next token of a statement. Blocks are framed like statements (see `stream_framer`), quotes and brackets
+	// in their comment lines do not count, unlike in the tokenizer.
+	static token next_token( tokenizer &tok ) noexcept
+	{
+		if ( !tok.next_char_is( '{' ) )
+			return tok.next();
+
+		stream_framer framer;
+		for ( size_t length = 1; length <= tok.text.size(); ++length )
+		{
+			framer.find_end( tok.text.substr( 0, length ) );
+			if ( framer.scanned == length && framer.depth == 0 )
+			{
+				std::string_view block = tok.text.substr( 1, length - 2 );
+				tok.reset( tok.text.substr( length ) );
+				return block;
+			}
+		}
+
+		tok.reset( {} );
+		return std::nullopt;
+	}
+
+	void compile_statement( std::string_view statement, script_result &r )
+	{
+		tokenizer tok( statement );
+		std::string_view keyword = *tok.next();
+
+		if ( keyword == "set" )
+		{
+			token name = tok.next(), a = tok.next(), op = tok.next(), b = tok.next();
+			if ( !name || is_quoted( *name ) || name->empty() || !a )
+				return compile_error( statement, "expected `set <name> <value>`", r );
+
+			uint32_t dst = variable_register( name->starts_with( '$' ) ? name->substr( 1 ) : *name );
+
+			if ( !op )
+				emit( { .op = opcode::copy, .dst = dst, .a = operand( *a ), .statement = statement } );
+			else if ( op->size() == 1 && std::string_view( "+-*/%" ).contains( ( *op )[0] ) && b && !tok.next() )
+			{
+				emit( { .op = opcode::arithmetic,
+				        .sub_op = ( *op )[0],
+				        .dst = dst,
+				        .a = operand( *a ),
+				        .b = operand( *b ),
+				        .statement = statement } );
+			}
+			else
+				return compile_error( statement, "expected `set <name> <value> <+-*/%> <value>`", r );
+		}
+		else if ( keyword == "if" )
+			compile_if( statement, tok, r );
+		else if ( keyword == "for" )
+		{
+			token name = tok.next(), from = tok.next(), to = tok.next(), step = next_token( tok );
+			token body = step && is_block( *step ) ? std::exchange( step, std::nullopt ) : next_token( tok );
+
+			if ( !name || !from || !to || !body || !is_block( *body ) || tok.next() )
+				return compile_error( statement, "expected `for <name> <from> <to> [step] { ... }`", r );
+
+			uint32_t i = variable_register( name->starts_with( '$' ) ? name->substr( 1 ) : *name );
+			uint32_t end = add_register(), increment = add_register();
+
+			// Loop range is evaluated once, before the first iteration
+			emit( { .op = opcode::copy, .dst = i, .a = operand( *from ), .statement = statement } );
+			emit( { .op = opcode::copy, .dst = end, .a = operand( *to ), .statement = statement } );
+			emit( { .op = opcode::copy,
+			        .dst = increment,
+			        .a = step ? operand( *step ) : add_register( 1 ),
+			        .statement = statement } );
+
+			size_t check = emit( { .op = opcode::loop, .dst = increment, .a = i, .b = end, .statement = statement } );
+			compile_block( *body, r );
+
+			emit( { .op = opcode::arithmetic,
+			        .sub_op = '+',
+			        .dst = i,
+			        .a = i,
+			        .b = increment,
+			        .statement = statement } );
+			emit( { .op = opcode::jump, .target = check, .statement = statement } );
+			_code[check].target = _code.size();
+		}
+		else if ( keyword == "else" )
+			return compile_error( statement, "`else` without `if`", r );
+		else
+			compile_invocation( statement, keyword, tok );
+	}
+
+	void compile_if( std::string_view statement, tokenizer &tok, script_result &r )
+	{
+		token a = tok.next(), op = next_token( tok );
+		instruction ins = { .op = opcode::jump_unless, .statement = statement };
+
+		if ( !a || !op )
+			return compile_error( statement, "expected `if <value> [<comparison> <value>] { ... }`", r );
+
+		ins.a = operand( *a );
+
+		if ( !is_block( *op ) )
+		{
+			// Comparison operators are split by the tokenizer: `<=` is `<` and `=`, `==` is `=` and `=`
+			bool assignment = tokenizer( tok ).next() == "=";
+
+			if ( *op == "<" || *op == ">" )
+				ins.sub_op = assignment ? ( *op == "<" ? 'l' : 'g' ) : ( *op )[0];
+			else if ( ( *op == "=" || *op == "!" ) && assignment )
+				ins.sub_op = ( *op )[0];
+			else
+				return compile_error( statement, "unknown comparison operator", r );
+
+			if ( assignment )
+				tok.next();
+
+			token b = tok.next();
+			op = next_token( tok );
+
+			if ( !b || !op || !is_block( *op ) )
+				return compile_error( statement, "expected `if <value> <comparison> <value> { ... }`", r );
+
+			ins.b = operand( *b );
+		}
+
+		size_t jump_unless = emit( ins );
+		compile_block( *op, r );
+
+		if ( token next = tok.next(); next == "else" )
+		{
+			size_t jump_over = emit( { .op = opcode::jump, .statement = statement } );
+			_code[jump_unless].target = _code.size();
+
+			token body = next_token( tok );
+			if ( body == "if" )
+				compile_if( statement, tok, r );
+			else if ( body && is_block( *body ) && !tok.next() )
+				compile_block( *body, r );
+			else
+				return compile_error( statement, "expected `else { ... }` or `else if ...`", r );
+
+			_code[jump_over].target = _code.size();
+		}
+		else if ( next )
+			return compile_error( statement, "unexpected token after `if` block", r );
+		else
+			_code[jump_unless].target = _code.size();
+	}
+
+	static void compile_error( std::string_view statement, const char *message, script_result &r )
+	{
+		r.success = false;
+		r.statement = statement;
+		r.message = message;
+	}
+
+	void compile_invocation( std::string_view statement, std::string_view command_name, tokenizer tok )
+	{
+		invocation inv;
+		inv.statement = statement;
+
+		bool has_variables = false;
+		while ( token t = tok.next() )
+		{
+			argument arg = { .text = *t };
+			if ( is_variable( *t ) )
+			{
+				arg.reg = variable_register( t->substr( 1 ) );
+				has_variables = true;
+			}
+
+			inv.args.push_back( arg );
+		}
+
+		auto cmd_iter = std::ranges::find_if( _commands, [&]( const command &cmd ) { return cmd == command_name; } );
+
+		if ( !has_variables && cmd_iter != _commands.end() )
+		{
+			// Storage big enough for any overload
+			size_t size = 0, alignment = 1;
+			for ( auto iter = cmd_iter; iter != _commands.end() && *iter == command_name; ++iter )
+			{
+				size = std::max<size_t>( size, iter->desc.storage_size );
+				alignment = std::max<size_t>( alignment, iter->desc.storage_alignment );
+			}
+
+			inv.storage = std::make_unique<std::byte[]>( size + alignment );
+
+			output out = {};
+			if ( prepare( _commands, statement, { inv.storage.get(), size + alignment }, inv.p, out ) ==
+			     result::success )
+				inv.how = invocation::mode::prepared;
+			else
+			{
+				inv.p.reset();
+				inv.storage.reset();
+			}
+		}
+		else if ( cmd_iter != _commands.end() && can_encode( cmd_iter, command_name, inv.args ) )
+		{
+			inv.how = invocation::mode::binary;
+			inv.command_index = static_cast<uint16_t>( cmd_iter - _commands.begin() );
+
+			// Constant arguments are converted into their binary form right away
+			std::byte scratch[4096];
+			for ( size_t i = 0; i < inv.args.size(); ++i )
+			{
+				argument &arg = inv.args[i];
+				arg.type = cmd_iter->desc.arg_type_infos[i];
+
+				if ( arg.reg != no_register )
+					continue;
+
+				binary_writer writer{ scratch };
+				if ( !detail::write_image_arg( writer, arg.type, arg.text ) )
+				{
+					inv.how = invocation::mode::text;
+					break;
+				}
+
+				binary_value value = *binary_reader{ writer.bytes() }.next();
+				arg.kind = value.kind;
+				arg.offset = _constants.size();
+				arg.size = value.data.size();
+				_constants.insert( _constants.end(), value.data.begin(), value.data.end() );
+			}
+		}
+
+		emit( { .op = opcode::invoke,
+		        .a = static_cast<uint32_t>( _invocations.size() ),
+		        .statement = statement } );
+
+		_invocations.push_back( std::move( inv ) );
+	}
+
+	// Same rules as `compile_image()` - a single overload without context-dependent arguments
+	bool can_encode( std::span<const command>::iterator cmd_iter,
+	                 std::string_view command_name,
+	                 std::span<const argument> args ) const noexcept
+	{
+		const descriptor &desc = cmd_iter->desc;
+		size_t index = static_cast<size_t>( cmd_iter - _commands.begin() );
+
+		if ( index > UINT16_MAX || ( cmd_iter + 1 != _commands.end() && cmd_iter[1] == command_name ) ||
+		     !desc.preparer || desc.has_tail_args || args.size() > desc.arg_type_infos.size() )
+			return false;
+
+		return std::ranges::none_of( args, []( const argument &a ) { return a.text == "=" || a.text == ":"; } );
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	result invoke( invocation &inv, output &out )
+	{
+		switch ( inv.how )
+		{
+			case invocation::mode::prepared: return inv.p.invoke( out );
+			case invocation::mode::binary: return invoke_binary( inv, out );
+			default: break;
+		}
+
+		// Text with variables substituted
+		_line.clear();
+		const char *pos = inv.statement.data();
+		char buffer[64];
+
+		for ( const argument &arg : inv.args )
+		{
+			if ( arg.reg == no_register )
+				continue;
+
+			_line.append( pos, arg.text.data() );
+			pos = arg.text.data() + arg.text.size();
+
+			const script_value &v = _registers[arg.reg];
+			if ( v.type == script_value::kind::string )
+			{
+				bool quote = v.string.empty() || std::ranges::any_of( v.string, tokenizer::is_ident_term );
+				_line.append( quote ? "\"" : "" ).append( v.string ).append( quote ? "\"" : "" );
+			}
+			else if ( size_t len = to_text( v, buffer ) )
+				_line.append( buffer, len );
+			else
+				_line.append( "\"\"" );
+		}
+
+		_line.append( pos, inv.statement.data() + inv.statement.size() );
+		return execute( _commands, _line, out );
+	}
+
+	result invoke_binary( const invocation &inv, output &out )
+	{
+		size_t capacity = 3;
+		for ( const argument &arg : inv.args )
+		{
+			const script_value &v = arg.reg != no_register ? _registers[arg.reg] : script_value();
+			size_t text_size = v.type == script_value::kind::string ? v.string.size() : 0;
+			capacity += binary_reader::header_size + std::max<size_t>( { arg.size, 64, text_size } );
+		}
+
+		if ( _request.size() < capacity )
+			_request.resize( capacity );
+
+		binary_writer writer{ _request };
+		writer.begin_request( inv.command_index );
+
+		for ( const argument &arg : inv.args )
+		{
+			if ( arg.reg == no_register )
+				writer.write( arg.kind, _constants.data() + arg.offset, arg.size );
+			else
+				write_variable( writer, arg.type, _registers[arg.reg] );
+		}
+
+		return execute_binary( _commands, writer.bytes(), out );
+	}
+
+	// Numbers are passed as binary numbers to numeric arguments, formatted only for other types
+	static void write_variable( binary_writer &writer, const type_info *ti, const script_value &v ) noexcept
+	{
+		using detail::is_type_of;
+
+		bool integral = is_type_of<signed char, short, int, long, long long, unsigned char, unsigned short,
+		                           unsigned int, unsigned long, unsigned long long>( ti );
+		bool floating = is_type_of<float, double>( ti );
+
+		if ( v.type == script_value::kind::none )
+			writer.write( binary_kind::none, nullptr, 0 );
+		else if ( v.type == script_value::kind::string )
+			writer.value( v.string );
+		else if ( v.type == script_value::kind::integer && ( integral || floating ) )
+			writer.value( v.integer );
+		else if ( v.type == script_value::kind::floating && floating )
+			writer.value( v.floating );
+		else
+		{
+			char buffer[64];
+			writer.value( std::string_view( buffer, to_text( v, buffer ) ) );
+		}
+	}
+
+	static size_t to_text( const script_value &v, std::span<char> buffer ) noexcept
+	{
+		if ( !v.is_number() )
+			return 0;
+
+		size_t len = v.type == script_value::kind::integer ? to_chars( tag<int64_t>{}, buffer, v.integer )
+		                                                   : to_chars( tag<double>{}, buffer, v.floating );
+		return len ? len - 1 : 0; // Without the null-terminator
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+	static bool arithmetic( char op, const script_value &a, const script_value &b, script_value &out ) noexcept
+	{
+		if ( !a.is_number() || !b.is_number() )
+			return false;
+
+		if ( a.type == script_value::kind::integer && b.type == script_value::kind::integer )
+		{
+			// The only quotient which does not fit is `INT64_MIN / -1`
+			if ( ( op == '/' || op == '%' ) &&
+			     ( b.integer == 0 || ( b.integer == -1 && a.integer == std::numeric_limits<int64_t>::min() ) ) )
+				return false;
+
+			// Integers wrap around on overflow, computed as unsigned to avoid undefined behavior
+			auto x = static_cast<uint64_t>( a.integer ), y = static_cast<uint64_t>( b.integer );
+
+			switch ( op )
+			{
+				case '+': out = static_cast<int64_t>( x + y ); break;
+				case '-': out = static_cast<int64_t>( x - y ); break;
+				case '*': out = static_cast<int64_t>( x * y ); break;
+				case '/': out = a.integer / b.integer; break;
+				default: out = a.integer % b.integer; break;
+			}
+
+			return true;
+		}
+
+		double x = a.as_double(), y = b.as_double();
+		switch ( op )
+		{
+			case '+': out = x + y; break;
+			case '-': out = x - y; break;
+			case '*': out = x * y; break;
+			case '/': out = x / y; break;
+			default: out = std::fmod( x, y ); break;
+		}
+
+		return true;
+	}
+
+	bool test( const instruction &ins, bool &condition ) const noexcept
+	{
+		const script_value &a = _registers[ins.a];
+
+		if ( ins.b == no_register )
+		{
+			// Truthiness: non-zero numbers, strings parsed as bool (`false`, `off`...) or non-empty
+			if ( a.type == script_value::kind::string )
+				condition = from_string( tag<bool>{}, a.string ).value_or( !a.string.empty() );
+			else
+				condition = a.is_number() && a.as_double() != 0.0;
+
+			return true;
+		}
+
+		const script_value &b = _registers[ins.b];
+
+		if ( ins.sub_op == '=' || ins.sub_op == '!' )
+		{
+			condition = ( a == b ) == ( ins.sub_op == '=' );
+			return true;
+		}
+
+		int order = 0;
+		if ( a.is_number() && b.is_number() )
+		{
+			if ( a.type == script_value::kind::integer && b.type == script_value::kind::integer )
+				order = a.integer < b.integer ? -1 : ( a.integer > b.integer ? 1 : 0 );
+			else
+				order = a.as_double() < b.as_double() ? -1 : ( a.as_double() > b.as_double() ? 1 : 0 );
+		}
+		else if ( a.type == script_value::kind::string && b.type == script_value::kind::string )
+			order = a.string.compare( b.string );
+		else
+			return false;
+
+		switch ( ins.sub_op )
+		{
+			case '<': condition = order < 0; break;
+			case 'l': condition = order <= 0; break;
+			case '>': condition = order > 0; break;
+			default: condition = order >= 0; break;
+		}
+
+		return true;
+	}
+};
+
+} // namespace conco
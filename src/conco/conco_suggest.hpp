@@ -0,0 +1,215 @@
+#pragma once
+
+#include "conco.hpp"
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace conco::detail {
+
+// Levenshtein distance, bit-parallel (Myers/Hyyro) for patterns up to 64 characters.
+// Gives up and returns `max_distance + 1` as soon as the distance cannot get below `max_distance`.
+inline uint32_t edit_distance( std::string_view pattern, std::string_view text, uint32_t max_distance ) noexcept
+{
+	if ( pattern.size() > 64 )
+	{
+		// Rare long names, plain dynamic programming with a single row
+		std::vector<uint32_t> row( text.size() + 1 );
+		for ( size_t j = 0; j <= text.size(); ++j )
+			row[j] = static_cast<uint32_t>( j );
+
+		for ( size_t i = 1; i <= pattern.size(); ++i )
+		{
+			uint32_t diagonal = row[0];
+			row[0] = static_cast<uint32_t>( i );
+
+			for ( size_t j = 1; j <= text.size(); ++j )
+			{
+				uint32_t above = row[j];
+				row[j] = std::min( { row[j] + 1, row[j - 1] + 1, diagonal + ( pattern[i - 1] != text[j - 1] ) } );
+				diagonal = above;
+			}
+		}
+
+		return std::min( row.back(), max_distance + 1 );
+	}
+
+	if ( pattern.empty() )
+		return std::min( static_cast<uint32_t>( text.size() ), max_distance + 1 );
+
+	uint64_t peq[256] = {};
+	for ( size_t i = 0; i < pattern.size(); ++i )
+		peq[static_cast<uint8_t>( pattern[i] )] |= uint64_t( 1 ) << i;
+
+	uint64_t pv = ~uint64_t( 0 ), mv = 0;
+	uint64_t last_bit = uint64_t( 1 ) << ( pattern.size() - 1 );
+	uint32_t score = static_cast<uint32_t>( pattern.size() );
+
+	for ( size_t j = 0; j < text.size(); ++j )
+	{
+		uint64_t eq = peq[static_cast<uint8_t>( text[j] )];
+		uint64_t xv = eq | mv;
+		uint64_t xh = ( ( ( eq & pv ) + pv ) ^ pv ) | eq;
+		uint64_t ph = mv | ~( xh | pv );
+		uint64_t mh = pv & xh;
+
+		if ( ph & last_bit )
+			++score;
+		else if ( mh & last_bit )
+			--score;
+
+		// Every remaining text character can lower the score by one at most
+		if ( score > max_distance + ( text.size() - j - 1 ) )
+			return max_distance + 1;
+
+		ph = ( ph << 1 ) | 1; // Global distance, the first row grows with the text
+		mh <<= 1;
+		pv = mh | ~( xv | ph );
+		mv = ph & xv;
+	}
+
+	return std::min( score, max_distance + 1 );
+}
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+/**
+ * "Did you mean" suggestions for unknown command names.
+ *
+ * Names are indexed by their character bigrams. A name within edit distance `d` of the typed one
+ * shares all but at most `2 * d` of its distinct bigrams, so only names passing this count filter
+ * (and a length filter) are compared, with a bit-parallel edit distance kernel.
+ *
+ * Not thread-safe, `suggest()` reuses internal buffers.
+ *
+ * Example:
+ *   if ( conco::execute( commands, line, out ) == conco::result::command_not_found )
+ *     for ( auto &s : suggester.suggest( conco::tokenizer( line ).next().value_or( "" ) ) )
+ *       std::println( "Did you mean '{}'?", s.name );
+ */
+struct suggester
+{
+	struct suggestion
+	{
+		std::string_view name;
+		uint32_t distance = 0;
+	};
+
+	explicit suggester( std::span<const command> commands )
+	{
+		for ( const command &cmd : commands )
+			_names.push_back( cmd.name() );
+
+		std::ranges::sort( _names );
+		auto duplicates = std::ranges::unique( _names );
+		_names.erase( duplicates.begin(), duplicates.end() );
+
+		std::vector<uint16_t> bigrams;
+		for ( uint32_t i = 0; i < _names.size(); ++i )
+		{
+			collect_bigrams( _names[i], bigrams );
+			for ( uint16_t b : bigrams )
+				_postings[b].push_back( i );
+		}
+
+		_counts.resize( _names.size() );
+	}
+
+	// Up to `count` closest names within `max_distance` edits, closest first
+	std::span<const suggestion> suggest( std::string_view name, size_t count = 3, uint32_t max_distance = 2 )
+	{
+		_suggestions.clear();
+
+		collect_bigrams( name, _bigrams );
+		int64_t min_shared = static_cast<int64_t>( _bigrams.size() ) - 2 * static_cast<int64_t>( max_distance );
+
+		auto consider = [&]( uint32_t index ) {
+			std::string_view candidate = _names[index];
+			if ( candidate.size() + max_distance < name.size() || name.size() + max_distance < candidate.size() )
+				return;
+
+			if ( uint32_t d = detail::edit_distance( name, candidate, max_distance ); d <= max_distance )
+				_suggestions.push_back( { candidate, d } );
+		};
+
+		if ( min_shared <= 0 )
+		{
+			// Short names, the bigram filter cannot reject anything
+			for ( uint32_t i = 0; i < _names.size(); ++i )
+				consider( i );
+		}
+		else
+		{
+			for ( uint16_t b : _bigrams )
+			{
+				if ( auto iter = _postings.find( b ); iter != _postings.end() )
+				{
+					for ( uint32_t i : iter->second )
+					{
+						if ( _counts[i]++ == 0 )
+							_touched.push_back( i );
+					}
+				}
+			}
+
+			for ( uint32_t i : _touched )
+			{
+				if ( _counts[i] >= min_shared )
+					consider( i );
+
+				_counts[i] = 0;
+			}
+
+			_touched.clear();
+		}
+
+		auto order = []( const suggestion &a, const suggestion &b ) {
+			return a.distance != b.distance ? a.distance < b.distance : a.name < b.name;
+		};
+
+		if ( _suggestions.size() > count )
+		{
+			std::ranges::partial_sort( _suggestions, _suggestions.begin() + count, order );
+			_suggestions.resize( count );
+		}
+		else
+			std::ranges::sort( _suggestions, order );
+
+		return _suggestions;
+	}
+
+private:
+	std::vector<std::string_view> _names; // Sorted, unique
+	std::unordered_map<uint16_t, std::vector<uint32_t>> _postings;
+
+	std::vector<uint16_t> _counts; // Shared bigrams per name, zeroed after every query
+	std::vector<uint32_t> _touched;
+	std::vector<uint16_t> _bigrams;
+	std::vector<suggestion> _suggestions;
+
+	// Distinct bigrams of a name padded with `\0` on both sides, so the first and last characters count too
+	static void collect_bigrams( std::string_view name, std::vector<uint16_t> &out )
+	{
+		out.clear();
+
+		uint8_t prev = 0;
+		for ( size_t i = 0; i <= name.size(); ++i )
+		{
+			uint8_t ch = i < name.size() ? static_cast<uint8_t>( name[i] ) : 0;
+			out.push_back( static_cast<uint16_t>( ( prev << 8 ) | ch ) );
+			prev = ch;
+		}
+
+		std::ranges::sort( out );
+		auto duplicates = std::ranges::unique( out );
+		out.erase( duplicates.begin(), duplicates.end() );
+	}
+};
+
+} // namespace conco
@@ -0,0 +1,390 @@
+#pragma once
+
+#include "conco.hpp"
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace conco {
+
+template <typename T = void>
+struct task;
+
+/**
+ * Runs commands returning `task<T>` coroutines.
+ *
+ * Set `output::scheduler` before calling `execute()` and the command's coroutine is not run inline,
+ * it is registered here (`output::task_id` receives its id) and resumed by `run()` - call it from
+ * the thread (or the executor) which should run the tasks, usually once per frame. When the task
+ * finishes, its stringified result is passed to `on_complete`.
+ *
+ * Without a scheduler, tasks run synchronously inside `execute()`, `next_frame` does not suspend
+ * and the result is written into `output::buffer` as usual. A task suspended by another awaitable
+ * fails with `output::result_error`, it keeps running detached when resumed and its result is lost.
+ *
+ * Custom awaitables (waiting for I/O etc.) must not resume tasks directly from other threads,
+ * they should hand the coroutine handle over to `post()`, which is thread-safe.
+ */
+struct task_scheduler
+{
+	struct completion
+	{
+		uint64_t task_id = 0;
+		const command *cmd = nullptr;
+		std::string_view text;     // Stringified task result
+		bool result_error = false; // Stringification failed or the task threw an exception
+	};
+
+	std::function<void( const completion & )> on_complete;
+	size_t max_result_size = 1024;
+
+	task_scheduler() = default;
+	task_scheduler( const task_scheduler & ) = delete;
+	task_scheduler &operator=( const task_scheduler & ) = delete;
+
+	// Destroys all unfinished tasks
+	~task_scheduler()
+	{
+		for ( auto &[id, handle] : _tasks )
+			handle.destroy();
+	}
+
+	// Schedules a suspended coroutine to be resumed by the `frames`-th next `run()` call. Thread-safe.
+	void post( std::coroutine_handle<> handle, uint32_t frames = 1 )
+	{
+		std::lock_guard lock( _mutex );
+		_posted.push_back( { handle, std::max<uint32_t>( frames, 1 ) } );
+	}
+
+	// Resumes all coroutines due in this frame, returns their number
+	size_t run()
+	{
+		_ready.clear();
+		{
+			std::lock_guard lock( _mutex );
+			std::erase_if( _posted, [this]( posted_handle &p ) {
+				if ( --p.frames > 0 )
+					return false;
+
+				_ready.push_back( p.handle );
+				return true;
+			} );
+		}
+
+		for ( auto handle : _ready )
+			handle.resume();
+
+		return _ready.size();
+	}
+
+	// Number of unfinished tasks
+	size_t task_count() const
+	{
+		std::lock_guard lock( _mutex );
+		return _tasks.size();
+	}
+
+	// Internal, called by tasks
+	uint64_t start( std::coroutine_handle<> handle )
+	{
+		uint64_t id = 0;
+		{
+			std::lock_guard lock( _mutex );
+			id = ++_last_id;
+			_tasks.emplace( id, handle );
+		}
+
+		post( handle );
+		return id;
+	}
+
+	void finish( uint64_t id, const command *cmd, auto &&stringify )
+	{
+		{
+			std::lock_guard lock( _mutex );
+			_tasks.erase( id );
+		}
+
+		_result_buffer.assign( std::max<size_t>( max_result_size, 1 ), '\0' );
+		bool result_error = !stringify( std::span<char>( _result_buffer ) );
+
+		if ( on_complete )
+			on_complete( { id, cmd, result_error ? std::string_view{} : _result_buffer.data(), result_error } );
+	}
+
+private:
+	struct posted_handle
+	{
+		std::coroutine_handle<> handle;
+		uint32_t frames = 1;
+	};
+
+	mutable std::mutex _mutex;
+	std::vector<posted_handle> _posted;
+	std::unordered_map<uint64_t, std::coroutine_handle<>> _tasks; // Top-level coroutines
+	uint64_t _last_id = 0;
+
+	std::vector<std::coroutine_handle<>> _ready;
+	std::vector<char> _result_buffer;
+};
+
+/**
+ * Awaitable suspending the task for the given number of `task_scheduler::run()` calls (frames).
+ *
+ * Example:
+ *   conco::task<> wait( int frames ) { co_await conco::next_frame( frames ); }
+ */
+struct next_frame
+{
+	uint32_t frames = 1;
+
+	next_frame( uint32_t n = 1 ) noexcept : frames( n ) {}
+
+	bool await_ready() const noexcept { return frames == 0; }
+
+	template <typename P>
+	bool await_suspend( std::coroutine_handle<P> handle )
+	{
+		if ( !handle.promise().scheduler )
+			return false; // No scheduler, continue synchronously
+
+		handle.promise().scheduler->post( handle, frames );
+		return true;
+	}
+
+	void await_resume() const noexcept {}
+};
+
+} // namespace conco
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco::detail {
+
+struct task_promise_base
+{
+	task_scheduler *scheduler = nullptr;
+	const command *cmd = nullptr;
+	uint64_t task_id = 0;                 // Non-zero for top-level tasks owned by the scheduler
+	std::coroutine_handle<> continuation; // Task awaiting this one
+	std::exception_ptr exception;
+	std::atomic<bool> finished_or_detached = false; // Second one of them destroys a task run without a scheduler
+
+	std::suspend_always initial_suspend() const noexcept { return {}; }
+	void unhandled_exception() noexcept { exception = std::current_exception(); }
+
+	struct final_awaiter
+	{
+		bool await_ready() const noexcept { return false; }
+
+		template <typename P>
+		std::coroutine_handle<> await_suspend( std::coroutine_handle<P> handle ) noexcept
+		{
+			P &promise = handle.promise();
+
+			if ( promise.continuation )
+				return promise.continuation;
+
+			if ( promise.task_id )
+			{
+				// Exceptions cannot be propagated anywhere from here, they only mark the result as an error
+				promise.scheduler->finish( promise.task_id, promise.cmd, [&]( std::span<char> buffer ) {
+					return !promise.exception && promise.stringify( buffer );
+				} );
+
+				handle.destroy();
+			}
+			else if ( promise.finished_or_detached.exchange( true, std::memory_order_acq_rel ) )
+				handle.destroy(); // Detached by `handle_result()`, nobody waits for the result
+
+			return std::noop_coroutine();
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	final_awaiter final_suspend() const noexcept { return {}; }
+};
+
+template <typename T>
+struct task_promise : task_promise_base
+{
+	std::optional<T> value;
+
+	task<T> get_return_object() noexcept;
+
+	void return_value( T v ) { value.emplace( std::move( v ) ); }
+
+	bool stringify( std::span<char> buffer ) const noexcept
+	{
+		return value && to_chars( tag<T>{}, buffer, *value ) != 0;
+	}
+
+	T take_result()
+	{
+		if ( exception )
+			std::rethrow_exception( exception );
+
+		return std::move( *value );
+	}
+};
+
+template <>
+struct task_promise<void> : task_promise_base
+{
+	task<void> get_return_object() noexcept;
+
+	void return_void() const noexcept {}
+
+	bool stringify( std::span<char> buffer ) const noexcept
+	{
+		buffer[0] = '\0';
+		return true;
+	}
+
+	void take_result()
+	{
+		if ( exception )
+			std::rethrow_exception( exception );
+	}
+};
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+/**
+ * Lazily started coroutine, returned by asynchronous commands.
+ *
+ * Tasks can `co_await` other tasks (the result is passed back) and `next_frame`. When a command returns
+ * a task, its result is stringified when the coroutine finishes, see `task_scheduler`.
+ *
+ * Example:
+ *   conco::task<int> screenshot( std::string_view path )
+ *   {
+ *     co_await conco::next_frame(); // Wait for the frame to be rendered
+ *     co_return save_backbuffer( path );
+ *   }
+ */
+template <typename T>
+struct task
+{
+	using promise_type = detail::task_promise<T>;
+	using handle_type = std::coroutine_handle<promise_type>;
+
+	explicit task( handle_type h ) noexcept : _handle( h ) {}
+	task( task &&other ) noexcept : _handle( std::exchange( other._handle, nullptr ) ) {}
+	~task()
+	{
+		if ( _handle )
+			_handle.destroy();
+	}
+
+	task &operator=( task &&other ) noexcept
+	{
+		if ( this != &other )
+		{
+			if ( _handle )
+				_handle.destroy();
+
+			_handle = std::exchange( other._handle, nullptr );
+		}
+
+		return *this;
+	}
+
+	// Gives up ownership of the coroutine
+	handle_type release() noexcept { return std::exchange( _handle, nullptr ); }
+
+	bool await_ready() const noexcept { return !_handle || _handle.done(); }
+
+	// Starts this task from the awaiting one, inheriting its scheduler. Resumes the awaiting task when done.
+	template <typename P>
+	std::coroutine_handle<> await_suspend( std::coroutine_handle<P> awaiting ) noexcept
+	{
+		_handle.promise().scheduler = awaiting.promise().scheduler;
+		_handle.promise().cmd = awaiting.promise().cmd;
+		_handle.promise().continuation = awaiting;
+		return _handle;
+	}
+
+	T await_resume() { return _handle.promise().take_result(); }
+
+private:
+	handle_type _handle;
+};
+
+template <typename T>
+constexpr std::string_view type_name( tag<task<T>> ) noexcept
+{
+	return "task";
+}
+
+template <typename T>
+struct type_mapper<task<T>>
+{
+	using inner_type = T;
+};
+
+/**
+ * Handles `task<T>` command results - schedules the coroutine on `output::scheduler`, or runs it
+ * to completion right away when there is no scheduler.
+ */
+template <typename T>
+void handle_result( tag<task<T>>, context &ctx, task<T> &&t )
+{
+	auto handle = t.release();
+	auto &promise = handle.promise();
+	promise.cmd = ctx.out.cmd;
+
+	if ( ( promise.scheduler = ctx.out.scheduler ) != nullptr )
+	{
+		if ( !ctx.out.buffer.empty() )
+			ctx.out.buffer[0] = '\0';
+
+		promise.task_id = ctx.out.task_id = ctx.out.scheduler->start( handle );
+		return;
+	}
+
+	task<T> owner( handle );
+	handle.resume();
+
+	// Suspended by an awaitable which does not work without a scheduler. The awaitable may still resume
+	// the task, so it is not destroyed here but detached - it destroys itself when it finishes.
+	if ( !promise.finished_or_detached.exchange( true, std::memory_order_acq_rel ) )
+	{
+		owner.release();
+		ctx.out.result_error = true;
+	}
+	else if ( promise.exception )
+		std::rethrow_exception( promise.exception );
+	else if ( !ctx.out.buffer.empty() )
+		ctx.out.result_error = !promise.stringify( ctx.out.buffer );
+}
+
+} // namespace conco
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco::detail {
+
+template <typename T>
+task<T> task_promise<T>::get_return_object() noexcept
+{
+	return task<T>( std::coroutine_handle<task_promise<T>>::from_promise( *this ) );
+}
+
+inline task<void> task_promise<void>::get_return_object() noexcept
+{
+	return task<void>( std::coroutine_handle<task_promise<void>>::from_promise( *this ) );
+}
+
+} // namespace conco::detail
@@ -19,12 +19,18 @@ using token = std::optional<std::string_view>;
  *   "a {b c {d e} f} g" -> "a", "b c {d e} f", "g"
  *   "a [b '{c d}' e] f" -> "a", "b '{c d}' e", "f"
  *
+ * With `group_references` enabled (used for execution with a `variable_source`):
+ *   "a ${b}_c d"        -> "a", "${b}_c", "d"
+ *   "a (b c) $(d e) f"  -> "a", "(b c)", "$(d e)", "f"
+ *
  * Special characters:
  *   ';' -> indicates end of command, tokenizer will stop processing further input
  *   '\' -> backslash escape - next character is treated literally
  *   '"' or ''' -> starts a quoted string token, ends at matching quote
  *   '{' or '[' -> starts a block token, ends at matching '}' or ']'
  *   '=' or ':' -> single-character token, returned as-is (used for key-value assignments)
+ *   '${' -> variable reference, kept in the identifier up to the closing '}' (when grouping)
+ *   '(' or '$(' -> nested command, kept in the identifier up to the matching ')' (when grouping)
  *
  * It should be possible to parse a simple JSON-like structure using this tokenizer, e.g.:
  *   { x: 10, y: 20, name: "Point A", tags: ['tag1', 'tag2', 'tag3'] }
@@ -52,11 +58,15 @@ struct tokenizer
 	};
 
 	std::string_view text;
+	bool groups = false; // Keep variable references and nested commands in identifiers
 
 	tokenizer( const tokenizer & ) = default;
 	tokenizer( tokenizer && ) = default;
 
-	tokenizer( std::string_view str ) : text( str ) { consume_whitespace(); }
+	tokenizer( std::string_view str, bool group_references = false ) : text( str ), groups( group_references )
+	{
+		consume_whitespace();
+	}
 
 	bool empty() const noexcept { return text.empty(); }
 
@@ -68,6 +78,36 @@ struct tokenizer
 
 	bool next_char_is( char ch ) const noexcept { return !text.empty() && text[0] == ch; }
 
+	// Length of a parenthesized group at the start of `str` including the closing `)`, `npos` when not closed
+	static size_t group_length( std::string_view str ) noexcept
+	{
+		size_t depth = 0;
+		char prev_ch = '\0';
+		char quote_char = '\0';
+
+		for ( size_t i = 0; i < str.size(); ++i )
+		{
+			char ch = str[i];
+
+			if ( prev_ch == '\\' )
+				ch = '\0'; // Escaped character
+			else if ( quote_char )
+				quote_char = ch == quote_char ? '\0' : quote_char;
+			else if ( ch == '"' || ch == '\'' )
+				quote_char = ch;
+			else if ( ch == ';' )
+				break;
+			else if ( ch == '(' )
+				++depth;
+			else if ( ch == ')' && --depth == 0 )
+				return i + 1;
+
+			prev_ch = ch;
+		}
+
+		return std::string_view::npos;
+	}
+
 	void consume_whitespace()
 	{
 		size_t i = 0;
@@ -140,6 +180,28 @@ private:
 
 			if ( prev_ch != '\\' )
 			{
+				// Variable reference `${name}` is a part of the identifier
+				if ( groups && ch == '{' && prev_ch == '$' )
+				{
+					if ( size_t end = text.find( '}', i ); end != std::string_view::npos )
+					{
+						prev_ch = '}';
+						i = end + 1;
+						continue;
+					}
+				}
+
+				// Nested command `(cmd ...)` or `$(cmd ...)` is a part of the identifier
+				if ( groups && ch == '(' && ( i == 0 || prev_ch == '$' ) )
+				{
+					if ( size_t length = group_length( text.substr( i ) ); length != std::string_view::npos )
+					{
+						prev_ch = ')';
+						i += length;
+						continue;
+					}
+				}
+
 				if ( is_ident_term( ch ) )
 					break;
 			}
@@ -256,4 +318,92 @@ private:
 	}
 };
 
+/**
+ * Resumable statement framer for streamed input (sockets, files read in chunks, ...).
+ *
+ * Statements are separated by newlines, but newlines inside quotes and brackets do not count,
+ * so multi-line blocks are kept together. Lines starting with `#` or `//` are comments, quotes and
+ * brackets in them are ignored. The framer remembers its scanning state between calls, therefore
+ * each byte of input is scanned only once, no matter how the input was split into chunks.
+ *
+ * Usage:
+ *   pending += received_chunk;
+ *   while ( ( len = framer.find_end( pending ) ) != stream_framer::npos )
+ *   {
+ *     process( pending.substr( 0, len ) );
+ *     pending.erase( 0, len + 1 ); // Including the newline
+ *     framer.reset();
+ *   }
+ */
+struct stream_framer
+{
+	static constexpr size_t npos = std::string_view::npos;
+
+	size_t scanned = 0;     // Number of already scanned characters of the pending statement
+	size_t depth = 0;       // Bracket nesting depth
+	char quote_char = '\0'; // Quote character of the currently open string
+	bool escaped = false;   // Previous character was a backslash
+	bool line_start = true; // Only whitespace since the start of the current line
+	bool comment = false;   // Inside of a comment line
+
+	void reset() noexcept { *this = {}; }
+
+	// Returns length of the first complete statement in `pending` (without the newline), or `npos`
+	size_t find_end( std::string_view pending ) noexcept
+	{
+		for ( ; scanned < pending.size(); ++scanned )
+		{
+			char ch = pending[scanned];
+
+			if ( comment )
+			{
+				if ( ch != '\n' )
+					continue;
+
+				comment = false;
+			}
+			else if ( line_start && !quote_char && !escaped && ch != '\n' )
+			{
+				if ( ch == '/' && scanned + 1 == pending.size() )
+					return npos; // Not known yet whether this is a comment
+
+				if ( ch == '#' || ( ch == '/' && pending[scanned + 1] == '/' ) )
+				{
+					comment = true;
+					continue;
+				}
+
+				if ( tokenizer::is_whitespace( ch ) )
+					continue;
+
+				line_start = false;
+			}
+
+			if ( escaped )
+				escaped = false;
+			else if ( ch == '\\' )
+				escaped = true;
+			else if ( quote_char )
+			{
+				if ( ch == quote_char )
+					quote_char = '\0';
+			}
+			else if ( ch == '"' || ch == '\'' )
+				quote_char = ch;
+			else if ( ch == '{' || ch == '[' )
+				++depth;
+			else if ( ( ch == '}' || ch == ']' ) && depth > 0 )
+				--depth;
+			else if ( ch == '\n' )
+			{
+				line_start = true;
+				if ( depth == 0 )
+					return scanned;
+			}
+		}
+
+		return npos;
+	}
+};
+
 } // namespace conco
@@ -0,0 +1,291 @@
+#pragma once
+
+#include "../conco.hpp"
+
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+namespace conco {
+
+/**
+ * Lightweight completion handle for a command pushed into a `command_queue`.
+ *
+ * The submitter provides the output buffer and keeps the future alive until it becomes ready,
+ * the queue owner fills the buffer, stores the result and signals readiness. No allocations.
+ */
+struct command_future
+{
+	std::span<char> buffer; // Buffer for stringified command result, provided by the submitter
+
+	command_future( std::span<char> output_buffer = {} ) noexcept : buffer( output_buffer ) {}
+
+	command_future( const command_future & ) = delete;
+	command_future &operator=( const command_future & ) = delete;
+
+	bool is_ready() const noexcept { return _ready.load( std::memory_order_acquire ); }
+
+	// Blocks the calling thread until the command has been executed
+	result wait() const noexcept
+	{
+		_ready.wait( false, std::memory_order_acquire );
+		return _result;
+	}
+
+	// Result and stringified command result, valid only once the future is ready
+	result get_result() const noexcept { return _result; }
+	std::string_view text() const noexcept { return buffer.empty() ? std::string_view{} : buffer.data(); }
+
+	// Makes the future reusable for another command
+	void reset() noexcept { _ready.store( false, std::memory_order_relaxed ); }
+
+	// Called by the queue owner
+	void complete( result r ) noexcept
+	{
+		_result = r;
+		_ready.store( true, std::memory_order_release );
+		_ready.notify_all();
+	}
+
+private:
+	std::atomic<bool> _ready = false;
+	result _result = result::success;
+};
+
+/**
+ * Bounded lock-free multi-producer, single-consumer command queue.
+ *
+ * Any thread can push command lines (copied into a fixed ring of `SlotSize`-byte slots allocated once
+ * in the constructor) or prepared invocations (arguments parsed on the pushing thread, straight into
+ * the slot). The thread owning the commands then executes queued entries with `drain()`, usually once
+ * per frame with a budget. Pushing never blocks and never allocates, it fails when the queue is full.
+ *
+ * Example:
+ *   conco::command_queue queue( 1024 );
+ *
+ *   // Any thread:
+ *   queue.push( "set_volume 0.5" );
+ *
+ *   char buffer[64] = { 0 };
+ *   conco::command_future future( buffer );
+ *   queue.push_prepared( commands, "get_volume", &future );
+ *   future.wait();
+ *
+ *   // Main thread, every frame:
+ *   queue.drain( commands, 64 );
+ *
+ * Prepared entries refer to commands from the `commands` span passed to `push_prepared()`, so these
+ * must stay alive until the entries are drained.
+ */
+template <size_t SlotSize = 256>
+struct basic_command_queue
+{
+	static_assert( SlotSize >= 32 && SlotSize % 16 == 0, "Slot size must be a multiple of 16 bytes!" );
+
+	static constexpr size_t slot_size = SlotSize; // Maximal command line length (plus prepared storage size)
+
+	// Capacity is rounded up to the next power of two
+	explicit basic_command_queue( size_t capacity = 256 )
+	  : _mask( std::bit_ceil( std::max<size_t>( capacity, 2 ) ) - 1 ),
+	    _slots( std::make_unique<slot[]>( _mask + 1 ) )
+	{
+		for ( size_t i = 0; i <= _mask; ++i )
+			_slots[i].sequence.store( i, std::memory_order_relaxed );
+	}
+
+	// Pending entries are discarded without execution, their futures are never completed
+	~basic_command_queue() { clear(); }
+
+	basic_command_queue( const basic_command_queue & ) = delete;
+	basic_command_queue &operator=( const basic_command_queue & ) = delete;
+
+	size_t capacity() const noexcept { return _mask + 1; }
+
+	// Copies the command line into the queue. Returns `false` when the queue is full or the line is too long.
+	bool push( std::string_view cmd_line, command_future *future = nullptr ) noexcept
+	{
+		if ( cmd_line.size() > SlotSize )
+			return false;
+
+		return enqueue( [&]( slot &s ) noexcept {
+			std::memcpy( s.payload, cmd_line.data(), cmd_line.size() );
+			s.kind = entry_kind::line;
+			s.size = static_cast<uint32_t>( cmd_line.size() );
+			s.future = future;
+		} );
+	}
+
+	/**
+	 * Parses the command line on the calling thread and pushes the prepared invocation, so the
+	 * owner only invokes the command. Commands that cannot be prepared are pushed as plain lines.
+	 *
+	 * Prepared arguments can be views into the command line, so the line is copied into the slot
+	 * too and the prepared storage has to fit behind it.
+	 *
+	 * Returns `false` only when the entry could not be queued (queue full or the line is too long).
+	 * Parsing errors are reported through the future right away. Exceptions thrown by argument
+	 * parsing propagate to the caller, the claimed slot is skipped by `drain()`.
+	 */
+	bool push_prepared( std::span<const command> commands, std::string_view cmd_line, command_future *future = nullptr )
+	{
+		if ( cmd_line.size() > SlotSize )
+			return false;
+
+		return enqueue( [&]( slot &s ) {
+			std::memcpy( s.payload, cmd_line.data(), cmd_line.size() );
+			s.size = static_cast<uint32_t>( cmd_line.size() );
+			s.future = future;
+
+			output out = { future ? future->buffer : std::span<char>{} };
+			prepared p;
+
+			std::string_view line = { reinterpret_cast<const char *>( s.payload ), cmd_line.size() };
+			auto storage = std::span<std::byte>( s.payload ).subspan( cmd_line.size() );
+
+			result r = prepare( commands, line, storage, p, out );
+			if ( r == result::success )
+			{
+				s.kind = entry_kind::prepared;
+				s.cmd = std::exchange( p.cmd, nullptr );
+				s.storage = p.storage;
+			}
+			else if ( r == result::cannot_prepare )
+				s.kind = entry_kind::line;
+			else
+			{
+				s.kind = entry_kind::skip;
+				if ( future )
+					future->complete( r );
+			}
+		} );
+	}
+
+	/**
+	 * Executes at most `budget` queued entries on the calling thread, in the order they were pushed.
+	 * Only one thread at a time may drain the queue. Results of entries without a future are written
+	 * into `output_buffer`. Returns the number of executed entries.
+	 */
+	size_t drain( std::span<const command> commands,
+	              size_t budget = std::numeric_limits<size_t>::max(),
+	              std::span<char> output_buffer = {} )
+	{
+		size_t executed = 0;
+
+		while ( executed < budget )
+		{
+			slot &s = _slots[_dequeue_pos & _mask];
+			if ( s.sequence.load( std::memory_order_acquire ) != _dequeue_pos + 1 )
+				break; // Empty, or the producer is still filling the slot
+
+			if ( s.kind != entry_kind::skip )
+			{
+				output out = { s.future ? s.future->buffer : output_buffer };
+				result r = result::success;
+
+				if ( s.kind == entry_kind::line )
+					r = execute( commands, { reinterpret_cast<const char *>( s.payload ), s.size }, out );
+				else
+					r = prepared( *s.cmd, s.storage ).invoke( out );
+
+				if ( s.future )
+					s.future->complete( r );
+
+				++executed;
+			}
+
+			release( s );
+		}
+
+		return executed;
+	}
+
+	// Discards all pending entries. Must be called from the draining thread.
+	void clear() noexcept
+	{
+		while ( true )
+		{
+			slot &s = _slots[_dequeue_pos & _mask];
+			if ( s.sequence.load( std::memory_order_acquire ) != _dequeue_pos + 1 )
+				break;
+
+			if ( s.kind == entry_kind::prepared )
+				prepared( *s.cmd, s.storage ).reset();
+
+			release( s );
+		}
+	}
+
+private:
+	enum class entry_kind : uint8_t
+	{
+		skip,     // Nothing to execute (failed to prepare)
+		line,     // Command line text in `payload`
+		prepared, // Prepared invocation with storage in `payload`, after the command line it was parsed from
+	};
+
+	struct alignas( 64 ) slot
+	{
+		std::atomic<size_t> sequence = 0; // Slot state, see `enqueue()`
+		entry_kind kind = entry_kind::skip;
+		uint32_t size = 0;
+		const command *cmd = nullptr;
+		void *storage = nullptr;
+		command_future *future = nullptr;
+		alignas( 16 ) std::byte payload[SlotSize];
+	};
+
+	const size_t _mask;
+	std::unique_ptr<slot[]> _slots;
+	alignas( 64 ) std::atomic<size_t> _enqueue_pos = 0;
+	alignas( 64 ) size_t _dequeue_pos = 0;
+
+	// Bounded MPMC queue scheme by D. Vyukov: a slot with `sequence == pos` is free for the producer
+	// claiming position `pos`, `sequence == pos + 1` means it is filled and ready for the consumer.
+	bool enqueue( auto &&fill )
+	{
+		size_t pos = _enqueue_pos.load( std::memory_order_relaxed );
+		slot *s = nullptr;
+
+		while ( true )
+		{
+			s = &_slots[pos & _mask];
+			auto diff = static_cast<intptr_t>( s->sequence.load( std::memory_order_acquire ) - pos );
+
+			if ( diff == 0 )
+			{
+				if ( _enqueue_pos.compare_exchange_weak( pos, pos + 1, std::memory_order_relaxed ) )
+					break;
+			}
+			else if ( diff < 0 )
+				return false; // Full
+			else
+				pos = _enqueue_pos.load( std::memory_order_relaxed );
+		}
+
+		// The slot is published even when `fill` throws (e.g. from argument parsing), it stays `skip` then,
+		// an unpublished slot would block `drain()` forever
+		struct publisher
+		{
+			slot &s;
+			size_t pos;
+
+			~publisher() { s.sequence.store( pos + 1, std::memory_order_release ); }
+		} publish = { *s, pos };
+
+		fill( *s );
+		return true;
+	}
+
+	void release( slot &s ) noexcept
+	{
+		s.kind = entry_kind::skip;
+		s.sequence.store( _dequeue_pos + _mask + 1, std::memory_order_release );
+		++_dequeue_pos;
+	}
+};
+
+using command_queue = basic_command_queue<>;
+
+} // namespace conco
@@ -0,0 +1,297 @@
+#pragma once
+
+#include "../conco.hpp"
+
+#if !defined( __unix__ ) && !defined( __APPLE__ )
+	#error "conco::mapped_file requires a POSIX system (mmap, madvise)"
+#endif
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <memory>
+#include <utility>
+
+namespace conco {
+
+/**
+ * Read-only memory mapping of a whole file.
+ *
+ * Pages are loaded on demand when touched, the kernel is told the file will be read sequentially,
+ * so it reads ahead and can drop pages behind the reader. Move-only, the mapping is released
+ * by the destructor.
+ *
+ * Example:
+ *   conco::mapped_file file( "autoexec.cci" );
+ *   if ( file )
+ *     conco::execute_image( commands, file.bytes() );
+ */
+struct mapped_file
+{
+	mapped_file() = default;
+
+	explicit mapped_file( const char *path ) noexcept
+	{
+		int fd = ::open( path, O_RDONLY | O_CLOEXEC );
+		if ( fd < 0 )
+			return;
+
+		struct stat st;
+		if ( ::fstat( fd, &st ) == 0 && S_ISREG( st.st_mode ) )
+		{
+			size_t size = static_cast<size_t>( st.st_size );
+
+			// Empty files cannot be mapped, but they are valid (empty) scripts
+			if ( size == 0 )
+				_open = true;
+			else if ( void *data = ::mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 ); data != MAP_FAILED )
+			{
+				::madvise( data, size, MADV_SEQUENTIAL );
+
+				_data = static_cast<const std::byte *>( data );
+				_size = size;
+				_open = true;
+			}
+		}
+
+		::close( fd );
+	}
+
+	mapped_file( mapped_file &&other ) noexcept
+	  : _data( std::exchange( other._data, nullptr ) )
+	  , _size( std::exchange( other._size, 0 ) )
+	  , _open( std::exchange( other._open, false ) )
+	{}
+
+	mapped_file &operator=( mapped_file &&other ) noexcept
+	{
+		if ( this != &other )
+		{
+			close();
+			_data = std::exchange( other._data, nullptr );
+			_size = std::exchange( other._size, 0 );
+			_open = std::exchange( other._open, false );
+		}
+
+		return *this;
+	}
+
+	~mapped_file() { close(); }
+
+	explicit operator bool() const noexcept { return _open; }
+
+	std::span<const std::byte> bytes() const noexcept { return { _data, _size }; }
+	std::string_view text() const noexcept { return { reinterpret_cast<const char *>( _data ), _size }; }
+
+	// Tells the kernel an already processed part of the file will not be needed again, its pages can be dropped
+	void release( size_t offset, size_t size ) const noexcept
+	{
+		static const size_t page_size = static_cast<size_t>( ::sysconf( _SC_PAGESIZE ) );
+
+		size_t begin = ( offset + page_size - 1 ) / page_size * page_size; // Only whole pages
+		size_t end = std::min( offset + size, _size ) / page_size * page_size;
+
+		if ( _data && begin < end )
+			::madvise( const_cast<std::byte *>( _data ) + begin, end - begin, MADV_DONTNEED );
+	}
+
+	void close() noexcept
+	{
+		if ( _data )
+			::munmap( const_cast<std::byte *>( _data ), _size );
+
+		_data = nullptr;
+		_size = 0;
+		_open = false;
+	}
+
+private:
+	const std::byte *_data = nullptr;
+	size_t _size = 0;
+	bool _open = false;
+};
+
+/**
+ * Result of `execute_file()` and `execute_stream()`.
+ */
+struct file_result
+{
+	bool opened = false;     // The file could be opened (mapped or streamed)
+	bool mapped = false;     // The file was memory-mapped, otherwise it was streamed through a fixed-size buffer
+	bool read_error = false; // Reading from the stream failed, statements after the error were not executed
+	size_t executed = 0;     // Executed statements
+	size_t failed = 0;       // Statements which did not return `result::success`
+	size_t too_long = 0;     // Skipped statements longer than the stream buffer
+};
+
+} // namespace conco
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco::detail {
+
+// Executes a single framed statement, skipping empty lines and comments (`#` or `//`)
+template <typename F>
+void execute_statement( std::span<const command> commands,
+                        std::string_view statement,
+                        F &sink,
+                        std::span<char> output_buffer,
+                        file_result &r )
+{
+	if ( statement.ends_with( '\r' ) )
+		statement.remove_suffix( 1 );
+
+	token first = tokenizer( statement ).next();
+	if ( !first || first->starts_with( '#' ) || first->starts_with( "//" ) )
+		return;
+
+	output out = { output_buffer };
+	result res = execute( commands, statement, out );
+
+	++r.executed;
+	if ( res != result::success )
+		++r.failed;
+
+	sink( statement, res, std::as_const( out ) );
+}
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+/**
+ * Executes statements read from a file descriptor (pipe, socket, regular file...) through a fixed-size
+ * buffer, so memory use does not depend on the input size. Statements are framed by `stream_framer`
+ * (multi-line blocks in brackets and quotes are kept together) and passed to `execute()` as views into
+ * the buffer. Statements longer than the buffer are skipped and counted in `file_result::too_long`.
+ *
+ * `sink( statement, result, output )` is called after every executed statement.
+ */
+template <typename F>
+file_result execute_stream( std::span<const command> commands,
+                            int fd,
+                            F &&sink,
+                            std::span<char> output_buffer = {},
+                            size_t buffer_size = 64 * 1024 )
+{
+	file_result r;
+	r.opened = fd >= 0;
+	if ( !r.opened )
+		return r;
+
+	buffer_size = std::max<size_t>( buffer_size, 2 );
+	auto buffer = std::make_unique<char[]>( buffer_size );
+
+	stream_framer framer;
+	size_t filled = 0;
+	bool skipping = false; // Inside of a statement which did not fit into the buffer
+
+	while ( true )
+	{
+		ssize_t len = ::read( fd, buffer.get() + filled, buffer_size - filled );
+		if ( len < 0 && errno == EINTR )
+			continue;
+
+		r.read_error = len < 0;
+		if ( len <= 0 )
+			break;
+
+		filled += static_cast<size_t>( len );
+
+		size_t begin = 0;
+		size_t end = 0;
+
+		while ( ( end = framer.find_end( { buffer.get() + begin, filled - begin } ) ) != stream_framer::npos )
+		{
+			if ( skipping )
+				skipping = false;
+			else
+				detail::execute_statement( commands, { buffer.get() + begin, end }, sink, output_buffer, r );
+
+			begin += end + 1;
+			framer.reset();
+		}
+
+		if ( begin == 0 && filled == buffer_size )
+		{
+			// Pending statement fills the whole buffer, drop it and skip the rest of it
+			r.too_long += !skipping;
+			skipping = true;
+			framer.scanned = 0;
+			filled = 0;
+		}
+		else
+		{
+			// Keep the incomplete statement, the framer has already scanned it
+			std::memmove( buffer.get(), buffer.get() + begin, filled - begin );
+			filled -= begin;
+		}
+	}
+
+	if ( filled > 0 && !skipping )
+		detail::execute_statement( commands, { buffer.get(), filled }, sink, output_buffer, r );
+
+	return r;
+}
+
+/**
+ * Executes a script file with flat memory use. Regular files are memory-mapped with sequential access
+ * hints, statements are passed to `execute()` as views into the mapping and already processed pages
+ * are released while executing. Other files (pipes, devices) are streamed by `execute_stream()`.
+ *
+ * `sink( statement, result, output )` is called after every executed statement.
+ *
+ * Example:
+ *   conco::execute_file( commands, "replay.cfg", []( std::string_view, conco::result, const conco::output & ) {} );
+ */
+template <typename F>
+file_result execute_file( std::span<const command> commands,
+                          const char *path,
+                          F &&sink,
+                          std::span<char> output_buffer = {} )
+{
+	// Processed pages are released in steps, not after every statement
+	static constexpr size_t release_step = 4 * 1024 * 1024;
+
+	if ( mapped_file file( path ); file )
+	{
+		file_result r = { .opened = true, .mapped = true };
+
+		std::string_view text = file.text();
+		stream_framer framer;
+		size_t begin = 0, end = 0, released = 0;
+
+		while ( ( end = framer.find_end( text.substr( begin ) ) ) != stream_framer::npos )
+		{
+			detail::execute_statement( commands, text.substr( begin, end ), sink, output_buffer, r );
+			begin += end + 1;
+			framer.reset();
+
+			if ( begin - released >= release_step )
+			{
+				file.release( released, begin - released );
+				released = begin;
+			}
+		}
+
+		if ( begin < text.size() )
+			detail::execute_statement( commands, text.substr( begin ), sink, output_buffer, r );
+
+		return r;
+	}
+
+	int fd = ::open( path, O_RDONLY | O_CLOEXEC );
+	file_result r = execute_stream( commands, fd, sink, output_buffer );
+
+	if ( fd >= 0 )
+		::close( fd );
+
+	return r;
+}
+
+} // namespace conco
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "../conco.hpp"
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+
+namespace conco {
+
+/**
+ * Fixed set of reader/writer locks, selected by hashing a target object address.
+ *
+ * Commands on different objects most likely map to different stripes and run in parallel,
+ * commands on the same object always map to the same stripe and are serialized.
+ */
+template <size_t StripeCount = 64>
+struct lock_stripes
+{
+	static_assert( StripeCount > 0 && ( StripeCount & ( StripeCount - 1 ) ) == 0, "Stripe count must be a power of 2!" );
+
+	std::shared_mutex &get( const void *target ) noexcept
+	{
+		// Drop alignment bits, objects are rarely closer than 16 bytes to each other
+		size_t h = std::hash<const void *>{}( target );
+		h = ( h >> 4 ) ^ ( h >> 12 );
+		return _stripes[h & ( StripeCount - 1 )].mutex;
+	}
+
+private:
+	struct alignas( 64 ) stripe
+	{
+		std::shared_mutex mutex;
+	};
+
+	std::array<stripe, StripeCount> _stripes;
+};
+
+/**
+ * Concurrent variant of `execute()`, which can be called from multiple threads at once.
+ *
+ * The selected command overload is invoked under the stripe lock of its `command::target`:
+ * non-const methods and callables take it exclusively, const ones shared, free functions run
+ * without any locking (see `descriptor::access`).
+ *
+ * Commands must not execute other commands on the same target through the same stripes,
+ * locks are not recursive.
+ */
+template <size_t StripeCount>
+result execute_striped( std::span<const command> commands,
+                        std::string_view cmd_line,
+                        output &out,
+                        lock_stripes<StripeCount> &stripes )
+{
+	tokenizer tok( cmd_line );
+	std::string_view command_name = tok.next().value_or( std::string_view() );
+
+	auto cmd_iter = std::ranges::find_if( commands, [&]( const command &cmd ) { return cmd == command_name; } );
+
+	return detail::execute_overloads( commands, cmd_iter, command_name, out, [&]( const command &cmd ) {
+		tokenizer default_args( cmd.name_and_args + command_name.size() );
+		context ctx = { commands, cmd_line, command_name, tok, default_args, out };
+
+		switch ( cmd.desc.access )
+		{
+			case target_access::shared:
+			{
+				std::shared_lock lock( stripes.get( cmd.target ) );
+				return cmd.desc.invoker( ctx );
+			}
+
+			case target_access::exclusive:
+			{
+				std::unique_lock lock( stripes.get( cmd.target ) );
+				return cmd.desc.invoker( ctx );
+			}
+
+			default: break;
+		}
+
+		return cmd.desc.invoker( ctx );
+	} );
+}
+
+template <size_t StripeCount>
+result execute_striped( std::span<const command> commands,
+                        std::string_view cmd_line,
+                        lock_stripes<StripeCount> &stripes,
+                        std::span<char> output_buffer = {} )
+{
+	output out = { output_buffer };
+	return execute_striped( commands, cmd_line, out, stripes );
+}
+
+} // namespace conco
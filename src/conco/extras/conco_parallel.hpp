@@ -0,0 +1,347 @@
+#pragma once
+
+#include "../conco.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace conco {
+
+/**
+ * Fixed-size work-stealing thread pool for batches of independent tasks.
+ *
+ * `run()` splits the task range evenly between workers (the calling thread is one of them). Every
+ * worker takes tasks from the front of its own range, idle workers steal from the back of the other
+ * ranges. Both ends of a range live in a single atomic word, so there are no locks involved.
+ */
+struct thread_pool
+{
+	// `worker_count` includes the thread calling `run()`
+	explicit thread_pool( size_t worker_count = std::max( 1u, std::thread::hardware_concurrency() ) )
+	  : _worker_count( std::max<size_t>( worker_count, 1 ) ), _ranges( std::make_unique<range[]>( _worker_count ) )
+	{
+		for ( size_t i = 1; i < _worker_count; ++i )
+			_threads.emplace_back( [this, i]() { worker_loop( i ); } );
+	}
+
+	~thread_pool()
+	{
+		_stop.store( true, std::memory_order_relaxed );
+		_generation.fetch_add( 1, std::memory_order_release );
+		_generation.notify_all();
+
+		for ( auto &t : _threads )
+			t.join();
+	}
+
+	thread_pool( const thread_pool & ) = delete;
+	thread_pool &operator=( const thread_pool & ) = delete;
+
+	size_t size() const noexcept { return _worker_count; }
+
+	// Calls `fn( task_index, worker_index )` for every task in `[0, task_count)` and waits until all
+	// of them are done. Only one `run()` at a time is allowed.
+	template <typename F>
+	void run( size_t task_count, F &&fn )
+	{
+		if ( task_count == 0 )
+			return;
+
+		_job_data = &fn;
+		_job_func = []( void *data, size_t task, size_t worker ) {
+			( *static_cast<std::remove_reference_t<F> *>( data ) )( task, worker );
+		};
+
+		for ( size_t i = 0; i < _worker_count; ++i )
+		{
+			uint64_t begin = task_count * i / _worker_count;
+			uint64_t end = task_count * ( i + 1 ) / _worker_count;
+			_ranges[i].bounds.store( begin | ( end << 32 ), std::memory_order_relaxed );
+		}
+
+		_active.store( _worker_count - 1, std::memory_order_relaxed );
+		_generation.fetch_add( 1, std::memory_order_release );
+		_generation.notify_all();
+
+		process( 0 );
+
+		for ( size_t active = _active.load( std::memory_order_acquire ); active != 0;
+		      active = _active.load( std::memory_order_acquire ) )
+			_active.wait( active, std::memory_order_acquire );
+	}
+
+private:
+	struct alignas( 64 ) range
+	{
+		std::atomic<uint64_t> bounds = 0; // Next task (low 32 bits), end of the range (high 32 bits)
+	};
+
+	size_t _worker_count = 1;
+	std::unique_ptr<range[]> _ranges;
+	std::vector<std::thread> _threads;
+
+	void *_job_data = nullptr;
+	void ( *_job_func )( void *, size_t, size_t ) = nullptr;
+
+	std::atomic<uint32_t> _generation = 0; // Incremented for every `run()` to wake workers up
+	std::atomic<size_t> _active = 0;       // Number of workers (except the caller) still processing
+	std::atomic<bool> _stop = false;
+
+	void worker_loop( size_t worker )
+	{
+		uint32_t seen = 0;
+
+		while ( true )
+		{
+			_generation.wait( seen, std::memory_order_acquire );
+			seen = _generation.load( std::memory_order_acquire );
+
+			if ( _stop.load( std::memory_order_relaxed ) )
+				return;
+
+			process( worker );
+
+			if ( _active.fetch_sub( 1, std::memory_order_acq_rel ) == 1 )
+				_active.notify_all();
+		}
+	}
+
+	void process( size_t worker )
+	{
+		size_t task = 0;
+
+		while ( take( _ranges[worker], false, task ) )
+			_job_func( _job_data, task, worker );
+
+		for ( size_t i = 1; i < _worker_count; ++i )
+		{
+			range &victim = _ranges[( worker + i ) % _worker_count];
+			while ( take( victim, true, task ) )
+				_job_func( _job_data, task, worker );
+		}
+	}
+
+	// Takes a task from the front (owner) or from the back (thief) of a range
+	static bool take( range &r, bool from_back, size_t &task ) noexcept
+	{
+		uint64_t bounds = r.bounds.load( std::memory_order_relaxed );
+
+		while ( true )
+		{
+			uint64_t begin = bounds & 0xFFFFFFFFu;
+			uint64_t end = bounds >> 32;
+
+			if ( begin >= end )
+				return false;
+
+			uint64_t new_bounds = from_back ? ( begin | ( ( end - 1 ) << 32 ) ) : ( ( begin + 1 ) | ( end << 32 ) );
+			if ( r.bounds.compare_exchange_weak( bounds, new_bounds, std::memory_order_acq_rel ) )
+			{
+				task = from_back ? end - 1 : begin;
+				return true;
+			}
+		}
+	}
+};
+
+/**
+ * Results of `execute_parallel()`, in the order of input lines.
+ */
+struct batch_results
+{
+	struct entry
+	{
+		result r = result::success;
+		bool result_error = false; // Result stringification failed (see `output::result_error`)
+		uint32_t offset = 0;       // Stringified result in `arena`
+		uint32_t size = 0;
+	};
+
+	std::vector<entry> entries;
+	std::string arena; // All stringified results, back to back
+
+	std::string_view text( size_t i ) const noexcept
+	{
+		return std::string_view( arena ).substr( entries[i].offset, entries[i].size );
+	}
+};
+
+/**
+ * Executes a batch of command lines on a thread pool.
+ *
+ * Only commands tagged `@parallel` in their description ("spawn x y;@parallel Spawns an entity") are
+ * considered thread-safe and run concurrently. All other lines (including unknown commands) are serial,
+ * they run on the calling thread after all lines before them have finished and before any line after
+ * them starts. Parallel lines between two serial lines can be bound into dependency groups by
+ * `group_of( line )` - lines with the same non-empty key run in input order, one after another.
+ *
+ * Results are gathered in input order into `results`, each stringified result must fit into
+ * `max_result_size` bytes.
+ */
+template <typename G>
+void execute_parallel( std::span<const command> commands,
+                       std::span<const std::string_view> lines,
+                       batch_results &results,
+                       thread_pool &pool,
+                       G &&group_of,
+                       size_t max_result_size = 1024 );
+
+void execute_parallel( std::span<const command> commands,
+                       std::span<const std::string_view> lines,
+                       batch_results &results,
+                       thread_pool &pool );
+
+// Same as above, using a default pool with one worker per hardware thread
+void execute_parallel( std::span<const command> commands,
+                       std::span<const std::string_view> lines,
+                       batch_results &results );
+
+} // namespace conco
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+template <typename G>
+void execute_parallel( std::span<const command> commands,
+                       std::span<const std::string_view> lines,
+                       batch_results &results,
+                       thread_pool &pool,
+                       G &&group_of,
+                       size_t max_result_size )
+{
+	// Commands not tagged `@parallel` may not be thread-safe, lines calling them are serial
+	constexpr uint32_t serial = ~uint32_t( 0 );
+	std::vector<uint32_t> line_groups( lines.size(), 0 );
+
+	for ( size_t i = 0; i < lines.size(); ++i )
+	{
+		std::string_view command_name = tokenizer( lines[i] ).next().value_or( std::string_view{} );
+
+		auto cmd_iter = std::ranges::find_if( commands, [&]( const command &cmd ) { return cmd == command_name; } );
+		if ( cmd_iter == commands.end() || !cmd_iter->has_tag( "parallel" ) )
+			line_groups[i] = serial;
+	}
+
+	// Every worker writes stringified results into its own arena, these are merged at the end
+	struct worker_state
+	{
+		std::string arena;
+		std::vector<char> scratch;
+	};
+
+	std::vector<worker_state> workers( pool.size() );
+	std::vector<uint32_t> line_workers( lines.size() );
+
+	for ( worker_state &ws : workers )
+		ws.scratch.resize( std::max<size_t>( max_result_size, 1 ) );
+
+	results.entries.assign( lines.size(), {} );
+
+	auto run_line = [&]( uint32_t line, size_t worker ) {
+		worker_state &ws = workers[worker];
+		ws.scratch[0] = '\0';
+
+		output out = { ws.scratch };
+		batch_results::entry &e = results.entries[line];
+
+		e.r = execute( commands, lines[line], out );
+		e.result_error = out.result_error;
+
+		std::string_view text = {};
+		if ( !out.result_error )
+			text = { ws.scratch.data(), size_t( std::ranges::find( ws.scratch, '\0' ) - ws.scratch.begin() ) };
+
+		e.offset = static_cast<uint32_t>( ws.arena.size() );
+		e.size = static_cast<uint32_t>( text.size() );
+		ws.arena += text;
+
+		line_workers[line] = static_cast<uint32_t>( worker );
+	};
+
+	std::vector<uint32_t> group_sizes;
+	std::vector<uint32_t> group_offsets;
+	std::vector<uint32_t> cursors;
+	std::vector<uint32_t> order;
+	std::unordered_map<std::string_view, uint32_t> named_groups;
+
+	// Serial lines split the input into segments. Parallel lines of a segment are grouped, sorted by
+	// group (counting sort) and run on the pool, the serial lines after them then run on the calling
+	// thread (worker 0 of the pool) while nothing else does.
+	for ( size_t begin = 0, end = 0; begin < lines.size(); begin = end )
+	{
+		group_sizes.clear();
+		named_groups.clear();
+
+		for ( ; end < lines.size() && line_groups[end] != serial; ++end )
+		{
+			std::string_view key = group_of( lines[end] );
+			uint32_t group = static_cast<uint32_t>( group_sizes.size() );
+
+			if ( !key.empty() )
+				group = named_groups.try_emplace( key, group ).first->second;
+
+			if ( group == group_sizes.size() )
+				group_sizes.push_back( 0 );
+
+			line_groups[end] = group;
+			++group_sizes[group];
+		}
+
+		group_offsets.assign( group_sizes.size() + 1, 0 );
+		for ( size_t g = 0; g < group_sizes.size(); ++g )
+			group_offsets[g + 1] = group_offsets[g] + group_sizes[g];
+
+		order.resize( end - begin );
+		cursors.assign( group_offsets.begin(), group_offsets.end() - 1 );
+		for ( size_t i = begin; i < end; ++i )
+			order[cursors[line_groups[i]]++] = static_cast<uint32_t>( i );
+
+		pool.run( group_sizes.size(), [&]( size_t group, size_t worker ) {
+			for ( uint32_t i = group_offsets[group]; i < group_offsets[group + 1]; ++i )
+				run_line( order[i], worker );
+		} );
+
+		for ( ; end < lines.size() && line_groups[end] == serial; ++end )
+			run_line( static_cast<uint32_t>( end ), 0 );
+	}
+
+	results.arena.clear();
+
+	size_t total_size = 0;
+	for ( const worker_state &ws : workers )
+		total_size += ws.arena.size();
+
+	results.arena.reserve( total_size );
+
+	for ( size_t i = 0; i < lines.size(); ++i )
+	{
+		batch_results::entry &e = results.entries[i];
+		std::string_view text = std::string_view( workers[line_workers[i]].arena ).substr( e.offset, e.size );
+
+		e.offset = static_cast<uint32_t>( results.arena.size() );
+		results.arena += text;
+	}
+}
+
+inline void execute_parallel( std::span<const command> commands,
+                              std::span<const std::string_view> lines,
+                              batch_results &results,
+                              thread_pool &pool )
+{
+	execute_parallel( commands, lines, results, pool, []( std::string_view ) { return std::string_view{}; } );
+}
+
+inline void execute_parallel( std::span<const command> commands,
+                              std::span<const std::string_view> lines,
+                              batch_results &results )
+{
+	static thread_pool default_pool;
+	execute_parallel( commands, lines, results, default_pool );
+}
+
+} // namespace conco
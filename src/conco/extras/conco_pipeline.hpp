@@ -0,0 +1,139 @@
+#pragma once
+
+#include "../conco.hpp"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace conco {
+
+/**
+ * Result of `execute_pipelined()`.
+ */
+struct pipeline_result
+{
+	size_t prepared = 0;      // Lines parsed ahead by workers and only invoked by the calling thread
+	size_t parsed_inline = 0; // Lines executed from text by the calling thread (see `execute_pipelined()`)
+	size_t failed = 0;        // Lines which did not return `result::success`
+};
+
+/**
+ * Executes script lines strictly in order, while worker threads parse upcoming lines ahead.
+ *
+ * Tokenizing, command lookup, overload resolution and `from_string` of a line do not depend on
+ * the side effects of previous lines. Workers turn lines into `prepared` invocations in a ring of
+ * `window` slots, the calling thread only invokes them and calls `on_result( line_index, result, output )`.
+ *
+ * Lines which cannot be prepared (commands taking `context`, `tokenizer` or `output` arguments, too large
+ * argument storage) or failed to prepare are executed from text by the calling thread, with exactly the same
+ * result as `execute()`. When the calling thread catches up with the workers, it parses the next line itself
+ * instead of waiting, so the pipeline never stalls (and works with zero workers, too).
+ *
+ * Example:
+ *   conco::execute_pipelined( commands, lines, []( size_t, conco::result r, const conco::output & ) {} );
+ */
+template <typename F>
+pipeline_result execute_pipelined( std::span<const command> commands,
+                                   std::span<const std::string_view> lines,
+                                   F &&on_result,
+                                   size_t worker_count = std::max( 1u, std::thread::hardware_concurrency() ) - 1,
+                                   std::span<char> output_buffer = {},
+                                   size_t window = 256 )
+{
+	// Argument storage of one slot, commands with larger arguments are executed from text
+	static constexpr size_t storage_size = 256;
+
+	struct alignas( 64 ) slot
+	{
+		// `2 * line` = free for the line, `2 * line + 1` = line is prepared (or has to be parsed inline)
+		std::atomic<uint64_t> state = 0;
+		prepared p;
+		alignas( std::max_align_t ) std::byte storage[storage_size];
+	};
+
+	pipeline_result r;
+	if ( lines.empty() )
+		return r;
+
+	window = std::max<size_t>( window, 1 );
+	auto slots = std::make_unique<slot[]>( window );
+	for ( size_t i = 0; i < window; ++i )
+		slots[i].state.store( 2 * i, std::memory_order_relaxed );
+
+	std::atomic<size_t> next_line = 0; // Next line to be claimed by a worker (or by the calling thread)
+
+	auto produce = [&]() {
+		for ( size_t line = next_line.fetch_add( 1, std::memory_order_relaxed ); line < lines.size();
+		      line = next_line.fetch_add( 1, std::memory_order_relaxed ) )
+		{
+			slot &s = slots[line % window];
+
+			// Wait until the calling thread is done with the line `window` lines back
+			for ( uint64_t state = s.state.load( std::memory_order_acquire ); state != 2 * line;
+			      state = s.state.load( std::memory_order_acquire ) )
+				s.state.wait( state, std::memory_order_acquire );
+
+			output out = {};
+			if ( prepare( commands, lines[line], s.storage, s.p, out ) != result::success )
+				s.p.reset(); // Executed from text, including the error reporting
+
+			s.state.store( 2 * line + 1, std::memory_order_release );
+			s.state.notify_all();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for ( size_t i = 0; i < std::min( worker_count, lines.size() ); ++i )
+		workers.emplace_back( produce );
+
+	for ( size_t line = 0; line < lines.size(); ++line )
+	{
+		slot &s = slots[line % window];
+		output out = { output_buffer };
+		result res;
+
+		uint64_t state = s.state.load( std::memory_order_acquire );
+		size_t unclaimed = line;
+
+		if ( state != 2 * line + 1 && next_line.compare_exchange_strong( unclaimed, line + 1 ) )
+		{
+			// Workers are behind, do not wait for them
+			res = execute( commands, lines[line], out );
+			++r.parsed_inline;
+		}
+		else
+		{
+			for ( ; state != 2 * line + 1; state = s.state.load( std::memory_order_acquire ) )
+				s.state.wait( state, std::memory_order_acquire );
+
+			if ( s.p )
+			{
+				res = s.p.invoke( out );
+				s.p.reset();
+				++r.prepared;
+			}
+			else
+			{
+				res = execute( commands, lines[line], out );
+				++r.parsed_inline;
+			}
+		}
+
+		if ( res != result::success )
+			++r.failed;
+
+		on_result( line, res, std::as_const( out ) );
+
+		s.state.store( 2 * ( line + window ), std::memory_order_release );
+		s.state.notify_all();
+	}
+
+	for ( auto &t : workers )
+		t.join();
+
+	return r;
+}
+
+} // namespace conco
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "conco_command_queue.hpp"
+
+#include <array>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace conco {
+
+/**
+ * Routes commands to the threads they have to run on.
+ *
+ * Threads are registered by name, commands declare their affinity with a `@name` tag at the start
+ * of their description ("draw_mesh name;@render Draws a mesh") or get it assigned with `set_affinity()`.
+ * `execute()` can be called from any thread:
+ *   - commands without affinity (or with affinity to the calling thread) are executed inline,
+ *   - other commands are prepared on the calling thread and pushed into the lock-free queue of the
+ *     target thread, which executes them in its `drain()`.
+ *
+ * Results are always delivered through an optional `command_future`, which is completed right away
+ * for inline commands.
+ *
+ * Threads and affinities must be configured before the router is shared, routing itself is lock-free.
+ *
+ * Example:
+ *   conco::command_router router( commands );
+ *   size_t main_thread = router.add_thread( "main" );
+ *   size_t render_thread = router.add_thread( "render" );
+ *
+ *   // On the render thread:
+ *   router.bind_current_thread( render_thread );
+ *   router.drain( 64 ); // Every frame
+ *
+ *   // Anywhere:
+ *   router.execute( "draw_mesh teapot" );
+ */
+template <size_t SlotSize = 256>
+struct basic_command_router
+{
+	static constexpr size_t max_threads = 8;
+	static constexpr uint8_t no_affinity = 0xFF;
+
+	explicit basic_command_router( std::span<const command> commands, size_t queue_capacity = 256 )
+	  : _commands( commands ), _queue_capacity( queue_capacity )
+	{
+		for ( const command &cmd : commands )
+			_affinities.try_emplace( cmd.name(), no_affinity );
+	}
+
+	basic_command_router( const basic_command_router & ) = delete;
+	basic_command_router &operator=( const basic_command_router & ) = delete;
+
+	// Registers a thread, commands tagged with `@name` get affinity to it. Returns the thread index.
+	size_t add_thread( std::string_view name )
+	{
+		if ( _thread_count == max_threads )
+			return max_threads;
+
+		size_t index = _thread_count++;
+		_threads[index].name = name;
+		_threads[index].queue = std::make_unique<basic_command_queue<SlotSize>>( _queue_capacity );
+
+		// A tag on any overload gives affinity to the whole command
+		for ( const command &cmd : _commands )
+		{
+			uint8_t &affinity = _affinities[cmd.name()];
+			if ( affinity == no_affinity && cmd.has_tag( name ) )
+				affinity = static_cast<uint8_t>( index );
+		}
+
+		return index;
+	}
+
+	// Assigns affinity of all overloads of a command at registration time, overriding its tags.
+	// Empty `thread_name` makes the command affinity-free.
+	bool set_affinity( std::string_view command_name, std::string_view thread_name )
+	{
+		uint8_t affinity = no_affinity;
+		if ( !thread_name.empty() && ( affinity = find_thread( thread_name ) ) == no_affinity )
+			return false;
+
+		auto iter = _affinities.find( command_name );
+		if ( iter == _affinities.end() )
+			return false;
+
+		iter->second = affinity;
+		return true;
+	}
+
+	// Returns the affinity thread index of a command, `no_affinity` if it can run anywhere
+	uint8_t affinity( std::string_view command_name ) const noexcept
+	{
+		auto iter = _affinities.find( command_name );
+		return iter != _affinities.end() ? iter->second : no_affinity;
+	}
+
+	// Binds the calling thread to a registered thread slot, it then executes commands with this
+	// affinity inline and drains their queue
+	void bind_current_thread( size_t thread_index ) noexcept
+	{
+		if ( thread_index < _thread_count )
+			_threads[thread_index].owner.store( std::this_thread::get_id(), std::memory_order_release );
+	}
+
+	/**
+	 * Executes the command inline or queues it for the thread it has affinity to.
+	 * Returns `false` only when the target queue is full, the result is delivered through `future`.
+	 */
+	bool execute( std::string_view cmd_line, command_future *future = nullptr )
+	{
+		std::string_view command_name = tokenizer( cmd_line ).next().value_or( std::string_view{} );
+		uint8_t target = affinity( command_name );
+
+		if ( target == no_affinity ||
+		     _threads[target].owner.load( std::memory_order_acquire ) == std::this_thread::get_id() )
+		{
+			output out = { future ? future->buffer : std::span<char>{} };
+			result r = conco::execute( _commands, cmd_line, out );
+
+			if ( future )
+				future->complete( r );
+
+			return true;
+		}
+
+		return _threads[target].queue->push_prepared( _commands, cmd_line, future );
+	}
+
+	// Executes at most `budget` commands queued for the calling thread. Threads not bound with
+	// `bind_current_thread()` have no queue and execute nothing.
+	size_t drain( size_t budget = std::numeric_limits<size_t>::max(), std::span<char> output_buffer = {} )
+	{
+		auto this_id = std::this_thread::get_id();
+
+		for ( size_t i = 0; i < _thread_count; ++i )
+			if ( _threads[i].owner.load( std::memory_order_acquire ) == this_id )
+				return _threads[i].queue->drain( _commands, budget, output_buffer );
+
+		return 0;
+	}
+
+private:
+	struct thread_slot
+	{
+		std::string name;
+		std::atomic<std::thread::id> owner;
+		std::unique_ptr<basic_command_queue<SlotSize>> queue;
+	};
+
+	std::span<const command> _commands;
+	std::unordered_map<std::string_view, uint8_t> _affinities; // Thread index for every command name
+	size_t _queue_capacity = 0;
+
+	std::array<thread_slot, max_threads> _threads;
+	size_t _thread_count = 0;
+
+	uint8_t find_thread( std::string_view name ) const noexcept
+	{
+		for ( size_t i = 0; i < _thread_count; ++i )
+			if ( _threads[i].name == name )
+				return static_cast<uint8_t>( i );
+
+		return no_affinity;
+	}
+};
+
+using command_router = basic_command_router<>;
+
+} // namespace conco
@@ -0,0 +1,312 @@
+#pragma once
+
+#include "../conco.hpp"
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace conco {
+
+/**
+ * Deferred command scheduler with delays, repeats and priorities.
+ *
+ * Commands are parsed once when scheduled (see `prepare()`) and kept as prepared invocations in
+ * a timer heap. `tick()` moves due jobs into a ready heap ordered by priority and runs them until
+ * the time budget runs out, the rest stays ready for the next tick.
+ *
+ * Every job measures its own cost (moving average of its run times). A job expected not to fit into
+ * the remaining budget is deferred to the next tick, unless nothing has run in this tick yet or the
+ * job has already been deferred `max_deferrals` times - so expensive jobs cannot starve.
+ *
+ * Commands taking `tokenizer &`, `output &` or `const context &` cannot be prepared, these (and lines
+ * where `execute()` would pick such an overload) are kept as command lines and executed the usual way.
+ *
+ * Example:
+ *   conco::command_scheduler scheduler( commands );
+ *   scheduler.schedule( "autosave", now + 10s, { .period = 60s } );
+ *   scheduler.schedule( "rebuild_lods", now, { .priority = -1 } );
+ *
+ *   scheduler.tick( now, 2ms ); // Every frame
+ */
+template <size_t StorageSize = 128>
+struct basic_command_scheduler
+{
+	using clock = std::chrono::steady_clock;
+
+	struct job_options
+	{
+		int priority = 0;             // Higher priority jobs run first
+		clock::duration period = {};  // Non-zero for repeating jobs
+	};
+
+	struct completion
+	{
+		uint64_t job_id = 0;
+		result r = result::success;
+		std::string_view text; // Stringified command result
+	};
+
+	std::function<void( const completion & )> on_complete;
+	size_t max_result_size = 256;
+	uint32_t max_deferrals = 8;
+
+	explicit basic_command_scheduler( std::span<const command> commands ) : _commands( commands ) {}
+
+	basic_command_scheduler( const basic_command_scheduler & ) = delete;
+	basic_command_scheduler &operator=( const basic_command_scheduler & ) = delete;
+
+	/**
+	 * Schedules a command to run at `due` (and then every `options.period`, if set).
+	 * Returns the job id, or 0 when the command could not be parsed (`error` receives the reason).
+	 */
+	uint64_t schedule( std::string_view cmd_line,
+	                   clock::time_point due,
+	                   const job_options &options = {},
+	                   result *error = nullptr )
+	{
+		uint32_t index = allocate_job();
+		job &j = _jobs[index];
+
+		// Prepared arguments can be views into the command line, so they point into the job's own copy
+		j.line = cmd_line;
+
+		output out;
+		result r = prepare( _commands, j.line, j.storage, j.invocation, out );
+
+		if ( r != result::success && r != result::cannot_prepare )
+		{
+			if ( error )
+				*error = r;
+
+			release_job( index );
+			return 0;
+		}
+
+		j.due = due;
+		j.options = options;
+		j.active = true;
+
+		push_timer( index );
+		return make_id( index, j.generation );
+	}
+
+	// Same as above, with a delay relative to `now`
+	uint64_t schedule_after( std::string_view cmd_line,
+	                         clock::time_point now,
+	                         clock::duration delay,
+	                         const job_options &options = {},
+	                         result *error = nullptr )
+	{
+		return schedule( cmd_line, now + delay, options, error );
+	}
+
+	// Cancels a pending or repeating job
+	bool cancel( uint64_t job_id )
+	{
+		if ( !find_job( job_id ) )
+			return false;
+
+		release_job( static_cast<uint32_t>( job_id & 0xFFFFFFFFu ) - 1 );
+		return true;
+	}
+
+	// Moving average of the job run time, zero until the job runs for the first time
+	clock::duration cost( uint64_t job_id ) const
+	{
+		const job *j = find_job( job_id );
+		return j ? j->cost : clock::duration{};
+	}
+
+	// Number of scheduled jobs
+	size_t size() const noexcept { return _jobs.size() - _free_jobs.size(); }
+
+	/**
+	 * Runs jobs due at `now` by priority until `budget` is spent. Returns the number of executed jobs.
+	 */
+	size_t tick( clock::time_point now, clock::duration budget )
+	{
+		while ( !_timers.empty() && _timers.front().due <= now )
+		{
+			heap_entry e = pop_heap( _timers, timer_order );
+			if ( is_current( e ) )
+				push_heap( _ready, e, ready_order );
+		}
+
+		auto start = clock::now();
+		size_t executed = 0;
+
+		std::vector<heap_entry> deferred;
+
+		while ( !_ready.empty() )
+		{
+			auto spent = clock::now() - start;
+			if ( executed > 0 && spent >= budget )
+				break;
+
+			heap_entry e = pop_heap( _ready, ready_order );
+			if ( !is_current( e ) )
+				continue;
+
+			job &j = _jobs[e.index];
+
+			if ( executed > 0 && j.cost > budget - spent && j.deferrals < max_deferrals )
+			{
+				++j.deferrals;
+				deferred.push_back( e );
+				continue;
+			}
+
+			run_job( e.index, now );
+			++executed;
+		}
+
+		for ( const heap_entry &e : deferred )
+			push_heap( _ready, e, ready_order );
+
+		return executed;
+	}
+
+private:
+	struct job
+	{
+		alignas( 16 ) std::byte storage[StorageSize];
+		prepared invocation;
+		std::string line; // Prepared from, or executed for commands which cannot be prepared
+		clock::time_point due;
+		job_options options;
+		clock::duration cost = {};
+		uint32_t generation = 0; // Incremented when the job slot is reused, invalidates old ids and heap entries
+		uint32_t deferrals = 0;
+		bool active = false;
+	};
+
+	struct heap_entry
+	{
+		clock::time_point due;
+		int priority = 0;
+		uint32_t index = 0;
+		uint32_t generation = 0;
+	};
+
+	// `std::*_heap` functions keep the "largest" element at the front
+	static bool timer_order( const heap_entry &a, const heap_entry &b ) noexcept { return a.due > b.due; }
+
+	static bool ready_order( const heap_entry &a, const heap_entry &b ) noexcept
+	{
+		return a.priority != b.priority ? a.priority < b.priority : a.due > b.due;
+	}
+
+	std::span<const command> _commands;
+	std::deque<job> _jobs; // Deque keeps jobs in place, prepared invocations point into them
+	std::vector<uint32_t> _free_jobs;
+	std::vector<heap_entry> _timers;
+	std::vector<heap_entry> _ready;
+	std::vector<char> _result_buffer;
+
+	static uint64_t make_id( uint32_t index, uint32_t generation ) noexcept
+	{
+		return ( uint64_t( generation ) << 32 ) | ( index + 1 );
+	}
+
+	const job *find_job( uint64_t job_id ) const noexcept
+	{
+		uint32_t index = static_cast<uint32_t>( job_id & 0xFFFFFFFFu ) - 1;
+		if ( index >= _jobs.size() || !_jobs[index].active || _jobs[index].generation != ( job_id >> 32 ) )
+			return nullptr;
+
+		return &_jobs[index];
+	}
+
+	bool is_current( const heap_entry &e ) const noexcept
+	{
+		return _jobs[e.index].active && _jobs[e.index].generation == e.generation;
+	}
+
+	uint32_t allocate_job()
+	{
+		if ( _free_jobs.empty() )
+		{
+			_jobs.emplace_back();
+			return static_cast<uint32_t>( _jobs.size() - 1 );
+		}
+
+		uint32_t index = _free_jobs.back();
+		_free_jobs.pop_back();
+		return index;
+	}
+
+	void release_job( uint32_t index )
+	{
+		job &j = _jobs[index];
+		j.invocation.reset();
+		j.line.clear();
+		j.active = false;
+		j.cost = {};
+		j.deferrals = 0;
+		++j.generation;
+
+		_free_jobs.push_back( index );
+	}
+
+	void push_timer( uint32_t index )
+	{
+		const job &j = _jobs[index];
+		push_heap( _timers, { j.due, j.options.priority, index, j.generation }, timer_order );
+	}
+
+	static void push_heap( std::vector<heap_entry> &heap, const heap_entry &e, auto order )
+	{
+		heap.push_back( e );
+		std::push_heap( heap.begin(), heap.end(), order );
+	}
+
+	static heap_entry pop_heap( std::vector<heap_entry> &heap, auto order )
+	{
+		std::pop_heap( heap.begin(), heap.end(), order );
+		heap_entry e = heap.back();
+		heap.pop_back();
+		return e;
+	}
+
+	void run_job( uint32_t index, clock::time_point now )
+	{
+		job &j = _jobs[index];
+		uint64_t id = make_id( index, j.generation );
+
+		_result_buffer.assign( std::max<size_t>( max_result_size, 1 ), '\0' );
+		output out = { _result_buffer };
+
+		auto start = clock::now();
+		result r = j.invocation ? j.invocation.invoke( out ) : execute( _commands, j.line, out );
+		auto elapsed = clock::now() - start;
+
+		j.cost = ( j.cost == clock::duration{} ) ? elapsed : ( j.cost * 3 + elapsed ) / 4;
+		j.deferrals = 0;
+
+		if ( on_complete )
+			on_complete( { id, r, out.result_error ? std::string_view{} : _result_buffer.data() } );
+
+		// The callback could have cancelled the job
+		if ( !j.active || j.generation != ( id >> 32 ) )
+			return;
+
+		if ( j.options.period > clock::duration{} )
+		{
+			// Missed periods are skipped instead of running the job several times in a row
+			j.due += j.options.period;
+			if ( j.due <= now )
+				j.due = now + j.options.period;
+
+			push_timer( index );
+		}
+		else
+			release_job( index );
+	}
+};
+
+using command_scheduler = basic_command_scheduler<>;
+
+} // namespace conco
@@ -0,0 +1,467 @@
+#pragma once
+
+#include "../conco.hpp"
+
+#if !defined( __linux__ )
+	#error "conco::server requires Linux (epoll)"
+#endif
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace conco {
+
+/**
+ * Limits of a remote console `server`.
+ */
+struct server_config
+{
+	size_t max_sessions = 64;            // New connections above this limit are refused
+	size_t max_line_length = 64 * 1024;  // Sessions sending longer statements are closed
+	size_t max_pending_requests = 16;    // Unanswered requests per session before reading stops
+	size_t max_output_size = 256 * 1024; // Unsent output per session before reading stops
+	size_t read_chunk_size = 16 * 1024;  // Size of a single `recv()` call
+};
+
+/**
+ * Remote console server.
+ *
+ * Accepts connections on a Unix domain socket (and optionally on a loopback TCP port), splits
+ * incoming data into statements with `stream_framer` and hands complete command lines over to
+ * a user-supplied executor. The executor decides where the commands actually run (usually it
+ * pushes them into a queue drained by the thread owning the commands) and must eventually call
+ * `reply()` exactly once for every request - `reply()` can be called from any thread.
+ *
+ * Everything is non-blocking, `poll()` never waits longer than the given timeout, so it can be
+ * called directly from the host's main loop or from a dedicated thread.
+ *
+ * Backpressure: a session stops being read while it has too many unanswered requests or too much
+ * unsent output. Data then stays in the kernel socket buffers and eventually blocks the client.
+ *
+ * Example:
+ *   conco::server srv( [&]( conco::server::request &&req ) {
+ *     char buffer[256] = { 0 };
+ *     conco::execute( commands, req.line, buffer );
+ *     srv.reply( req.session, buffer );
+ *   } );
+ *
+ *   srv.listen_unix( "/tmp/my_app.sock" );
+ *
+ *   while ( running )
+ *   {
+ *     srv.poll();
+ *     // ...
+ *   }
+ */
+struct server
+{
+	struct request
+	{
+		uint64_t session = 0; // Pass to `reply()`
+		std::string line;     // Single statement (without the trailing newline)
+	};
+
+	using executor_t = std::function<void( request && )>;
+
+	explicit server( executor_t executor, const server_config &cfg = {} )
+	  : _executor( std::move( executor ) ), _config( cfg )
+	{
+		_epoll_fd = epoll_create1( EPOLL_CLOEXEC );
+		_wake_fd = eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+
+		if ( _epoll_fd >= 0 && _wake_fd >= 0 )
+			watch( _wake_fd, wake_id, EPOLLIN );
+	}
+
+	~server() { close(); }
+
+	server( const server & ) = delete;
+	server &operator=( const server & ) = delete;
+
+	bool is_valid() const noexcept { return _epoll_fd >= 0 && _wake_fd >= 0; }
+
+	// Starts listening on a Unix domain socket. A stale socket file at `path` (nobody accepts connections on it)
+	// is replaced, fails if another server is listening there or if `path` is not a socket.
+	bool listen_unix( const char *path )
+	{
+		sockaddr_un addr = {};
+		addr.sun_family = AF_UNIX;
+
+		if ( std::strlen( path ) >= sizeof( addr.sun_path ) )
+			return false;
+
+		std::strcpy( addr.sun_path, path );
+
+		struct stat st = {};
+		if ( ::lstat( path, &st ) == 0 && S_ISSOCK( st.st_mode ) && is_stale( addr ) )
+			::unlink( path );
+
+		return add_listener( AF_UNIX, reinterpret_cast<sockaddr *>( &addr ), sizeof( addr ) );
+	}
+
+	// Starts listening on a TCP port on the loopback interface only
+	bool listen_tcp( uint16_t port )
+	{
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons( port );
+		addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+
+		return add_listener( AF_INET, reinterpret_cast<sockaddr *>( &addr ), sizeof( addr ) );
+	}
+
+	// Processes all ready events, waits at most `timeout_ms` for them (0 = never blocks, -1 = forever).
+	// Returns number of processed events.
+	size_t poll( int timeout_ms = 0 )
+	{
+		if ( !is_valid() )
+			return 0;
+
+		epoll_event events[32];
+		int count = epoll_wait( _epoll_fd, events, 32, timeout_ms );
+
+		for ( int i = 0; i < count; ++i )
+		{
+			uint64_t id = events[i].data.u64;
+
+			if ( id == wake_id )
+				flush_replies();
+			else if ( id < first_session_id )
+				accept_sessions( _listeners[id - first_listener_id] );
+			else if ( auto iter = _sessions.find( id ); iter != _sessions.end() )
+			{
+				session &s = iter->second;
+
+				if ( events[i].events & EPOLLERR )
+					s.closing = true;
+
+				if ( !s.closing && ( events[i].events & ( EPOLLIN | EPOLLHUP ) ) )
+					read_session( s );
+
+				// The peer is gone - statements it sent are dispatched, but replies cannot be delivered
+				if ( events[i].events & EPOLLHUP )
+					s.closing = true;
+
+				if ( !s.closing && ( events[i].events & EPOLLOUT ) )
+					write_session( s );
+
+				update_session( iter );
+			}
+		}
+
+		return count > 0 ? static_cast<size_t>( count ) : 0;
+	}
+
+	// Sends a reply for a request. Thread-safe, the reply is delivered by the next `poll()` call.
+	void reply( uint64_t session, std::string_view text )
+	{
+		{
+			std::lock_guard lock( _replies_mutex );
+			_replies.push_back( { session, std::string( text ) } );
+		}
+
+		uint64_t one = 1;
+		[[maybe_unused]] auto r = ::write( _wake_fd, &one, sizeof( one ) );
+	}
+
+	size_t session_count() const noexcept { return _sessions.size(); }
+
+	// Closes all sessions and listeners
+	void close()
+	{
+		for ( auto &[id, s] : _sessions )
+			::close( s.fd );
+
+		for ( int fd : _listeners )
+			::close( fd );
+
+		_sessions.clear();
+		_listeners.clear();
+
+		if ( _wake_fd >= 0 )
+			::close( _wake_fd );
+
+		if ( _epoll_fd >= 0 )
+			::close( _epoll_fd );
+
+		_wake_fd = _epoll_fd = -1;
+	}
+
+private:
+	static constexpr uint64_t wake_id = 0;
+	static constexpr uint64_t first_listener_id = 1;
+	static constexpr uint64_t first_session_id = 1024;
+
+	struct session
+	{
+		int fd = -1;
+		uint64_t id = 0;
+		std::string input;
+		std::string output;
+		size_t output_offset = 0; // Already sent part of `output`
+		size_t pending_requests = 0;
+		stream_framer framer;
+		uint32_t watched_events = 0;
+		bool eof = false; // Peer has finished sending, the session is closed once all replies are sent
+		bool closing = false;
+
+		size_t unsent() const noexcept { return output.size() - output_offset; }
+	};
+
+	executor_t _executor;
+	server_config _config;
+
+	int _epoll_fd = -1;
+	int _wake_fd = -1;
+	uint64_t _next_session_id = first_session_id;
+
+	std::vector<int> _listeners;
+	std::unordered_map<uint64_t, session> _sessions;
+
+	std::mutex _replies_mutex;
+	std::vector<std::pair<uint64_t, std::string>> _replies;
+
+	bool watch( int fd, uint64_t id, uint32_t events, int op = EPOLL_CTL_ADD )
+	{
+		epoll_event ev = {};
+		ev.events = events;
+		ev.data.u64 = id;
+		return epoll_ctl( _epoll_fd, op, fd, &ev ) == 0;
+	}
+
+	// Whether nobody listens on the Unix domain socket anymore
+	static bool is_stale( const sockaddr_un &addr ) noexcept
+	{
+		int fd = ::socket( AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0 );
+		if ( fd < 0 )
+			return false;
+
+		int r = ::connect( fd, reinterpret_cast<const sockaddr *>( &addr ), sizeof( addr ) );
+		bool refused = r != 0 && errno == ECONNREFUSED;
+		::close( fd );
+		return refused;
+	}
+
+	bool add_listener( int family, const sockaddr *addr, socklen_t addr_len )
+	{
+		if ( !is_valid() || first_listener_id + _listeners.size() >= first_session_id )
+			return false;
+
+		int fd = ::socket( family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0 );
+		if ( fd < 0 )
+			return false;
+
+		int yes = 1;
+		if ( family == AF_INET )
+			setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof( yes ) );
+
+		if ( ::bind( fd, addr, addr_len ) != 0 || ::listen( fd, SOMAXCONN ) != 0 ||
+		     !watch( fd, first_listener_id + _listeners.size(), EPOLLIN ) )
+		{
+			::close( fd );
+			return false;
+		}
+
+		_listeners.push_back( fd );
+		return true;
+	}
+
+	void accept_sessions( int listener_fd )
+	{
+		while ( true )
+		{
+			int fd = ::accept4( listener_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC );
+			if ( fd < 0 )
+				break;
+
+			if ( _sessions.size() >= _config.max_sessions )
+			{
+				::close( fd );
+				continue;
+			}
+
+			session s;
+			s.fd = fd;
+			s.id = _next_session_id++;
+			s.watched_events = EPOLLIN;
+
+			if ( !watch( fd, s.id, s.watched_events ) )
+			{
+				::close( fd );
+				continue;
+			}
+
+			_sessions.emplace( s.id, std::move( s ) );
+		}
+	}
+
+	bool can_dispatch( const session &s ) const noexcept
+	{
+		return !s.closing && s.pending_requests < _config.max_pending_requests && s.unsent() < _config.max_output_size;
+	}
+
+	bool can_read( const session &s ) const noexcept { return !s.eof && can_dispatch( s ); }
+
+	void read_session( session &s )
+	{
+		while ( can_read( s ) )
+		{
+			size_t old_size = s.input.size();
+			s.input.resize( old_size + _config.read_chunk_size );
+
+			ssize_t len = ::recv( s.fd, s.input.data() + old_size, _config.read_chunk_size, 0 );
+			s.input.resize( old_size + ( len > 0 ? len : 0 ) );
+
+			if ( len == 0 )
+				s.eof = true;
+			else if ( len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+				s.closing = true;
+
+			dispatch_statements( s );
+
+			if ( len <= 0 )
+				break;
+		}
+	}
+
+	void dispatch_statements( session &s )
+	{
+		size_t begin = 0;
+
+		while ( s.pending_requests < _config.max_pending_requests )
+		{
+			std::string_view pending = std::string_view( s.input ).substr( begin );
+
+			size_t len = s.framer.find_end( pending );
+			if ( len == stream_framer::npos )
+			{
+				// The last statement before the end of the stream does not need a trailing newline
+				if ( !s.eof || pending.empty() )
+					break;
+
+				len = pending.size();
+			}
+
+			s.framer.reset();
+
+			std::string_view line = pending.substr( 0, len );
+			if ( !line.empty() && line.back() == '\r' )
+				line.remove_suffix( 1 );
+
+			begin = std::min( begin + len + 1, s.input.size() );
+
+			// Empty and comment lines are skipped like by `execute_file()`, they get no reply
+			token first = tokenizer( line ).next();
+			if ( !first || first->starts_with( '#' ) || first->starts_with( "//" ) )
+				continue;
+
+			++s.pending_requests;
+			_executor( { s.id, std::string( line ) } );
+		}
+
+		s.input.erase( 0, begin );
+		s.framer.scanned = std::min( s.framer.scanned, s.input.size() );
+
+		if ( s.input.size() > _config.max_line_length )
+			s.closing = true;
+	}
+
+	void write_session( session &s )
+	{
+		while ( s.unsent() > 0 )
+		{
+			ssize_t len = ::send( s.fd, s.output.data() + s.output_offset, s.unsent(), MSG_NOSIGNAL );
+			if ( len < 0 )
+			{
+				if ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR )
+					s.closing = true;
+
+				break;
+			}
+
+			s.output_offset += len;
+		}
+
+		if ( s.unsent() == 0 )
+		{
+			s.output.clear();
+			s.output_offset = 0;
+		}
+	}
+
+	// Updates epoll interest of a session after its state has changed, or closes it
+	void update_session( std::unordered_map<uint64_t, session>::iterator iter )
+	{
+		session &s = iter->second;
+
+		// Frame statements left in the input buffer by the backpressure
+		if ( can_dispatch( s ) && !s.input.empty() )
+			dispatch_statements( s );
+
+		if ( s.closing || ( s.eof && s.input.empty() && s.pending_requests == 0 && s.unsent() == 0 ) )
+		{
+			::close( s.fd ); // Also removes the descriptor from epoll
+			_sessions.erase( iter );
+			return;
+		}
+
+		uint32_t events = 0;
+		if ( can_read( s ) )
+			events |= EPOLLIN;
+
+		if ( s.unsent() > 0 )
+			events |= EPOLLOUT;
+
+		if ( events != s.watched_events )
+		{
+			s.watched_events = events;
+			watch( s.fd, s.id, events, EPOLL_CTL_MOD );
+		}
+	}
+
+	void flush_replies()
+	{
+		uint64_t counter = 0;
+		[[maybe_unused]] auto r = ::read( _wake_fd, &counter, sizeof( counter ) );
+
+		std::vector<std::pair<uint64_t, std::string>> replies;
+		{
+			std::lock_guard lock( _replies_mutex );
+			replies.swap( _replies );
+		}
+
+		for ( auto &[id, text] : replies )
+		{
+			auto iter = _sessions.find( id );
+			if ( iter == _sessions.end() )
+				continue; // Session was closed in the meantime
+
+			session &s = iter->second;
+			if ( s.pending_requests > 0 )
+				--s.pending_requests;
+
+			s.output += text;
+			s.output += '\n';
+
+			write_session( s );
+			update_session( iter );
+		}
+	}
+};
+
+} // namespace conco
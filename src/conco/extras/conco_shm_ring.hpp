@@ -0,0 +1,489 @@
+#pragma once
+
+#include "../conco.hpp"
+
+#if !defined( __linux__ )
+	#error "conco::shm_channel requires Linux (memfd, shm_open, futex)"
+#endif
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <ctime>
+
+namespace conco {
+
+/**
+ * Control block of a single ring buffer living in shared memory.
+ *
+ * Ring data is a sequence of 16-byte aligned records (`shm_record` header + payload). Producers
+ * reserve space by moving `head` with CAS and publish records by storing their size. The only
+ * consumer processes records in place and moves `tail`. Fields are on separate cache lines to
+ * avoid false sharing between producers and consumer.
+ */
+struct shm_ring_header
+{
+	alignas( 64 ) std::atomic<uint64_t> head; // Bytes reserved by producers
+	alignas( 64 ) std::atomic<uint64_t> tail; // Bytes released by consumer
+	alignas( 64 ) std::atomic<uint32_t> wake_seq; // Futex word, bumped when sleeping consumer should wake up
+	std::atomic<uint32_t> sleeping;               // Consumer is (about to be) sleeping on `wake_seq`
+};
+
+struct shm_record
+{
+	std::atomic<uint32_t> size; // Payload size + 1 once the record is published, 0 = not published yet
+	uint32_t tag;               // Request kind or result code
+	uint64_t id;                // User-provided request identifier, copied into the response
+};
+
+static_assert( sizeof( shm_record ) == 16 );
+static_assert( std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free );
+
+} // namespace conco
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco::detail {
+
+inline void futex_wait( std::atomic<uint32_t> &word, uint32_t expected, int timeout_ms ) noexcept
+{
+	timespec ts = { timeout_ms / 1000, ( timeout_ms % 1000 ) * 1000000L };
+	syscall( SYS_futex, &word, FUTEX_WAIT, expected, timeout_ms >= 0 ? &ts : nullptr, nullptr, 0 );
+}
+
+inline void futex_wake_all( std::atomic<uint32_t> &word ) noexcept
+{
+	syscall( SYS_futex, &word, FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0 );
+}
+
+} // namespace conco::detail
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+namespace conco {
+
+/**
+ * Multi-producer, single-consumer ring of variable-sized records in shared memory.
+ *
+ * Pushing and consuming never copies more than the payload itself and never makes a syscall,
+ * unless the consumer went to sleep in `wait()` - only then the producer wakes it up via futex.
+ * Consumed records are processed in place, payload views stay valid until the callback returns.
+ */
+struct shm_ring
+{
+	static constexpr size_t alignment = 16;
+
+	shm_ring_header *header = nullptr;
+	std::byte *data = nullptr;
+	size_t capacity = 0;    // Power of two
+	bool corrupted = false; // Consumer found an invalid record, the ring is no longer consumed
+
+	static constexpr size_t record_size( size_t payload_size ) noexcept
+	{
+		return ( sizeof( shm_record ) + payload_size + alignment - 1 ) & ~( alignment - 1 );
+	}
+
+	// Whether a record with given payload size can be pushed right now (exact for a single producer)
+	bool can_push( size_t payload_size ) const noexcept
+	{
+		uint64_t head = header->head.load( std::memory_order_relaxed );
+		uint64_t tail = header->tail.load( std::memory_order_acquire );
+		return head + reserved_size( head, record_size( payload_size ) ) - tail <= capacity;
+	}
+
+	// Publishes a new record, returns false when the ring is full. Can be called by multiple producers.
+	bool push( uint32_t tag, uint64_t id, std::span<const std::byte> payload ) noexcept
+	{
+		size_t total = record_size( payload.size() );
+		if ( total > capacity || payload.size() >= UINT32_MAX )
+			return false;
+
+		uint64_t head = header->head.load( std::memory_order_relaxed );
+		size_t needed = 0;
+
+		do
+		{
+			uint64_t tail = header->tail.load( std::memory_order_acquire );
+			needed = reserved_size( head, total );
+
+			if ( head + needed - tail > capacity )
+				return false;
+		} while ( !header->head.compare_exchange_weak( head, head + needed, std::memory_order_acq_rel ) );
+
+		// Records never wrap around, the rest of the ring is skipped with a padding record instead
+		if ( needed != total )
+		{
+			size_t padding = needed - total;
+			publish( record_at( head ), pad_tag, 0, padding - sizeof( shm_record ) );
+			head += padding;
+		}
+
+		shm_record *rec = record_at( head );
+		if ( !payload.empty() )
+			std::memcpy( static_cast<void *>( rec + 1 ), payload.data(), payload.size() );
+
+		publish( rec, tag, id, payload.size() );
+		return true;
+	}
+
+	bool empty() const noexcept
+	{
+		uint64_t tail = header->tail.load( std::memory_order_relaxed );
+		return record_at( tail )->size.load( std::memory_order_acquire ) == 0;
+	}
+
+	/**
+	 * Processes at most `max_count` published records with `f( tag, id, payload )`. When `f` returns
+	 * false, the record is left in the ring and processing stops. Single consumer only!
+	 *
+	 * Records come from other processes, a record reaching past the end of the ring marks the ring
+	 * as `corrupted` and nothing is consumed from it anymore.
+	 */
+	template <typename F>
+	size_t consume( size_t max_count, F &&f )
+	{
+		size_t count = 0;
+		uint64_t tail = header->tail.load( std::memory_order_relaxed );
+
+		while ( count < max_count && !corrupted )
+		{
+			shm_record *rec = record_at( tail );
+
+			uint32_t size = rec->size.load( std::memory_order_acquire );
+			if ( size == 0 )
+				break;
+
+			size_t total = record_size( size - 1 );
+			if ( total > capacity - ( tail & ( capacity - 1 ) ) )
+			{
+				corrupted = true;
+				break;
+			}
+
+			if ( rec->tag != pad_tag )
+			{
+				auto payload = std::span<const std::byte>{ reinterpret_cast<std::byte *>( rec + 1 ), size - 1 };
+				if ( !f( rec->tag, rec->id, payload ) )
+					break;
+
+				++count;
+			}
+
+			// Free space must be zeroed, so unpublished records always read as `size == 0`
+			std::memset( static_cast<void *>( rec ), 0, total );
+
+			tail += total;
+			header->tail.store( tail, std::memory_order_release );
+		}
+
+		return count;
+	}
+
+	// Waits until there is something to consume, returns false on timeout. Single consumer only!
+	bool wait( int timeout_ms = -1 ) noexcept
+	{
+		if ( !empty() )
+			return true;
+
+		uint32_t seq = header->wake_seq.load( std::memory_order_acquire );
+		header->sleeping.store( 1, std::memory_order_relaxed );
+		std::atomic_thread_fence( std::memory_order_seq_cst ); // Pairs with the fence in `publish()`
+
+		if ( empty() )
+			detail::futex_wait( header->wake_seq, seq, timeout_ms );
+
+		header->sleeping.store( 0, std::memory_order_relaxed );
+		return !empty();
+	}
+
+private:
+	static constexpr uint32_t pad_tag = UINT32_MAX;
+
+	shm_record *record_at( uint64_t pos ) const noexcept
+	{
+		return reinterpret_cast<shm_record *>( data + ( pos & ( capacity - 1 ) ) );
+	}
+
+	size_t reserved_size( uint64_t head, size_t total ) const noexcept
+	{
+		size_t to_end = capacity - ( head & ( capacity - 1 ) );
+		return total <= to_end ? total : to_end + total;
+	}
+
+	void publish( shm_record *rec, uint32_t tag, uint64_t id, size_t payload_size ) noexcept
+	{
+		rec->tag = tag;
+		rec->id = id;
+		rec->size.store( static_cast<uint32_t>( payload_size + 1 ), std::memory_order_release );
+
+		std::atomic_thread_fence( std::memory_order_seq_cst );
+		if ( header->sleeping.load( std::memory_order_relaxed ) )
+		{
+			header->wake_seq.fetch_add( 1, std::memory_order_release );
+			detail::futex_wake_all( header->wake_seq );
+		}
+	}
+};
+
+/**
+ * Shared-memory command channel between processes.
+ *
+ * The segment holds two rings: requests (command lines or binary requests, see `conco_binary.hpp`)
+ * written by the client process, and responses written by the host process. The host executes
+ * requests directly from the shared memory, without copying them anywhere:
+ *
+ *   // Host process
+ *   conco::shm_channel channel;
+ *   channel.create( "/my_app_console" );
+ *   ...
+ *   char buffer[256];
+ *   channel.drain( commands, 100, buffer ); // Called regularly, e.g. once per frame
+ *
+ *   // Client process
+ *   conco::shm_channel channel;
+ *   channel.open( "/my_app_console" );
+ *   channel.submit( "sum 1 2", 1 );
+ *   channel.responses.wait();
+ *   channel.receive( []( conco::result r, uint64_t id, std::string_view text ) { ... } );
+ *
+ * Anonymous segments can be created with `create_memfd()` and the descriptor passed to the other
+ * process (over a Unix socket or via `/proc/<pid>/fd/<fd>`), which then calls `attach()`.
+ *
+ * A channel has a single client, responses cannot be routed to more of them. `open()` and `attach()`
+ * fail while another client (a live process) is attached. Any thread of the client can submit
+ * requests, but only one thread at a time may receive responses.
+ */
+struct shm_channel
+{
+	enum request_kind : uint32_t
+	{
+		text_request = 0,
+		binary_request = 1,
+	};
+
+	shm_ring requests;
+	shm_ring responses;
+
+	shm_channel() = default;
+	shm_channel( const shm_channel & ) = delete;
+	shm_channel &operator=( const shm_channel & ) = delete;
+
+	~shm_channel() { close(); }
+
+	bool is_valid() const noexcept { return _segment != nullptr; }
+	bool is_corrupted() const noexcept { return requests.corrupted || responses.corrupted; }
+	int fd() const noexcept { return _fd; }
+
+	/**
+	 * Creates a named POSIX shared memory segment, each ring gets `ring_capacity` bytes (power of two).
+	 * Fails when the segment already exists - a segment left behind by a crashed host has to be removed
+	 * with `remove()` first.
+	 */
+	bool create( const char *name, size_t ring_capacity = 1024 * 1024 )
+	{
+		int fd = shm_open( name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600 );
+		return fd >= 0 && init( fd, ring_capacity );
+	}
+
+	// Removes a named segment, processes which have it mapped keep using it
+	static bool remove( const char *name ) noexcept { return shm_unlink( name ) == 0; }
+
+	// Creates an anonymous segment
+	bool create_memfd( size_t ring_capacity = 1024 * 1024 )
+	{
+		int fd = memfd_create( "conco_shm_channel", MFD_CLOEXEC );
+		return fd >= 0 && init( fd, ring_capacity );
+	}
+
+	// Opens a segment created by `create()` in another process
+	bool open( const char *name )
+	{
+		int fd = shm_open( name, O_RDWR | O_CLOEXEC, 0600 );
+		return fd >= 0 && attach( fd );
+	}
+
+	// Maps an existing segment from a file descriptor as its client, takes ownership of the descriptor
+	bool attach( int fd )
+	{
+		close();
+		_fd = fd;
+
+		// Ring capacity comes from another process, mapping more than the segment size would end in SIGBUS
+		segment_header header_copy = {};
+		struct stat st = {};
+		if ( ::pread( fd, &header_copy, sizeof( header_copy ), 0 ) != sizeof( header_copy ) ||
+		     ::fstat( fd, &st ) != 0 || header_copy.magic != segment_magic ||
+		     !std::has_single_bit( header_copy.ring_capacity ) || st.st_size < static_cast<off_t>( data_offset ) ||
+		     header_copy.ring_capacity > ( static_cast<uint64_t>( st.st_size ) - data_offset ) / 2 )
+		{
+			close();
+			return false;
+		}
+
+		if ( !map( header_copy.ring_capacity ) || !claim_client() )
+		{
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void close()
+	{
+		if ( _segment && _client )
+		{
+			uint32_t pid = static_cast<uint32_t>( ::getpid() );
+			client_pid().compare_exchange_strong( pid, 0, std::memory_order_acq_rel );
+		}
+
+		if ( _segment )
+			::munmap( _segment, _segment_size );
+
+		if ( _fd >= 0 )
+			::close( _fd );
+
+		_segment = nullptr;
+		_segment_size = 0;
+		_fd = -1;
+		_client = false;
+		requests = responses = {};
+	}
+
+	// Client: submits a command line, returns false when the request ring is full
+	bool submit( std::string_view line, uint64_t id = 0 ) noexcept
+	{
+		return requests.push( text_request, id, std::as_bytes( std::span{ line.data(), line.size() } ) );
+	}
+
+	// Client: submits a binary request built with `binary_writer`
+	bool submit_binary( std::span<const std::byte> request, uint64_t id = 0 ) noexcept
+	{
+		return requests.push( binary_request, id, request );
+	}
+
+	// Client: processes available responses with `f( result, id, text )`. Single thread at a time only!
+	template <typename F>
+	size_t receive( F &&f, size_t max_count = SIZE_MAX )
+	{
+		return responses.consume( max_count, [&]( uint32_t tag, uint64_t id, std::span<const std::byte> payload ) {
+			auto text = std::string_view{ reinterpret_cast<const char *>( payload.data() ), payload.size() };
+			f( static_cast<result>( tag ), id, text );
+			return true;
+		} );
+	}
+
+	/**
+	 * Host: executes at most `budget` requests and writes their results into the response ring.
+	 * `output_buffer` is used for result stringification. Draining stops early when the response
+	 * ring cannot take another result of `output_buffer` size - unread responses hold requests back.
+	 */
+	size_t drain( std::span<const command> commands, size_t budget, std::span<char> output_buffer )
+	{
+		return requests.consume( budget, [&]( uint32_t tag, uint64_t id, std::span<const std::byte> payload ) {
+			if ( !responses.can_push( output_buffer.size() ) )
+				return false;
+
+			output out = { output_buffer };
+			result r = ( tag == binary_request )
+			             ? execute_binary( commands, payload, out )
+			             : execute( commands, { reinterpret_cast<const char *>( payload.data() ), payload.size() }, out );
+
+			std::string_view text;
+			if ( r == result::success && !out.result_error && !output_buffer.empty() )
+				text = output_buffer.data();
+
+			responses.push( static_cast<uint32_t>( r ), id, std::as_bytes( std::span{ text.data(), text.size() } ) );
+			return true;
+		} );
+	}
+
+private:
+	static constexpr uint32_t segment_magic = 0x6F636E63; // "cnco"
+
+	struct segment_header
+	{
+		uint32_t magic;
+		uint32_t client; // Process id of the attached client, 0 = none
+		uint64_t ring_capacity;
+	};
+
+	static constexpr size_t ring_headers_offset = 64;
+	static constexpr size_t data_offset = ring_headers_offset + 2 * sizeof( shm_ring_header );
+
+	void *_segment = nullptr;
+	size_t _segment_size = 0;
+	int _fd = -1;
+	bool _client = false; // This process is the attached client
+
+	std::atomic_ref<uint32_t> client_pid() const noexcept
+	{
+		return std::atomic_ref<uint32_t>( static_cast<segment_header *>( _segment )->client );
+	}
+
+	// Claims the channel for this process, a client which exited without closing the channel is replaced
+	bool claim_client() noexcept
+	{
+		uint32_t pid = static_cast<uint32_t>( ::getpid() );
+		uint32_t current = client_pid().load( std::memory_order_acquire );
+
+		while ( current == 0 || ( ::kill( static_cast<pid_t>( current ), 0 ) != 0 && errno == ESRCH ) )
+			if ( client_pid().compare_exchange_weak( current, pid, std::memory_order_acq_rel ) )
+				return _client = true;
+
+		return false;
+	}
+
+	bool init( int fd, size_t ring_capacity )
+	{
+		close();
+		_fd = fd;
+
+		ring_capacity = std::bit_ceil( std::max<size_t>( ring_capacity, 4096 ) );
+
+		// Truncating to zero first drops any previous content, the segment is then zero-filled, which is
+		// a valid empty state for both rings
+		if ( ::ftruncate( fd, 0 ) != 0 || ::ftruncate( fd, data_offset + 2 * ring_capacity ) != 0 ||
+		     !map( ring_capacity ) )
+		{
+			close();
+			return false;
+		}
+
+		segment_header header = { segment_magic, 0, ring_capacity };
+		std::memcpy( _segment, &header, sizeof( header ) );
+		return true;
+	}
+
+	bool map( size_t ring_capacity )
+	{
+		_segment_size = data_offset + 2 * ring_capacity;
+		void *ptr = ::mmap( nullptr, _segment_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0 );
+		if ( ptr == MAP_FAILED )
+		{
+			close();
+			return false;
+		}
+
+		_segment = ptr;
+
+		auto *base = static_cast<std::byte *>( _segment );
+		auto *ring_headers = reinterpret_cast<shm_ring_header *>( base + ring_headers_offset );
+
+		requests = { ring_headers, base + data_offset, ring_capacity, false };
+		responses = { ring_headers + 1, base + data_offset + ring_capacity, ring_capacity, false };
+		return true;
+	}
+};
+
+} // namespace conco
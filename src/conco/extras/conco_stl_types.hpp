@@ -39,6 +39,19 @@ size_t to_chars( tag<std::string>, std::span<char> buff, const std::string &valu
 	return to_chars( tag<std::string_view>{}, buff, std::string_view{ value } );
 }
 
+inline std::optional<std::string> from_binary( tag<std::string>, const binary_value &value ) noexcept
+{
+	if ( value.kind != binary_kind::string )
+		return std::nullopt;
+
+	return std::string{ value.text() };
+}
+
+inline bool to_binary( tag<std::string>, binary_writer &writer, const std::string &value ) noexcept
+{
+	return to_binary( tag<std::string_view>{}, writer, std::string_view{ value } );
+}
+
 template <>
 struct type_mapper<const char *>
 {
@@ -133,6 +146,37 @@ std::optional<std::vector<T, A>> from_string( tag<std::vector<T, A>>, std::strin
 	return out;
 }
 
+template <typename T, typename A>
+std::optional<std::vector<T, A>> from_binary( tag<std::vector<T, A>>, const binary_value &value ) noexcept
+{
+	if ( value.kind != binary_kind::list )
+		return std::nullopt;
+
+	std::vector<T, A> out;
+	binary_reader reader = { value.data };
+
+	while ( auto item = reader.next() )
+	{
+		// Decoded into a local value, `std::vector<bool>` has no addressable elements
+		T decoded{};
+		if ( !detail::decode_binary_value( *item, decoded ) )
+			return std::nullopt;
+
+		out.push_back( std::move( decoded ) );
+	}
+
+	if ( reader.error )
+		return std::nullopt;
+
+	return out;
+}
+
+template <typename T, typename A>
+bool to_binary( tag<std::vector<T, A>>, binary_writer &writer, const std::vector<T, A> &value ) noexcept
+{
+	return detail::encode_list( writer, value );
+}
+
 template <typename T, typename A>
 size_t to_chars( tag<std::vector<T, A>>, std::span<char> buff, const std::vector<T, A> &value ) noexcept
 {
@@ -224,6 +268,56 @@ std::optional<detail::storage_type<M>> from_string( tag<M>, std::string_view str
 	return out;
 }
 
+// Maps are encoded as a list of [key, value] lists
+template <detail::is_map_like M>
+std::optional<detail::storage_type<M>> from_binary( tag<M>, const binary_value &value ) noexcept
+{
+	if ( value.kind != binary_kind::list )
+		return std::nullopt;
+
+	detail::storage_type<M> out;
+	binary_reader reader = { value.data };
+
+	while ( auto item = reader.next() )
+	{
+		if ( item->kind != binary_kind::list )
+			return std::nullopt;
+
+		binary_reader pair_reader = { item->data };
+		auto key = pair_reader.next();
+		auto val = pair_reader.next();
+		if ( !key || !val )
+			return std::nullopt;
+
+		typename M::key_type parsed_key{};
+		typename type_mapper<detail::inner_type<M>>::storage_type parsed_value{};
+
+		if ( !detail::decode_binary_value( *key, parsed_key ) || !detail::decode_binary_value( *val, parsed_value ) )
+			return std::nullopt;
+
+		out.emplace( std::move( parsed_key ), std::move( parsed_value ) );
+	}
+
+	if ( reader.error )
+		return std::nullopt;
+
+	return out;
+}
+
+template <detail::is_map_like M>
+bool to_binary( tag<M>, binary_writer &writer, const M &value ) noexcept
+{
+	size_t pos = writer.begin_list();
+	for ( const auto &[key, val] : value )
+	{
+		size_t pair_pos = writer.begin_list();
+		if ( !writer.value( key ) || !writer.value( val ) || !writer.end_list( pair_pos ) )
+			return false;
+	}
+
+	return writer.end_list( pos );
+}
+
 template <detail::is_map_like M>
 size_t to_chars( tag<M>, std::span<char> buff, const M &value ) noexcept
 {
@@ -2,9 +2,36 @@
 #include <doctest/parts/doctest.cpp>
 
 #include "conco/conco.hpp"
+#include "conco/conco_alias.hpp"
+#include "conco/conco_completion.hpp"
+#include "conco/conco_cvar.hpp"
+#include "conco/conco_image.hpp"
+#include "conco/conco_json.hpp"
+#include "conco/conco_namespace.hpp"
+#include "conco/conco_registry.hpp"
+#include "conco/conco_script.hpp"
+#include "conco/conco_suggest.hpp"
+#include "conco/conco_task.hpp"
+#include "conco/extras/conco_command_queue.hpp"
+#include "conco/extras/conco_lock_striping.hpp"
+#include "conco/extras/conco_parallel.hpp"
+#include "conco/extras/conco_pipeline.hpp"
+#include "conco/extras/conco_router.hpp"
+#include "conco/extras/conco_scheduler.hpp"
 #include "conco/extras/conco_stl_types.hpp"
 
+#if defined( __linux__ )
+	#include "conco/extras/conco_file.hpp"
+	#include "conco/extras/conco_server.hpp"
+	#include "conco/extras/conco_shm_ring.hpp"
+#endif
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
 #include <print>
+#include <thread>
 #include <tuple>
 
 #define CHECK_NEXT_TOKEN( _Value ) \
@@ -167,6 +194,17 @@ TEST_SUITE( "Tokenizer tests" )
 		CHECK_NEXT_EMPTY_TOKEN;
 	}
 
+	TEST_CASE( "Hash and slashes inside block" )
+	{
+		conco::tokenizer tokenizer{ "colors [\n  #ff0000\n] block {\n  a\n  // end }" };
+
+		CHECK_NEXT_TOKEN( "colors" );
+		CHECK_NEXT_TOKEN( "\n  #ff0000\n" );
+		CHECK_NEXT_TOKEN( "block" );
+		CHECK_NEXT_TOKEN( "\n  a\n  // end " );
+		CHECK_NEXT_EMPTY_TOKEN;
+	}
+
 	TEST_CASE( "Semicolon inside quotes" )
 	{
 		conco::tokenizer tokenizer{ R"(token1 'token2; should be visible' token3)" };
@@ -177,6 +215,68 @@ TEST_SUITE( "Tokenizer tests" )
 		CHECK_NEXT_EMPTY_TOKEN;
 	}
 
+	TEST_CASE( "Stream framing" )
+	{
+		conco::stream_framer framer;
+		std::string pending = "first 1 2";
+
+		REQUIRE( framer.find_end( pending ) == conco::stream_framer::npos );
+
+		pending += "\nsecond {a\nb} 'c\nd'";
+		REQUIRE( framer.find_end( pending ) == 9 );
+
+		pending.erase( 0, 10 );
+		framer.reset();
+
+		REQUIRE( framer.find_end( pending ) == conco::stream_framer::npos );
+		pending += " \\\n\n";
+		REQUIRE( framer.find_end( pending ) == pending.size() - 1 );
+
+		// Quotes and brackets in comment lines are ignored
+		framer.reset();
+		pending = "# don't {\nblock {\n  // it's [\n}\n";
+		REQUIRE( framer.find_end( pending ) == 9 );
+
+		framer.reset();
+		pending.erase( 0, 10 );
+		REQUIRE( framer.find_end( pending ) == pending.size() - 1 );
+
+		framer.reset();
+		pending = "/";
+		REQUIRE( framer.find_end( pending ) == conco::stream_framer::npos );
+		pending += "/ it's\n";
+		REQUIRE( framer.find_end( pending ) == pending.size() - 1 );
+	}
+
+	TEST_CASE( "Grouping of references and nested commands" )
+	{
+		// Plain tokenizer splits them
+		{
+			conco::tokenizer tokenizer( "a ${b}_c (d e) $(f g)" );
+
+			CHECK_NEXT_TOKEN( "a" );
+			CHECK_NEXT_TOKEN( "$" );
+			CHECK_NEXT_TOKEN( "b" );
+			CHECK_NEXT_TOKEN( "_c" );
+			CHECK_NEXT_TOKEN( "(d" );
+			CHECK_NEXT_TOKEN( "e)" );
+			CHECK_NEXT_TOKEN( "$(f" );
+			CHECK_NEXT_TOKEN( "g)" );
+			CHECK_NEXT_EMPTY_TOKEN;
+		}
+
+		// Grouping is enabled for execution with variables
+		{
+			conco::tokenizer tokenizer( "a ${b}_c (d e) $(f g)", true );
+
+			CHECK_NEXT_TOKEN( "a" );
+			CHECK_NEXT_TOKEN( "${b}_c" );
+			CHECK_NEXT_TOKEN( "(d e)" );
+			CHECK_NEXT_TOKEN( "$(f g)" );
+			CHECK_NEXT_EMPTY_TOKEN;
+		}
+	}
+
 	TEST_CASE( "Escaping" )
 	{
 		conco::tokenizer tokenizer( "\\'token xxx \\\\'yyy' \\;semicolon" );
@@ -899,3 +999,2658 @@ TEST_SUITE( "STL types" )
 		REQUIRE( std::string_view( buffer ) == "{\"key1key2key3\",\"value1value2null\"}" );
 	}
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_SUITE( "Binary protocol" )
+{
+	struct vec3
+	{
+		float x, y, z;
+	};
+
+	TEST_CASE( "Basic requests" )
+	{
+		vec3 position = {};
+		std::array<int, 4> rotation = {};
+
+		auto set_transform = [&]( vec3 p, std::array<int, 4> r ) {
+			position = p;
+			rotation = r;
+		};
+
+		const conco::command commands[] = {
+			{ +[]( int x, int y ) { return x + y; }, "sum x y=100" },
+			{ +[]( std::string_view str ) { return str.size(); }, "length str" },
+			{ +[]( std::optional<int> x ) { return x.value_or( 42 ); }, "opt x" },
+			{ set_transform, "set_transform p r" },
+		};
+
+		std::byte request[256];
+		conco::binary_writer writer{ request };
+		char buffer[64] = { 0 };
+
+		REQUIRE( writer.request( "sum", 10, 20 ) );
+		CHECK( execute_binary( commands, writer.bytes(), buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "30" );
+
+		REQUIRE( writer.request( "sum", 10 ) ); // Default value for `y`
+		CHECK( execute_binary( commands, writer.bytes(), buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "110" );
+
+		REQUIRE( writer.request( uint16_t( 1 ), std::string_view( "Hello" ) ) ); // Command selected by index
+		CHECK( execute_binary( commands, writer.bytes(), buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "5" );
+
+		REQUIRE( writer.request( "opt", std::optional<int>{} ) );
+		CHECK( execute_binary( commands, writer.bytes(), buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "42" );
+
+		REQUIRE( writer.request( "set_transform", vec3{ 1.0f, 2.0f, 3.0f }, std::array{ 0, 0, 0, 1 } ) );
+		CHECK( execute_binary( commands, writer.bytes() ) == conco::result::success );
+		REQUIRE( position.y == 2.0f );
+		REQUIRE( rotation[3] == 1 );
+
+		REQUIRE( writer.request( "xsum", 1, 2 ) );
+		CHECK( execute_binary( commands, writer.bytes() ) == conco::result::command_not_found );
+	}
+
+	TEST_CASE( "Errors and fallbacks" )
+	{
+		const conco::command commands[] = {
+			{ +[]( uint8_t x, int y ) { return x + y; }, "sum" },
+			{ +[]( point p ) { return p.x * p.y; }, "area" },
+			{ +[]( std::vector<int> vec ) { return vec.size(); }, "count" },
+		};
+
+		std::byte request[256];
+		conco::binary_writer writer{ request };
+		char buffer[64] = { 0 };
+		conco::output out = { buffer };
+
+		REQUIRE( writer.request( "sum", 1000, 1 ) ); // Out of range for `uint8_t`
+		CHECK( execute_binary( commands, writer.bytes(), out ) == conco::result::argument_parsing_error );
+		REQUIRE( out.arg_error_mask == 0b01 );
+
+		REQUIRE( writer.request( "sum", 1 ) );
+		CHECK( execute_binary( commands, writer.bytes(), out ) == conco::result::not_enough_arguments );
+
+		// Any argument can also be sent as text, it is then parsed by its `from_string`
+		REQUIRE( writer.request( "area", std::string_view( "3 4" ) ) );
+		CHECK( execute_binary( commands, writer.bytes(), buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "12" );
+
+		REQUIRE( writer.request( "count", std::vector<int>{ 1, 2, 3 } ) );
+		CHECK( execute_binary( commands, writer.bytes(), buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "3" );
+
+		std::byte tiny[4];
+		conco::binary_writer tiny_writer{ tiny };
+		REQUIRE( !tiny_writer.request( "sum", 1, 2 ) );
+		REQUIRE( tiny_writer.overflow );
+	}
+
+	TEST_CASE( "Character and bit vector arguments" )
+	{
+		const conco::command commands[] = {
+			{ +[]( char ch ) { return static_cast<int>( ch ); }, "code ch" },
+			{ +[]( std::vector<bool> bits ) { return std::ranges::count( bits, true ); }, "popcount bits" },
+		};
+
+		std::byte request[256];
+		conco::binary_writer writer{ request };
+		char buffer[64] = { 0 };
+
+		REQUIRE( writer.request( "code", 'A' ) );
+		CHECK( execute_binary( commands, writer.bytes(), buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "65" );
+
+		REQUIRE( writer.request( "code", 300 ) ); // Out of range for `char`
+		CHECK( execute_binary( commands, writer.bytes() ) == conco::result::argument_parsing_error );
+
+		REQUIRE( writer.request( "popcount", std::vector<bool>{ true, false, true, true } ) );
+		CHECK( execute_binary( commands, writer.bytes(), buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "3" );
+
+		CHECK( execute( commands, "popcount [1 0 1]", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "2" );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_SUITE( "JSON front-end" )
+{
+	TEST_CASE( "Positional and named arguments" )
+	{
+		const conco::command commands[] = {
+			{ +[]( int x, int y ) { return x + y; }, "sum x y=100" },
+			{ +[]( std::string_view str ) { return str.size(); }, "length str" },
+			{ +[]( std::vector<int> vec ) { return vec; }, "echo vec" },
+		};
+
+		char buffer[64] = { 0 };
+		char response[128] = { 0 };
+		conco::output out = { buffer };
+
+		CHECK( execute_json( commands, R"({"cmd":"sum","args":[1,2],"id":7})", out, response ) ==
+		       conco::result::success );
+		REQUIRE( std::string_view( response ) == R"({"id":7,"result":3})" );
+
+		CHECK( execute_json( commands, R"({ "method": "sum", "params": { "x": 10 }, "id": "a" })", out, response ) ==
+		       conco::result::success );
+		REQUIRE( std::string_view( response ) == R"({"id":"a","result":110})" );
+
+		CHECK( execute_json( commands, R"({"params":{"y":5,"x":1},"method":"sum"})", out, response ) ==
+		       conco::result::success );
+		REQUIRE( std::string_view( response ) == R"({"result":6})" );
+
+		CHECK( execute_json( commands, R"({"cmd":"length","args":["Hello, world!"]})", out, response ) ==
+		       conco::result::success );
+		REQUIRE( std::string_view( response ) == R"({"result":13})" );
+
+		CHECK( execute_json( commands, R"({"cmd":"echo","args":[[1,2,3]]})", out, response ) ==
+		       conco::result::success );
+		REQUIRE( std::string_view( response ) == R"({"result":[1,2,3]})" );
+
+		CHECK( execute_json( commands, R"({"cmd":"xsum","args":[]})", out, response ) ==
+		       conco::result::command_not_found );
+		REQUIRE( std::string_view( response ) == R"({"error":"command_not_found"})" );
+
+		CHECK( execute_json( commands, R"({"cmd":"sum","args":{"y":1}})", out, response ) ==
+		       conco::result::not_enough_arguments );
+		REQUIRE( std::string_view( response ) == R"({"error":"not_enough_arguments"})" );
+	}
+
+	TEST_CASE( "Result conversion" )
+	{
+		const conco::command commands[] = {
+			{ +[]() { return std::string( "say \"hi\"" ); }, "quote" },
+			{ +[]() { return std::pair<int, std::string>{ 1, "x" }; }, "pair" },
+			{ +[]() { return std::map<std::string, int>{ { "a", 1 }, { "b", 2 } }; }, "map" },
+			{ +[]() {}, "nothing" },
+		};
+
+		char buffer[64] = { 0 };
+		char response[128] = { 0 };
+		conco::output out = { buffer };
+
+		CHECK( execute_json( commands, R"({"cmd":"quote"})", out, response ) == conco::result::success );
+		REQUIRE( std::string_view( response ) == R"({"result":"say \"hi\""})" );
+
+		CHECK( execute_json( commands, R"({"cmd":"pair"})", out, response ) == conco::result::success );
+		REQUIRE( std::string_view( response ) == R"({"result":[1,"x"]})" );
+
+		CHECK( execute_json( commands, R"({"cmd":"map"})", out, response ) == conco::result::success );
+		REQUIRE( std::string_view( response ) == R"({"result":{"a":1,"b":2}})" );
+
+		CHECK( execute_json( commands, R"({"cmd":"nothing"})", out, response ) == conco::result::success );
+		REQUIRE( std::string_view( response ) == R"({"result":null})" );
+
+		char tiny_response[8] = { 0 };
+		CHECK( execute_json( commands, R"({"cmd":"map"})", out, tiny_response ) == conco::result::success );
+		REQUIRE( std::string_view( tiny_response ) == "" );
+	}
+}
+
+TEST_SUITE( "Prepared commands" )
+{
+	TEST_CASE( "Prepare and invoke" )
+	{
+		int counter = 0;
+		auto add = [&]( int x ) { counter += x; };
+
+		const conco::command commands[] = {
+			{ add, "add x" },
+			{ +[]( std::string_view a, std::string_view b ) { return std::string( a ) + std::string( b ); }, "concat a b=x" },
+			{ +[]( conco::tokenizer & ) {}, "tail" },
+		};
+
+		alignas( 16 ) std::byte storage[128];
+		char buffer[64] = { 0 };
+		conco::output out = { buffer };
+		conco::prepared p;
+
+		REQUIRE( conco::prepare( commands, "add 5", storage, p, out ) == conco::result::success );
+		REQUIRE( p.cmd == &commands[0] );
+		REQUIRE( counter == 0 );
+		REQUIRE( p.invoke() == conco::result::success );
+		REQUIRE( p.invoke() == conco::result::success );
+		REQUIRE( counter == 10 );
+
+		REQUIRE( conco::prepare( commands, "concat 'abc'", storage, p, out ) == conco::result::success );
+		REQUIRE( p.invoke( buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "\"abcx\"" );
+
+		conco::prepared moved = std::move( p );
+		REQUIRE( !p );
+		REQUIRE( moved );
+
+		REQUIRE( conco::prepare( commands, "add xyz", storage, p, out ) == conco::result::argument_parsing_error );
+		REQUIRE( !p );
+		REQUIRE( conco::prepare( commands, "nope", storage, p, out ) == conco::result::command_not_found );
+		REQUIRE( conco::prepare( commands, "tail 1 2", storage, p, out ) == conco::result::cannot_prepare );
+		REQUIRE( conco::prepare( commands, "add 1", std::span( storage, 1 ), p, out ) == conco::result::cannot_prepare );
+
+		// `execute()` would pick the first overload, which cannot be prepared
+		const conco::command overloads[] = {
+			{ +[]( conco::tokenizer &tail ) { return tail.text.size() + 100; }, "pick" },
+			{ +[]( int x ) { return x; }, "pick x" },
+		};
+
+		REQUIRE( conco::prepare( overloads, "pick 7", storage, p, out ) == conco::result::cannot_prepare );
+		REQUIRE( !p );
+		REQUIRE( conco::prepare( overloads, "pick", storage, p, out ) == conco::result::cannot_prepare );
+	}
+}
+
+TEST_SUITE( "Command queue" )
+{
+	TEST_CASE( "Lines, prepared entries and futures" )
+	{
+		std::string log;
+		auto append = [&]( std::string_view str ) { log += str; };
+
+		const conco::command commands[] = {
+			{ append, "append str" },
+			{ +[]( int x, int y ) { return x + y; }, "sum x y" },
+			{ +[]( conco::tokenizer &tail ) { return tail.text.size(); }, "tail_length" },
+		};
+
+		conco::basic_command_queue<64> queue( 3 );
+		REQUIRE( queue.capacity() == 4 );
+
+		char buffer[64] = { 0 };
+		conco::command_future future( buffer );
+
+		REQUIRE( queue.push( "append a" ) );
+		REQUIRE( queue.push_prepared( commands, "append b" ) );
+		REQUIRE( queue.push_prepared( commands, "sum 1 2", &future ) );
+		REQUIRE( queue.push( "append c" ) );
+		REQUIRE( !queue.push( "append d" ) ); // Full
+		REQUIRE( !queue.push( std::string( 100, 'x' ) ) );
+
+		REQUIRE( log.empty() );
+		REQUIRE( !future.is_ready() );
+
+		REQUIRE( queue.drain( commands, 2 ) == 2 );
+		REQUIRE( log == "ab" );
+		REQUIRE( queue.drain( commands ) == 2 );
+		REQUIRE( log == "abc" );
+		REQUIRE( queue.drain( commands ) == 0 );
+
+		REQUIRE( future.is_ready() );
+		REQUIRE( future.wait() == conco::result::success );
+		REQUIRE( future.text() == "3" );
+
+		// Parsing errors are reported right away, unpreparable commands are queued as lines
+		future.reset();
+		REQUIRE( queue.push_prepared( commands, "sum x 1", &future ) );
+		REQUIRE( future.is_ready() );
+		REQUIRE( future.get_result() == conco::result::argument_parsing_error );
+
+		future.reset();
+		REQUIRE( queue.push_prepared( commands, "tail_length 1 2 3", &future ) );
+		REQUIRE( !future.is_ready() );
+		REQUIRE( queue.drain( commands ) == 1 );
+		REQUIRE( future.text() == "5" );
+
+		// The same overload as with `execute()` is picked
+		const conco::command overloads[] = {
+			{ +[]( conco::tokenizer &tail ) { return tail.text.size() + 100; }, "pick" },
+			{ +[]( int x ) { return x; }, "pick x" },
+		};
+
+		future.reset();
+		REQUIRE( queue.push_prepared( overloads, "pick 7", &future ) );
+		REQUIRE( queue.drain( overloads ) == 1 );
+		REQUIRE( future.text() == "101" );
+
+		// Prepared arguments refer to the queued copy of the line, not to the caller's buffer
+		std::string line = "append d";
+		REQUIRE( queue.push_prepared( commands, line ) );
+		line = "append x";
+		REQUIRE( queue.drain( commands ) == 1 );
+		REQUIRE( log == "abcd" );
+
+		// Pending prepared entries are destroyed with the queue
+		REQUIRE( queue.push_prepared( commands, "append 'a long string that does not fit into SSO buffer'" ) );
+	}
+
+	TEST_CASE( "Multiple producers" )
+	{
+		int64_t total = 0;
+		int executed = 0;
+		auto add = [&]( int x ) {
+			total += x;
+			++executed;
+		};
+
+		const conco::command commands[] = {
+			{ add, "add x" },
+		};
+
+		conco::command_queue queue( 64 );
+
+		constexpr int producer_count = 4;
+		constexpr int count = 2000;
+
+		std::vector<std::thread> producers;
+		for ( int p = 0; p < producer_count; ++p )
+		{
+			producers.emplace_back( [&, p]() {
+				for ( int i = 1; i <= count; ++i )
+				{
+					std::string line = "add " + std::to_string( i );
+					while ( !( p % 2 ? queue.push( line ) : queue.push_prepared( commands, line ) ) )
+						std::this_thread::yield();
+				}
+			} );
+		}
+
+		while ( executed < producer_count * count )
+			queue.drain( commands, 100 );
+
+		for ( auto &t : producers )
+			t.join();
+
+		REQUIRE( total == int64_t( producer_count ) * count * ( count + 1 ) / 2 );
+
+		// Waiting for a future from another thread
+		char buffer[16] = { 0 };
+		conco::command_future future( buffer );
+
+		std::thread waiter( [&]() {
+			while ( !queue.push_prepared( commands, "add 1", &future ) )
+				std::this_thread::yield();
+
+			future.wait();
+		} );
+
+		while ( executed == producer_count * count )
+			queue.drain( commands );
+
+		waiter.join();
+		REQUIRE( future.get_result() == conco::result::success );
+	}
+}
+
+TEST_SUITE( "Thread-affinity routing" )
+{
+	TEST_CASE( "Command tags" )
+	{
+		const conco::command commands[] = {
+			{ +[]() {}, "plain" },
+			{ +[]() {}, "draw mesh='a;b';@render @slow Draws a mesh" },
+			{ +[]() {}, "reset;Resets everything" },
+		};
+
+		CHECK( !commands[0].has_tag( "render" ) );
+		CHECK( commands[0].description() == "" );
+		CHECK( commands[1].has_tag( "render" ) );
+		CHECK( commands[1].has_tag( "slow" ) );
+		CHECK( !commands[1].has_tag( "rend" ) );
+		CHECK( commands[1].description() == "Draws a mesh" );
+		CHECK( commands[2].description() == "Resets everything" );
+	}
+
+	TEST_CASE( "Routing" )
+	{
+		std::thread::id draw_thread, log_thread;
+		auto draw = [&]( int x ) {
+			draw_thread = std::this_thread::get_id();
+			return x * 2;
+		};
+		auto log = [&]() { log_thread = std::this_thread::get_id(); };
+
+		const conco::command commands[] = {
+			{ draw, "draw x;@render Draws something" },
+			{ log, "log" },
+		};
+
+		conco::command_router router( commands, 16 );
+		size_t main_index = router.add_thread( std::string( "main" ) );
+		size_t render_index = router.add_thread( std::string( "render" ) ); // Names are copied
+
+		REQUIRE( router.affinity( "draw" ) == render_index );
+		REQUIRE( router.affinity( "log" ) == conco::command_router::no_affinity );
+
+		router.bind_current_thread( main_index );
+
+		// Affinity-free commands run inline
+		conco::command_future log_future;
+		REQUIRE( router.execute( "log", &log_future ) );
+		REQUIRE( log_future.is_ready() );
+		REQUIRE( log_thread == std::this_thread::get_id() );
+
+		// Render commands are queued for the render thread, which is the only one draining them
+		char buffer[16] = { 0 };
+		conco::command_future draw_future( buffer );
+		REQUIRE( router.execute( "draw 21", &draw_future ) );
+		REQUIRE( !draw_future.is_ready() );
+		REQUIRE( router.drain() == 0 );
+
+		std::thread render( [&]() {
+			router.bind_current_thread( render_index );
+			while ( !draw_future.is_ready() )
+				router.drain();
+		} );
+
+		auto render_id = render.get_id();
+		REQUIRE( draw_future.wait() == conco::result::success );
+		render.join();
+
+		REQUIRE( draw_future.text() == "42" );
+		REQUIRE( draw_thread == render_id );
+		REQUIRE( draw_thread != std::this_thread::get_id() );
+
+		// Affinity assigned at registration, commands with affinity to the calling thread run inline
+		REQUIRE( router.set_affinity( "draw", "main" ) );
+		REQUIRE( !router.set_affinity( "draw", "audio" ) );
+
+		draw_future.reset();
+		REQUIRE( router.execute( "draw 1", &draw_future ) );
+		REQUIRE( draw_future.is_ready() );
+		REQUIRE( draw_thread == std::this_thread::get_id() );
+	}
+}
+
+TEST_SUITE( "Parallel execution" )
+{
+	TEST_CASE( "Thread pool" )
+	{
+		conco::thread_pool pool( 4 );
+		REQUIRE( pool.size() == 4 );
+
+		for ( size_t task_count : { 1, 3, 4, 1000 } )
+		{
+			std::vector<std::atomic<int>> counters( task_count );
+			pool.run( task_count, [&]( size_t task, size_t worker ) {
+				CHECK( worker < 4 );
+				counters[task].fetch_add( 1 );
+			} );
+
+			REQUIRE( std::ranges::all_of( counters, []( const auto &c ) { return c.load() == 1; } ) );
+		}
+	}
+
+	TEST_CASE( "Batches" )
+	{
+		std::atomic<int> spawned = 0;
+		auto spawn = [&]( int x ) {
+			spawned.fetch_add( 1 );
+			return x * 2;
+		};
+
+		std::string serial_log;
+		std::atomic<int> serial_elsewhere = 0;
+		int serial_out_of_order = 0;
+		auto log = [&, caller = std::this_thread::get_id()]( int x ) {
+			serial_log += std::to_string( x ) + " ";
+			if ( std::this_thread::get_id() != caller )
+				serial_elsewhere.fetch_add( 1 );
+
+			// "log x" follows "spawn x", all earlier spawns have finished and no later one has started
+			if ( spawned.load() != x + 1 )
+				++serial_out_of_order;
+		};
+
+		std::map<std::string, std::string> asset_logs;
+		std::mutex asset_logs_mutex;
+		auto rebuild = [&]( std::string_view asset, int step ) {
+			std::lock_guard lock( asset_logs_mutex );
+			asset_logs[std::string( asset )] += std::to_string( step );
+		};
+
+		const conco::command commands[] = {
+			{ spawn, "spawn x;@parallel" },
+			{ log, "log x" },
+			{ rebuild, "rebuild asset step;@parallel Rebuilds one step of an asset" },
+		};
+
+		std::vector<std::string> storage;
+		for ( int i = 0; i < 2000; ++i )
+		{
+			storage.push_back( "spawn " + std::to_string( i ) );
+			if ( i % 100 == 0 )
+				storage.push_back( "log " + std::to_string( i ) );
+			if ( i % 10 == 0 )
+				storage.push_back( "rebuild asset" + std::to_string( i % 3 ) + " " + std::to_string( i % 7 ) );
+		}
+
+		storage.push_back( "xyz" );
+
+		std::vector<std::string_view> lines( storage.begin(), storage.end() );
+
+		conco::thread_pool pool( 4 );
+		conco::batch_results results;
+
+		conco::execute_parallel( commands, lines, results, pool, []( std::string_view line ) {
+			return line.starts_with( "rebuild" ) ? line.substr( 8, 6 ) : std::string_view{};
+		} );
+
+		REQUIRE( spawned == 2000 );
+		REQUIRE( results.entries.size() == lines.size() );
+
+		for ( size_t i = 0; i < lines.size(); ++i )
+		{
+			if ( lines[i].starts_with( "spawn " ) )
+				REQUIRE( results.text( i ) == std::to_string( std::stoi( std::string( lines[i].substr( 6 ) ) ) * 2 ) );
+		}
+
+		REQUIRE( results.entries.back().r == conco::result::command_not_found );
+
+		// Serial lines and lines in the same dependency group keep their order
+		std::string expected_serial;
+		std::map<std::string, std::string> expected_assets;
+		for ( int i = 0; i < 2000; ++i )
+		{
+			if ( i % 100 == 0 )
+				expected_serial += std::to_string( i ) + " ";
+			if ( i % 10 == 0 )
+				expected_assets["asset" + std::to_string( i % 3 )] += std::to_string( i % 7 );
+		}
+
+		REQUIRE( serial_log == expected_serial );
+		REQUIRE( serial_elsewhere == 0 ); // Serial lines run on the calling thread only
+		REQUIRE( serial_out_of_order == 0 );
+		REQUIRE( asset_logs == expected_assets );
+	}
+}
+
+TEST_SUITE( "Lock striping" )
+{
+	struct counter
+	{
+		int value = 0;
+
+		void add( int x ) { value += x; }
+		int get() const { return value; }
+	};
+
+	TEST_CASE( "Target access" )
+	{
+		counter c;
+		auto mutable_lambda = [&]( int x ) mutable { c.add( x ); };
+		auto const_lambda = [&]() { return c.get(); };
+
+		const conco::command commands[] = {
+			{ +[]() {}, "free" },
+			conco::method<&counter::add>( c, "add" ),
+			conco::method<&counter::get>( c, "get" ),
+			{ mutable_lambda, "mutable_lambda" },
+			{ const_lambda, "const_lambda" },
+		};
+
+		CHECK( commands[0].desc.access == conco::target_access::none );
+		CHECK( commands[1].desc.access == conco::target_access::exclusive );
+		CHECK( commands[2].desc.access == conco::target_access::shared );
+		CHECK( commands[3].desc.access == conco::target_access::exclusive );
+		CHECK( commands[4].desc.access == conco::target_access::shared );
+	}
+
+	TEST_CASE( "Concurrent method commands" )
+	{
+		counter a, b;
+
+		const conco::command commands[] = {
+			conco::method<&counter::add>( a, "add_a x" ),
+			conco::method<&counter::add>( b, "add_b x" ),
+			conco::method<&counter::get>( a, "get_a" ),
+		};
+
+		conco::lock_stripes<16> stripes;
+		REQUIRE( &stripes.get( &a ) == &stripes.get( &a ) );
+
+		constexpr int count = 10000;
+
+		std::vector<std::thread> threads;
+		for ( int t = 0; t < 4; ++t )
+		{
+			threads.emplace_back( [&, t]() {
+				char buffer[16] = { 0 };
+				for ( int i = 0; i < count; ++i )
+				{
+					conco::execute_striped( commands, t % 2 ? "add_a 1" : "add_b 2", stripes );
+					conco::execute_striped( commands, "get_a", stripes, buffer );
+				}
+			} );
+		}
+
+		for ( auto &t : threads )
+			t.join();
+
+		REQUIRE( a.value == 2 * count );
+		REQUIRE( b.value == 4 * count );
+
+		char buffer[16] = { 0 };
+		REQUIRE( conco::execute_striped( commands, "get_a", stripes, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "20000" );
+		REQUIRE( conco::execute_striped( commands, "add_c 1", stripes ) == conco::result::command_not_found );
+	}
+}
+
+TEST_SUITE( "Async commands" )
+{
+	conco::task<int> delayed_sum( int x, int y )
+	{
+		co_await conco::next_frame( 2 );
+		co_return x + y;
+	}
+
+	conco::task<int> nested_sum( int x )
+	{
+		int a = co_await delayed_sum( x, 1 );
+		int b = co_await delayed_sum( x, 2 );
+		co_return a * b;
+	}
+
+	conco::task<> failing()
+	{
+		co_await conco::next_frame();
+		throw std::runtime_error( "failed" );
+	}
+
+	// Awaitable resumed by its owner, e.g. when some I/O has completed
+	struct event
+	{
+		std::coroutine_handle<> waiting;
+		int value = 0;
+
+		auto operator co_await()
+		{
+			struct awaiter
+			{
+				event &e;
+				bool await_ready() const noexcept { return false; }
+				void await_suspend( std::coroutine_handle<> h ) noexcept { e.waiting = h; }
+				int await_resume() const noexcept { return e.value; }
+			};
+
+			return awaiter{ *this };
+		}
+
+		void fire( int v )
+		{
+			value = v;
+			std::exchange( waiting, nullptr ).resume();
+		}
+	};
+
+	event io_done;
+	int io_result = 0;
+
+	conco::task<int> wait_io( int x )
+	{
+		io_result = co_await delayed_sum( x, co_await io_done );
+		co_return io_result;
+	}
+
+	TEST_CASE( "Without scheduler" )
+	{
+		const conco::command commands[] = {
+			{ delayed_sum, "delayed_sum x y" },
+			{ nested_sum, "nested_sum x" },
+			{ failing, "failing" },
+		};
+
+		REQUIRE( commands[0].desc.result_type_info->name == "task" );
+		REQUIRE( commands[0].desc.result_type_info->inner_type_info->name == "int" );
+
+		char buffer[16] = { 0 };
+		REQUIRE( conco::execute( commands, "delayed_sum 1 2", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "3" );
+
+		REQUIRE( conco::execute( commands, "nested_sum 3", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "20" );
+
+		CHECK_THROWS_AS( conco::execute( commands, "failing", buffer ), std::runtime_error );
+
+		// Tasks suspended by other awaitables fail, but they are not destroyed while still awaited
+		const conco::command io[] = { { wait_io, "wait_io x" } };
+		conco::output out = { buffer };
+		REQUIRE( conco::execute( io, "wait_io 4", out ) == conco::result::success );
+		REQUIRE( out.result_error );
+		REQUIRE( io_done.waiting );
+
+		io_done.fire( 5 );
+		REQUIRE( io_result == 9 );
+	}
+
+	TEST_CASE( "Scheduled tasks" )
+	{
+		const conco::command commands[] = {
+			{ delayed_sum, "delayed_sum x y" },
+			{ nested_sum, "nested_sum x" },
+			{ failing, "failing" },
+			{ +[]( int x ) { return x; }, "echo x" },
+		};
+
+		std::vector<std::string> completed;
+
+		conco::task_scheduler scheduler;
+		scheduler.on_complete = [&]( const conco::task_scheduler::completion &c ) {
+			completed.push_back( std::to_string( c.task_id ) + ":" + std::string( c.cmd->name() ) + ":" +
+			                     ( c.result_error ? "error" : std::string( c.text ) ) );
+		};
+
+		char buffer[16] = { 0 };
+		conco::output out = { buffer };
+		out.scheduler = &scheduler;
+
+		REQUIRE( conco::execute( commands, "delayed_sum 1 2", out ) == conco::result::success );
+		REQUIRE( out.task_id == 1 );
+		REQUIRE( std::string_view( buffer ) == "" );
+
+		REQUIRE( conco::execute( commands, "nested_sum 3", out ) == conco::result::success );
+		REQUIRE( out.task_id == 2 );
+
+		REQUIRE( conco::execute( commands, "failing", out ) == conco::result::success );
+		REQUIRE( out.task_id == 3 );
+
+		// Regular commands are not affected
+		REQUIRE( conco::execute( commands, "echo 5", out ) == conco::result::success );
+		REQUIRE( out.task_id == 0 );
+		REQUIRE( std::string_view( buffer ) == "5" );
+
+		REQUIRE( scheduler.task_count() == 3 );
+
+		scheduler.run(); // Tasks start
+		scheduler.run();
+		REQUIRE( completed == std::vector<std::string>{ "3:failing:error" } );
+
+		scheduler.run();
+		REQUIRE( completed.size() == 2 );
+		REQUIRE( completed[1] == "1:delayed_sum:3" );
+
+		while ( scheduler.task_count() > 0 )
+			scheduler.run();
+
+		REQUIRE( completed.size() == 3 );
+		REQUIRE( completed[2] == "2:nested_sum:20" );
+
+		// Unfinished tasks are destroyed together with the scheduler
+		{
+			conco::task_scheduler short_lived;
+			out.scheduler = &short_lived;
+
+			REQUIRE( conco::execute( commands, "nested_sum 1", out ) == conco::result::success );
+			short_lived.run();
+			short_lived.run();
+			REQUIRE( short_lived.task_count() == 1 );
+		}
+	}
+}
+
+TEST_SUITE( "Deferred command scheduler" )
+{
+	TEST_CASE( "Delays, repeats and priorities" )
+	{
+		using namespace std::chrono_literals;
+
+		std::string log;
+		auto append = [&]( std::string_view str ) { log += str; };
+
+		const conco::command commands[] = {
+			{ append, "append str" },
+			{ +[]( conco::tokenizer &tail ) { return tail.text.size(); }, "tail_length" },
+			{ +[]( conco::tokenizer &tail ) { return tail.text.size() + 100; }, "pick" },
+			{ +[]( int x ) { return x; }, "pick x" },
+		};
+
+		conco::command_scheduler scheduler( commands );
+
+		std::vector<std::string> completed;
+		scheduler.on_complete = [&]( const conco::command_scheduler::completion &c ) {
+			completed.push_back( std::string( to_string( c.r ) ) + ":" + std::string( c.text ) );
+		};
+
+		auto t0 = conco::command_scheduler::clock::time_point{};
+
+		REQUIRE( scheduler.schedule( "append a", t0 + 10ms ) );
+		REQUIRE( scheduler.schedule( "append b", t0 + 20ms ) );
+		REQUIRE( scheduler.schedule( "append c", t0 + 5ms, { .priority = 1 } ) );
+		REQUIRE( scheduler.schedule( "tail_length 1 2", t0 + 30ms ) );
+
+		uint64_t repeating = scheduler.schedule_after( "append r", t0, 10ms, { .period = 10ms } );
+		REQUIRE( repeating );
+
+		conco::result error = conco::result::success;
+		REQUIRE( scheduler.schedule( "append", t0, {}, &error ) == 0 );
+		REQUIRE( error == conco::result::not_enough_arguments );
+		REQUIRE( scheduler.schedule( "nope", t0 ) == 0 );
+
+		// Prepared arguments refer to the job's copy of the line, not to the caller's buffer
+		std::string line = "append z";
+		REQUIRE( scheduler.schedule( line, t0 + 60ms ) );
+		line = "append x";
+
+		REQUIRE( scheduler.size() == 6 );
+
+		REQUIRE( scheduler.tick( t0, 1s ) == 0 );
+		REQUIRE( scheduler.tick( t0 + 10ms, 1s ) == 3 );
+		REQUIRE( log == "car" ); // Priority first, then by due time
+
+		REQUIRE( scheduler.tick( t0 + 20ms, 1s ) == 2 );
+		REQUIRE( log == "carbr" );
+
+		REQUIRE( scheduler.tick( t0 + 50ms, 1s ) == 2 );
+		REQUIRE( log == "carbrr" ); // Missed periods are skipped
+		REQUIRE( std::ranges::count( completed, "success:3" ) == 1 );
+
+		REQUIRE( scheduler.cost( repeating ) > 0ns );
+		REQUIRE( scheduler.cancel( repeating ) );
+		REQUIRE( !scheduler.cancel( repeating ) );
+		REQUIRE( scheduler.size() == 1 );
+
+		REQUIRE( scheduler.tick( t0 + 100ms, 1s ) == 1 );
+		REQUIRE( log == "carbrrz" );
+		REQUIRE( scheduler.size() == 0 );
+
+		// The same overload as with `execute()` is picked
+		REQUIRE( scheduler.schedule( "pick 7", t0 + 100ms ) );
+		REQUIRE( scheduler.tick( t0 + 100ms, 1s ) == 1 );
+		REQUIRE( completed.back() == "success:101" );
+	}
+
+	TEST_CASE( "Time budget" )
+	{
+		using namespace std::chrono_literals;
+
+		int executed = 0;
+		auto work = [&]( int ms ) {
+			std::this_thread::sleep_for( std::chrono::milliseconds( ms ) );
+			++executed;
+		};
+
+		const conco::command commands[] = {
+			{ work, "work ms" },
+		};
+
+		conco::command_scheduler scheduler( commands );
+		auto t0 = conco::command_scheduler::clock::time_point{};
+
+		for ( int i = 0; i < 10; ++i )
+			scheduler.schedule( "work 0", t0 );
+
+		// At least one job always runs, even with zero budget
+		REQUIRE( scheduler.tick( t0, 0ms ) == 1 );
+		REQUIRE( scheduler.tick( t0, 1s ) == 9 );
+
+		// Expensive job is deferred once its cost is known, cheap ones fill the budget
+		uint64_t expensive = scheduler.schedule( "work 20", t0, { .priority = 1, .period = 1ms } );
+		scheduler.tick( t0, 1s );
+		REQUIRE( scheduler.cost( expensive ) >= 20ms );
+
+		scheduler.schedule( "work 0", t0 + 2ms, { .priority = 2 } );
+		scheduler.schedule( "work 0", t0 + 2ms );
+
+		executed = 0;
+		REQUIRE( scheduler.tick( t0 + 2ms, 5ms ) == 2 );
+		REQUIRE( executed == 2 );
+	}
+}
+
+TEST_SUITE( "Registry" )
+{
+	TEST_CASE( "Adding and removing commands" )
+	{
+		const conco::command base_commands[] = {
+			{ +[]( int x ) { return x; }, "echo x" },
+			{ +[]( int x, int y ) { return x + y; }, "sum x y" },
+		};
+
+		const conco::command plugin_commands[] = {
+			{ +[]( std::string_view s ) { return s.size(); }, "echo s" }, // Overload of an existing command
+			{ +[]( int x ) { return x * x; }, "square x" },
+		};
+
+		conco::registry reg( base_commands );
+		REQUIRE( reg.version() == 1 );
+
+		char buffer[32] = { 0 };
+		REQUIRE( reg.execute( "sum 1 2", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "3" );
+		REQUIRE( reg.execute( "square 3", buffer ) == conco::result::command_not_found );
+
+		reg.add( plugin_commands );
+		REQUIRE( reg.version() == 2 );
+
+		{
+			auto r = reg.read();
+			REQUIRE( r.commands().size() == 4 );
+			REQUIRE( r.commands()[0] == "echo" );
+			REQUIRE( r.commands()[1] == "echo" ); // Overloads are kept together
+			REQUIRE( r.find( "square" ) != nullptr );
+			REQUIRE( r.find( "squar" ) == nullptr );
+		}
+
+		REQUIRE( reg.execute( "square 3", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "9" );
+		REQUIRE( reg.execute( "echo abc", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "3" );
+
+		// Snapshots stay valid while pinned by a reader
+		{
+			auto r = reg.read();
+
+			REQUIRE( reg.remove( plugin_commands ) == 2 );
+			REQUIRE( r.find( "square" ) != nullptr );
+			REQUIRE( reg.read().find( "square" ) == nullptr );
+		}
+
+		reg.synchronize();
+
+		REQUIRE( reg.execute( "echo abc", buffer ) == conco::result::argument_parsing_error );
+		REQUIRE( reg.remove( "sum" ) == 1 );
+		REQUIRE( reg.remove( "sum" ) == 0 );
+		REQUIRE( reg.execute( "sum 1 2", buffer ) == conco::result::command_not_found );
+	}
+
+	TEST_CASE( "Concurrent readers" )
+	{
+		std::atomic<int> calls = 0;
+		auto count = [&]() { calls.fetch_add( 1 ); };
+
+		const conco::command stable[] = {
+			{ count, "count" },
+		};
+
+		std::vector<std::string> names;
+		for ( int i = 0; i < 64; ++i )
+			names.push_back( "dynamic_" + std::to_string( i ) );
+
+		conco::registry reg( stable );
+		std::atomic<bool> done = false;
+		std::atomic<int> failures = 0;
+
+		std::vector<std::thread> readers;
+		for ( int t = 0; t < 4; ++t )
+		{
+			readers.emplace_back( [&]() {
+				while ( !done.load() )
+				{
+					if ( reg.execute( "count" ) != conco::result::success )
+						failures.fetch_add( 1 );
+
+					reg.execute( "dynamic_7" );
+				}
+			} );
+		}
+
+		for ( int round = 0; round < 200; ++round )
+		{
+			const auto &name = names[round % names.size()];
+			conco::command cmd = { +[]() {}, name.c_str() };
+
+			reg.add( cmd );
+			REQUIRE( reg.remove( name ) == 1 );
+		}
+
+		while ( calls.load() < 1000 )
+			std::this_thread::yield();
+
+		done = true;
+		for ( auto &t : readers )
+			t.join();
+
+		reg.synchronize();
+		REQUIRE( failures == 0 );
+		REQUIRE( reg.version() == 401 );
+	}
+}
+
+TEST_SUITE( "Layered commands" )
+{
+	TEST_CASE( "Shadowing" )
+	{
+		const conco::command global_commands[] = {
+			{ +[]( int x ) { return x; }, "echo x" },
+			{ +[]( std::string_view s ) { return s.size(); }, "echo s" },
+			{ +[]( int x, int y ) { return x + y; }, "sum x y" },
+		};
+
+		const conco::command overrides[] = {
+			{ +[]( int x ) { return x * 10; }, "echo x" },
+		};
+
+		const conco::command_layer layers[] = { overrides, global_commands };
+		conco::layered_commands view( layers );
+
+		char buffer[32] = { 0 };
+		REQUIRE( conco::execute( view, "echo 2", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "20" );
+
+		// All overloads from the lower layer are shadowed, not only the matching one
+		REQUIRE( conco::execute( view, "echo abc", buffer ) == conco::result::argument_parsing_error );
+
+		REQUIRE( conco::execute( view, "sum 1 2", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "3" );
+		REQUIRE( conco::execute( view, "nope", buffer ) == conco::result::command_not_found );
+	}
+
+	TEST_CASE( "Context exposes the merged view" )
+	{
+		std::vector<std::string> names;
+		auto list = [&]( const conco::context &ctx ) {
+			for ( const auto &cmd : ctx.commands )
+				names.emplace_back( cmd.name() );
+		};
+
+		const conco::command global_commands[] = {
+			{ +[]() {}, "quit" },
+			{ +[]( int ) {}, "list x" },
+			{ +[]( int, int ) {}, "list x y" }, // Overloads are shadowed together
+			{ +[]() {}, "help" },
+		};
+
+		const conco::command module_commands[] = {
+			{ list, "list" },
+			{ +[]() {}, "reload" },
+		};
+
+		const conco::command_layer layers[] = { module_commands, global_commands };
+		REQUIRE( conco::execute( conco::layered_commands( layers ), "list" ) == conco::result::success );
+		REQUIRE( names == std::vector<std::string>{ "list", "reload", "quit", "help" } );
+
+		names.clear();
+		REQUIRE( conco::execute( module_commands, "list" ) == conco::result::success );
+		REQUIRE( names == std::vector<std::string>{ "list", "reload" } );
+	}
+
+	TEST_CASE( "Indexed layers" )
+	{
+		const conco::command global_commands[] = {
+			{ +[]( int x ) { return x; }, "echo x" },
+			{ +[]( int x ) { return -x; }, "neg x" },
+		};
+
+		conco::registry reg;
+		reg.add( { +[]( int x ) { return x + 100; }, "echo x" } );
+
+		conco::command_index index( global_commands );
+		REQUIRE( &*index.find( global_commands, "neg" ) == &global_commands[1] );
+		REQUIRE( index.find( global_commands, "ne" ) == std::span<const conco::command>( global_commands ).end() );
+
+		auto r = reg.read();
+		const conco::command_layer layers[] = { r.layer(), index.layer( global_commands ) };
+
+		char buffer[32] = { 0 };
+		REQUIRE( conco::execute( conco::layered_commands( layers ), "echo 1", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "101" );
+		REQUIRE( conco::execute( conco::layered_commands( layers ), "neg 1", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "-1" );
+	}
+}
+
+TEST_SUITE( "Command namespace" )
+{
+	TEST_CASE( "Lookup by segments" )
+	{
+		auto call_log = []( const conco::context &ctx ) {
+			return conco::execute( ctx.commands, "log" ) == conco::result::success;
+		};
+
+		const conco::command commands[] = {
+			{ +[]( int x ) { return x; }, "render.shadows.quality x" },
+			{ +[]( std::string_view s ) { return s.size(); }, "render.shadows.quality s" },
+			{ +[]() { return 1; }, "render.vsync" },
+			{ +[]() { return 2; }, "log" },
+			{ call_log, "call_log" },
+		};
+
+		conco::command_namespace ns( commands );
+
+		REQUIRE( ns.find( "render.shadows.quality" ).size() == 2 );
+		REQUIRE( ns.find( "render.shadows" ).empty() );
+		REQUIRE( ns.find( "render.shadow" ).empty() );
+		REQUIRE( ns.find( "render.shadows.quality.x" ).empty() );
+
+		char buffer[32] = { 0 };
+		REQUIRE( ns.execute( "render.shadows.quality 3", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "3" );
+		REQUIRE( ns.execute( "render.shadows.quality high", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "4" );
+		REQUIRE( ns.execute( "log", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "2" );
+		REQUIRE( ns.execute( "render", buffer ) == conco::result::command_not_found );
+
+		// Commands taking `const context &` see all commands, not only their own overloads
+		REQUIRE( ns.execute( "call_log", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "true" );
+
+		// Overloads added later are kept next to the earlier ones
+		ns.add( { +[]( int x, int y ) { return x * y; }, "render.vsync x y" } );
+		REQUIRE( ns.commands().size() == 6 );
+		REQUIRE( ns.commands()[3].name() == "render.vsync" );
+		REQUIRE( ns.commands()[5].name() == "call_log" );
+	}
+
+	TEST_CASE( "Lazy registration" )
+	{
+		int net_loads = 0, sim_loads = 0, audio_loads = 0;
+
+		const conco::command sim_commands[] = {
+			{ +[]( int ms ) { return ms * 2; }, "net.sim.latency ms" },
+		};
+
+		const conco::command net_commands[] = {
+			{ +[]() { return 7; }, "net.port" },
+		};
+
+		conco::command_namespace ns;
+
+		ns.add_lazy( "net", [&]( conco::command_namespace &n ) {
+			++net_loads;
+			n.add( net_commands );
+			n.add_lazy( "net.sim", [&]( conco::command_namespace &n ) {
+				++sim_loads;
+				n.add( sim_commands );
+			} );
+		} );
+
+		ns.add_lazy( "audio", [&]( conco::command_namespace & ) { ++audio_loads; } );
+
+		REQUIRE( !ns.is_loaded( "net" ) );
+		REQUIRE( !ns.is_loaded( "net.sim" ) );
+		REQUIRE( ns.is_loaded( "log" ) );
+
+		char buffer[32] = { 0 };
+		REQUIRE( ns.execute( "net.port", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "7" );
+		REQUIRE( net_loads == 1 );
+		REQUIRE( sim_loads == 0 );
+		REQUIRE( ns.is_loaded( "net" ) );
+		REQUIRE( !ns.is_loaded( "net.sim.latency" ) );
+
+		REQUIRE( ns.execute( "net.sim.latency 5", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "10" );
+		REQUIRE( ns.execute( "net.sim.latency 6", buffer ) == conco::result::success );
+		REQUIRE( net_loads == 1 );
+		REQUIRE( sim_loads == 1 );
+
+		REQUIRE( ns.execute( "audio.volume 1", buffer ) == conco::result::command_not_found );
+		REQUIRE( ns.execute( "audio.volume 1", buffer ) == conco::result::command_not_found );
+		REQUIRE( audio_loads == 1 );
+	}
+
+	TEST_CASE( "Glob execution" )
+	{
+		std::map<std::string, int> calls;
+		auto counter = [&]( std::string name ) {
+			return [&calls, name]( int x ) { calls[name] += x; };
+		};
+
+		auto reset_net = counter( "stats.net.reset" );
+		auto reset_gpu = counter( "stats.gpu.reset" );
+		auto reset_tcp = counter( "stats.net.tcp.reset" );
+		auto enable_net = counter( "log.net.enable" );
+		auto enable_audio = counter( "log.audio.enable" );
+		auto check_log = []( const conco::context &ctx ) {
+			return conco::execute( ctx.commands, "log.net.level" ) == conco::result::success;
+		};
+
+		const conco::command commands[] = {
+			{ reset_net, "stats.net.reset x=1" },
+			{ reset_gpu, "stats.gpu.reset x=1" },
+			{ reset_tcp, "stats.net.tcp.reset x=1" },
+			{ enable_net, "log.net.enable x" },
+			{ +[]() { return 0; }, "log.net.level" },
+			{ check_log, "check.log" },
+		};
+
+		const conco::command audio_commands[] = {
+			{ enable_audio, "log.audio.enable x" },
+		};
+
+		conco::command_namespace ns( commands );
+		ns.add_lazy( "log.audio", [&]( conco::command_namespace &n ) { n.add( audio_commands ); } );
+
+		std::vector<std::string> executed;
+		auto on_result = [&]( std::string_view name, conco::result r, const conco::output & ) {
+			REQUIRE( r == conco::result::success );
+			executed.emplace_back( name );
+		};
+
+		REQUIRE( ns.execute_glob( "stats.*.reset", on_result ) == 2 );
+		REQUIRE( executed == std::vector<std::string>{ "stats.gpu.reset", "stats.net.reset" } );
+		REQUIRE( calls["stats.net.reset"] == 1 );
+		REQUIRE( calls["stats.net.tcp.reset"] == 0 );
+
+		executed.clear();
+		REQUIRE( ns.execute_glob( "log.*.enable 5", on_result ) == 2 ); // Includes the lazily loaded module
+		REQUIRE( executed == std::vector<std::string>{ "log.audio.enable", "log.net.enable" } );
+		REQUIRE( calls["log.audio.enable"] == 5 );
+		REQUIRE( calls["log.net.enable"] == 5 );
+
+		executed.clear();
+		REQUIRE( ns.execute_glob( "st?ts.n*.*.reset 3", on_result ) == 1 );
+		REQUIRE( calls["stats.net.tcp.reset"] == 3 );
+
+		REQUIRE( ns.execute_glob( "log.net.*", []( std::string_view, conco::result, const conco::output & ) {} ) == 2 );
+		REQUIRE( ns.execute_glob( "nothing.*", on_result ) == 0 );
+
+		// Commands taking `const context &` see all commands
+		char buffer[16] = { 0 };
+		REQUIRE( ns.execute_glob( "check.*", on_result, buffer ) == 1 );
+		REQUIRE( std::string_view( buffer ) == "true" );
+
+		REQUIRE( conco::detail::glob_match( "*a*b", "xxaxxb" ) );
+		REQUIRE( !conco::detail::glob_match( "*a*b", "xxaxxbc" ) );
+	}
+}
+
+enum class quality
+{
+	low,
+	medium,
+	high
+};
+
+constexpr std::string_view quality_names[] = { "high", "low", "medium" };
+
+constexpr std::string_view type_name( conco::tag<quality> ) noexcept { return "quality"; }
+constexpr std::span<const std::string_view> type_keywords( conco::tag<quality> ) noexcept { return quality_names; }
+
+std::optional<quality> from_string( conco::tag<quality>, std::string_view str ) noexcept
+{
+	if ( str == "low" )
+		return quality::low;
+	else if ( str == "medium" )
+		return quality::medium;
+	else if ( str == "high" )
+		return quality::high;
+
+	return std::nullopt;
+}
+
+struct asset_path
+{
+	std::string path;
+};
+
+TEST_SUITE( "Completion" )
+{
+	TEST_CASE( "Command names" )
+	{
+		const conco::command commands[] = {
+			{ +[]( int ) {}, "render.shadows x" },
+			{ +[]( bool ) {}, "render.sharpen enable" },
+			{ +[]( int, int y ) { return y; }, "sum x y=2" },
+			{ +[]( float ) {}, "sum x" },
+			{ +[]() {}, "render.vsync" },
+			{ +[]() {}, "quit" },
+		};
+
+		conco::completer completer( commands );
+
+		const auto &r = completer.complete( "render.sh" );
+		REQUIRE( r.arg_index == -1 );
+		REQUIRE( r.replace_offset == 0 );
+		REQUIRE( r.candidates == std::vector<std::string_view>{ "render.shadows", "render.sharpen" } );
+		REQUIRE( r.common_prefix == "render.sha" );
+		REQUIRE( r.hints.empty() );
+
+		// Narrowed from the previous result
+		completer.complete( "render.shad" );
+		REQUIRE( r.candidates == std::vector<std::string_view>{ "render.shadows" } );
+		REQUIRE( r.hints == std::vector<std::string>{ "render.shadows x:int" } );
+
+		// Back to a shorter prefix
+		completer.complete( "r" );
+		REQUIRE( r.total_count == 3 );
+		REQUIRE( r.common_prefix == "render." );
+
+		completer.complete( "" );
+		REQUIRE( r.total_count == 5 );
+
+		completer.max_candidates = 2;
+		completer.complete( "" );
+		REQUIRE( r.total_count == 5 );
+		REQUIRE( r.candidates == std::vector<std::string_view>{ "quit", "render.shadows" } );
+
+		completer.complete( "x" );
+		REQUIRE( r.candidates.empty() );
+		REQUIRE( r.total_count == 0 );
+
+		completer.complete( "sum" );
+		REQUIRE( r.hints == std::vector<std::string>{ "sum x:int y:int=2", "sum x:float" } );
+	}
+
+	TEST_CASE( "Argument values" )
+	{
+		auto set_quality = []( quality, std::optional<bool> ) {};
+		auto load = []( const conco::context &, asset_path ) {};
+
+		const conco::command commands[] = {
+			{ set_quality, "render.quality q shadows" },
+			{ load, "load path" },
+			{ +[]( int ) {}, "echo x" },
+		};
+
+		conco::completer completer( commands );
+		completer.set_generator( conco::type_info::get<asset_path>(),
+		                         []( std::string_view, std::vector<std::string> &candidates ) {
+			                         candidates = { "models/tree.obj", "models/rock.obj", "textures/bark.png" };
+		                         } );
+
+		const auto &r = completer.complete( "render.quality " );
+		REQUIRE( r.arg_index == 0 );
+		REQUIRE( r.replace_offset == 15 );
+		REQUIRE( r.candidates == std::vector<std::string_view>{ "high", "low", "medium" } );
+		REQUIRE( r.hints == std::vector<std::string>{ "render.quality q:quality shadows:optional" } );
+
+		completer.complete( "render.quality m" );
+		REQUIRE( r.candidates == std::vector<std::string_view>{ "medium" } );
+		REQUIRE( r.replace_offset == 15 );
+
+		completer.complete( "render.quality high o" );
+		REQUIRE( r.arg_index == 1 );
+		REQUIRE( r.candidates == std::vector<std::string_view>{ "off", "on" } );
+		REQUIRE( r.common_prefix == "o" );
+
+		completer.complete( "load models/" );
+		REQUIRE( r.candidates == std::vector<std::string_view>{ "models/rock.obj", "models/tree.obj" } );
+		REQUIRE( r.common_prefix == "models/" );
+
+		completer.complete( "echo " );
+		REQUIRE( r.candidates.empty() );
+		REQUIRE( r.hints == std::vector<std::string>{ "echo x:int" } );
+
+		completer.complete( "unknown " );
+		REQUIRE( r.candidates.empty() );
+		REQUIRE( r.hints.empty() );
+	}
+
+	TEST_CASE( "Large tables" )
+	{
+		std::vector<std::string> names;
+		for ( int i = 0; i < 5000; ++i )
+			names.push_back( "cmd_" + std::to_string( i ) );
+
+		std::vector<conco::command> commands;
+		for ( const auto &name : names )
+			commands.push_back( { +[]() {}, name.c_str() } );
+
+		conco::completer completer( commands );
+
+		std::string line;
+		for ( char ch : std::string_view( "cmd_4999" ) )
+		{
+			line += ch;
+			const auto &r = completer.complete( line );
+
+			auto matches = [&]( const std::string &n ) { return n.starts_with( line ); };
+			REQUIRE( r.total_count == size_t( std::ranges::count_if( names, matches ) ) );
+		}
+	}
+}
+
+TEST_SUITE( "Suggestions" )
+{
+	TEST_CASE( "Edit distance" )
+	{
+		auto levenshtein = []( std::string_view a, std::string_view b ) {
+			std::vector<std::vector<uint32_t>> d( a.size() + 1, std::vector<uint32_t>( b.size() + 1 ) );
+			for ( size_t i = 0; i <= a.size(); ++i )
+				d[i][0] = uint32_t( i );
+			for ( size_t j = 0; j <= b.size(); ++j )
+				d[0][j] = uint32_t( j );
+
+			for ( size_t i = 1; i <= a.size(); ++i )
+				for ( size_t j = 1; j <= b.size(); ++j )
+				{
+					uint32_t cost = a[i - 1] != b[j - 1];
+					d[i][j] = std::min( { d[i - 1][j] + 1, d[i][j - 1] + 1, d[i - 1][j - 1] + cost } );
+				}
+
+			return d[a.size()][b.size()];
+		};
+
+		const std::string long_name = std::string( 70, 'x' ) + "abc";
+		const std::string_view words[] = {
+			"", "a", "ab", "screenshot", "scren_shot", "shot", "restart", "rest", "reset",
+			"net.sim.latency", "net.sim.lat", long_name, std::string_view( long_name ).substr( 2 ),
+		};
+
+		for ( auto a : words )
+		{
+			for ( auto b : words )
+			{
+				uint32_t expected = levenshtein( a, b );
+				REQUIRE( conco::detail::edit_distance( a, b, 100 ) == expected );
+				REQUIRE( conco::detail::edit_distance( a, b, 2 ) == std::min( expected, 3u ) );
+			}
+		}
+	}
+
+	TEST_CASE( "Did you mean" )
+	{
+		const conco::command commands[] = {
+			{ +[]() {}, "screenshot" },
+			{ +[]() {}, "screenshot_hdr" },
+			{ +[]() {}, "restart" },
+			{ +[]() {}, "reset" },
+			{ +[]() {}, "reset" }, // Overload, suggested only once
+			{ +[]() {}, "net.sim.latency" },
+			{ +[]() {}, "ls" },
+		};
+
+		conco::suggester suggester( commands );
+
+		auto names = [&]( std::string_view name, size_t count = 3, uint32_t max_distance = 2 ) {
+			std::vector<std::string_view> out;
+			for ( const auto &s : suggester.suggest( name, count, max_distance ) )
+				out.push_back( s.name );
+
+			return out;
+		};
+
+		REQUIRE( names( "scren_shot" ) == std::vector<std::string_view>{ "screenshot" } );
+		REQUIRE( names( "rest" ) == std::vector<std::string_view>{ "reset" } );
+		REQUIRE( names( "resta" ) == std::vector<std::string_view>{ "reset", "restart" } );
+		REQUIRE( names( "resta", 1 ) == std::vector<std::string_view>{ "reset" } );
+		REQUIRE( names( "net.sim.latncy" ) == std::vector<std::string_view>{ "net.sim.latency" } );
+		REQUIRE( names( "sl" ) == std::vector<std::string_view>{ "ls" } );
+		REQUIRE( names( "completely_unknown" ).empty() );
+		REQUIRE( names( "screenshot_hd", 3, 4 ) == std::vector<std::string_view>{ "screenshot_hdr", "screenshot" } );
+
+		auto s = suggester.suggest( "restrat" );
+		REQUIRE( s.size() == 1 );
+		REQUIRE( s[0].name == "restart" );
+		REQUIRE( s[0].distance == 2 );
+	}
+}
+
+TEST_SUITE( "Console variables" )
+{
+	struct color
+	{
+		double r, g, b;
+	};
+
+	TEST_CASE( "Generated commands" )
+	{
+		conco::cvar<int> quality( "r_quality;Render quality", 2 );
+		conco::cvar<bool> vsync( "r_vsync", true );
+		conco::cvar<color> clear_color( "r_clear_color", { 0.5, 0.5, 1.0 } );
+		conco::cvar<std::string> skybox( "r_skybox", "default" );
+
+		conco::cvar_table cvars;
+		cvars.add( quality );
+		cvars.add( vsync );
+		cvars.add( clear_color );
+		cvars.add( skybox );
+
+		REQUIRE( cvars.commands().size() == 8 );
+		REQUIRE( cvars.vars().size() == 4 );
+		REQUIRE( cvars.vars()[0]->name() == "r_quality" );
+
+		char buffer[64] = { 0 };
+		REQUIRE( conco::execute( cvars.commands(), "r_quality", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "2" );
+		REQUIRE( conco::execute( cvars.commands(), "r_quality 3", buffer ) == conco::result::success );
+		REQUIRE( quality.get() == 3 );
+		REQUIRE( conco::execute( cvars.commands(), "r_quality high", buffer ) == conco::result::success ); // Getter
+		REQUIRE( std::string_view( buffer ) == "3" );
+
+		REQUIRE( conco::execute( cvars.commands(), "r_vsync off", buffer ) == conco::result::success );
+		REQUIRE( vsync.get() == false );
+
+		REQUIRE( conco::execute( cvars.commands(), "r_clear_color {1 0 0.25}", buffer ) == conco::result::success );
+		REQUIRE( clear_color.get().r == 1.0 );
+		REQUIRE( clear_color.get().b == 0.25 );
+
+		REQUIRE( conco::execute( cvars.commands(), "r_skybox night", buffer ) == conco::result::success );
+		REQUIRE( conco::execute( cvars.commands(), "r_skybox", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "\"night\"" );
+
+		skybox.reset();
+		REQUIRE( skybox.get() == "default" );
+	}
+
+	TEST_CASE( "Batched change callbacks" )
+	{
+		conco::cvar<int> a( "a" ), b( "b" ), c( "c" );
+
+		conco::cvar_table cvars;
+		cvars.add( a );
+		cvars.add( b );
+		cvars.add( c );
+
+		std::vector<std::string> changes;
+		a.on_change = [&]( int v ) { changes.push_back( "a=" + std::to_string( v ) ); };
+		b.on_change = [&]( int v ) {
+			changes.push_back( "b=" + std::to_string( v ) );
+			if ( v == 1 )
+				b.set( 2 ); // Queued for the next sync
+		};
+
+		b.set( 1 );
+		a.set( 1 );
+		a.set( 5 ); // Coalesced with the previous change
+		c.set( 1 ); // No callback
+
+		REQUIRE( changes.empty() );
+		REQUIRE( cvars.sync() == 3 );
+		REQUIRE( changes == std::vector<std::string>{ "b=1", "a=5" } );
+
+		REQUIRE( cvars.sync() == 1 );
+		REQUIRE( changes.back() == "b=2" );
+		REQUIRE( cvars.sync() == 0 );
+	}
+
+	TEST_CASE( "Save and load" )
+	{
+		conco::cvar<int> quality( "r_quality", 2 );
+		conco::cvar<bool> vsync( "r_vsync", true );
+		conco::cvar<color> clear_color( "r_clear_color", { 0.5, 0.5, 1.0 } );
+		conco::cvar<std::string> skybox( "r_skybox;Sky texture", "default" );
+		conco::cvar<float> volume( "s_volume", 0.5f );
+
+		conco::cvar_table cvars;
+		cvars.add( quality );
+		cvars.add( vsync );
+		cvars.add( clear_color );
+		cvars.add( skybox );
+		cvars.add( volume );
+
+		REQUIRE( cvars.find( "r_skybox" ) != nullptr );
+		REQUIRE( cvars.find( "r_sky" ) == nullptr );
+
+		std::string config;
+		REQUIRE( cvars.save( config, true ) == 0 );
+		REQUIRE( config.empty() );
+
+		quality.set( 4 );
+		clear_color.set( { 1, 0, 0.25 } );
+		skybox.set( "night sky" );
+
+		REQUIRE( cvars.save( config, true ) == 3 );
+		REQUIRE( config == "r_quality 4\nr_clear_color {1,0,0.25}\nr_skybox \"night sky\"\n" );
+
+		config.clear();
+		REQUIRE( cvars.save( config ) == 5 );
+
+		quality.reset();
+		clear_color.reset();
+		skybox.reset();
+		vsync.set( false );
+		cvars.sync();
+
+		auto r = cvars.load( config );
+		REQUIRE( r.loaded == 5 );
+		REQUIRE( r.unknown == 0 );
+		REQUIRE( r.invalid == 0 );
+
+		REQUIRE( quality.get() == 4 );
+		REQUIRE( vsync.get() == true );
+		REQUIRE( clear_color.get().b == 0.25 );
+		REQUIRE( skybox.get() == "night sky" );
+		REQUIRE( volume.get() == 0.5f );
+		REQUIRE( cvars.sync() == 5 );
+
+		r = cvars.load( "# Comment\n\nr_quality 1\nr_unknown 2\nr_vsync maybe\n// Comment\nr_quality" );
+		REQUIRE( r.loaded == 1 );
+		REQUIRE( r.unknown == 1 );
+		REQUIRE( r.invalid == 2 );
+		REQUIRE( quality.get() == 1 );
+	}
+
+	TEST_CASE( "Concurrent reads" )
+	{
+		conco::cvar<color> value( "value", { 0, 0, 0 } );
+		conco::cvar<int> counter( "counter" );
+
+		conco::cvar_table cvars;
+		cvars.add( value );
+		cvars.add( counter );
+
+		std::atomic<bool> done = false;
+		std::atomic<int> torn_reads = 0;
+
+		std::vector<std::thread> readers;
+		for ( int t = 0; t < 3; ++t )
+		{
+			readers.emplace_back( [&]() {
+				while ( !done.load() )
+				{
+					color c = value.get();
+					if ( c.r != c.g || c.g != c.b )
+						torn_reads.fetch_add( 1 );
+
+					(void)counter.get();
+				}
+			} );
+		}
+
+		for ( int i = 1; i <= 20000; ++i )
+		{
+			value.set( { double( i ), double( i ), double( i ) } );
+			counter.set( i );
+		}
+
+		done = true;
+		for ( auto &t : readers )
+			t.join();
+
+		REQUIRE( torn_reads == 0 );
+		REQUIRE( cvars.sync() == 2 );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_SUITE( "Pipelined execution" )
+{
+	TEST_CASE( "Lines run in order" )
+	{
+		uint64_t state = 0;
+		std::vector<std::string> inline_lines;
+
+		auto mix = [&]( int x, std::string_view tag ) { state = state * 31 + uint64_t( x ) + tag.size(); };
+		auto note = [&]( const conco::context &ctx ) {
+			inline_lines.emplace_back( ctx.raw_command_line );
+			state = state * 7 + 1;
+		};
+
+		std::vector<conco::command> commands = { { mix, "mix x tag=abc" } };
+		commands.push_back( { note, "note" } );
+
+		std::vector<std::string> storage;
+		for ( int i = 0; i < 5000; ++i )
+		{
+			if ( i % 1000 == 500 )
+				storage.push_back( "note " + std::to_string( i ) );
+			else if ( i % 1000 == 700 )
+				storage.push_back( "mix oops" );
+			else
+				storage.push_back( "mix " + std::to_string( i ) + ( i % 2 ? " \"tag\"" : "" ) );
+		}
+
+		std::vector<std::string_view> lines( storage.begin(), storage.end() );
+
+		// Reference run, line by line
+		for ( auto line : lines )
+			conco::execute( commands, line );
+
+		uint64_t expected = std::exchange( state, 0 );
+		inline_lines.clear();
+
+		for ( size_t workers : { 0, 1, 3 } )
+		{
+			state = 0;
+			inline_lines.clear();
+
+			size_t next_index = 0;
+			bool in_order = true;
+			auto caller = std::this_thread::get_id();
+
+			auto r = conco::execute_pipelined(
+			    commands, lines,
+			    [&]( size_t index, conco::result, const conco::output & ) {
+				    in_order = in_order && index == next_index++ && std::this_thread::get_id() == caller;
+			    },
+			    workers, {}, 64 );
+
+			REQUIRE( in_order );
+			REQUIRE( next_index == lines.size() );
+			REQUIRE( state == expected );
+			REQUIRE( r.failed == 5 );
+			REQUIRE( r.prepared + r.parsed_inline == lines.size() );
+			REQUIRE( inline_lines.size() == 5 );
+			REQUIRE( inline_lines[0] == "note 500" );
+
+			if ( workers == 0 )
+				REQUIRE( r.prepared == 0 );
+		}
+	}
+
+	TEST_CASE( "Overloads are resolved like execute()" )
+	{
+		std::vector<std::string> log;
+		auto any = [&]( const conco::context & ) { log.push_back( "any" ); };
+		auto num = [&]( int ) { log.push_back( "num" ); };
+
+		// The first overload cannot be prepared, but `execute()` would pick it
+		std::vector<conco::command> commands = { { any, "cmd" } };
+		commands.push_back( { num, "cmd x" } );
+
+		std::vector<std::string_view> lines( 100, "cmd 1" );
+		auto r = conco::execute_pipelined( commands, lines, []( size_t, conco::result, const conco::output & ) {}, 2 );
+
+		REQUIRE( r.prepared == 0 );
+		REQUIRE( std::ranges::count( log, "any" ) == 100 );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_SUITE( "Scripts" )
+{
+	TEST_CASE( "Variables, loops and conditionals" )
+	{
+		std::vector<std::string> log;
+		std::vector<std::pair<std::string, int>> spawned;
+
+		auto spawn = [&]( std::string_view unit, int x ) { spawned.emplace_back( unit, x ); };
+		auto print = [&]( std::string_view text ) { log.emplace_back( text ); };
+		auto print_line = [&]( const conco::context &ctx ) { log.emplace_back( ctx.raw_command_line ); };
+
+		std::vector<conco::command> commands = { { spawn, "spawn unit x=0" } };
+		commands.push_back( { print, "print text" } );
+		commands.push_back( { print_line, "print_line" } );
+		commands.push_back( { +[]( double x ) { return x * 2; }, "twice x" } );
+
+		std::string_view source = R"(
+# Spawn a row of units
+set count 3
+for i 0 $count {
+  # Don't spawn them all at once
+  spawn orc $i
+}
+
+for i 10 0 -5 { spawn "elite orc" $i }
+
+set x $count * 10
+if $x >= 30 { print big } else if $x { print small } else { print zero }
+if $x == 5 {
+  // Won't print } here
+  print five
+} else {
+  print_line $x "two words" $name
+}
+
+set name "Big Boss"
+print $name
+set half $x / 4
+set fraction 2.5 * $half
+twice $fraction
+spawn $name
+)";
+
+		conco::script s( commands );
+		auto r = s.compile( source );
+		REQUIRE( r );
+
+		char buffer[32] = { 0 };
+		std::vector<std::string> results;
+
+		r = s.run( [&]( std::string_view, conco::result, const conco::output & ) { results.push_back( buffer ); },
+		           buffer );
+
+		REQUIRE( r );
+		REQUIRE( r.failed == 0 );
+		REQUIRE( r.executed == 10 );
+
+		using spawn_log = std::vector<std::pair<std::string, int>>;
+		REQUIRE( spawned == spawn_log{ { "orc", 0 },
+		                               { "orc", 1 },
+		                               { "orc", 2 },
+		                               { "elite orc", 10 },
+		                               { "elite orc", 5 },
+		                               { "Big Boss", 0 } } );
+
+		// `$name` is still empty (none) when `print_line` runs, so it is substituted as an empty string
+		REQUIRE( log == std::vector<std::string>{ "big", "print_line 30 \"two words\" \"\"", "Big Boss" } );
+		REQUIRE( s.variable( "half" )->integer == 7 );
+		REQUIRE( s.variable( "fraction" )->floating == 17.5 );
+		REQUIRE( results[8] == "35" );
+
+		// Variables can be set by the host and keep their values between runs
+		*s.variable( "count" ) = 1;
+		spawned.clear();
+		REQUIRE( s.run() );
+		REQUIRE( spawned.size() == 6 ); // `set count 3` runs again
+		REQUIRE( s.variable( "unknown" ) == nullptr );
+	}
+
+	TEST_CASE( "Prepared invocations" )
+	{
+		int calls = 0;
+		auto add = [&]( int x ) { calls += x; };
+		std::vector<conco::command> commands = { { add, "add x" } };
+
+		conco::script s( commands );
+		REQUIRE( s.compile( "for i 0 1000 {\n  add 2\n  add $i\n}" ) );
+		REQUIRE( s.run() );
+		REQUIRE( calls == 2000 + 999 * 1000 / 2 );
+	}
+
+	TEST_CASE( "Errors" )
+	{
+		int value = 0;
+		auto set_value = [&]( int x ) { value = x; };
+		std::vector<conco::command> commands = { { set_value, "value x" } };
+
+		conco::script s( commands );
+
+		auto r = s.compile( "value 1\nif 1 < { value 2 }" );
+		REQUIRE( !r );
+		REQUIRE( r.line == 2 );
+
+		REQUIRE( !s.compile( "else { value 1 }" ) );
+		REQUIRE( !s.compile( "for i 0 { value 1 }" ) );
+		REQUIRE( !s.compile( "set x 1 ^ 2" ) );
+
+		// Runtime errors stop the script
+		REQUIRE( s.compile( "set x abc\nset y $x + 1\nvalue 5" ) );
+		r = s.run();
+		REQUIRE( !r );
+		REQUIRE( r.line == 2 );
+		REQUIRE( value == 0 );
+
+		REQUIRE( s.compile( "for i 0 10 {\n  set i 0\n}" ) );
+		s.instruction_limit = 1000;
+		REQUIRE( std::string_view( s.run().message ) == "instruction limit exceeded" );
+
+		// Failed commands are counted, but do not stop the script
+		REQUIRE( s.compile( "value abc\nnope\nvalue 3" ) );
+		r = s.run();
+		REQUIRE( r );
+		REQUIRE( r.failed == 2 );
+		REQUIRE( value == 3 );
+
+		// Integers wrap around, quotients which do not fit are errors
+		REQUIRE( s.compile( "set x 9223372036854775807 + 1\nset y -9223372036854775807 - 2\nset z $x * -1" ) );
+		REQUIRE( s.run() );
+		REQUIRE( s.variable( "x" )->integer == std::numeric_limits<int64_t>::min() );
+		REQUIRE( s.variable( "y" )->integer == std::numeric_limits<int64_t>::max() );
+		REQUIRE( s.variable( "z" )->integer == std::numeric_limits<int64_t>::min() );
+
+		for ( const char *source : { "set x -9223372036854775808 / -1", "set x -9223372036854775808 % -1" } )
+		{
+			REQUIRE( s.compile( source ) );
+			REQUIRE( std::string_view( s.run().message ) == "invalid arithmetic operands" );
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_SUITE( "Aliases" )
+{
+	TEST_CASE( "Typed parameters and nested aliases" )
+	{
+		std::vector<std::pair<std::string, int>> spawned;
+		std::vector<double> speeds;
+
+		auto spawn = [&]( std::string_view unit, int x ) { spawned.emplace_back( unit, x ); };
+		auto speed = [&]( double v ) { speeds.push_back( v ); };
+
+		std::vector<conco::command> commands = { { spawn, "spawn unit x" } };
+		commands.push_back( { speed, "speed value" } );
+
+		conco::alias_table aliases( commands );
+		REQUIRE( aliases.define( "pair", "spawn $1 $2; spawn $1 $3" ) );
+		REQUIRE( aliases.define( "squad", "pair orc 1 2\npair $1 $2 $3\nspeed $4" ) );
+		REQUIRE( aliases.contains( "squad" ) );
+
+		REQUIRE( aliases.execute( "squad \"elite orc\" 10 20 2.5" ) == conco::result::success );
+
+		using spawn_log = std::vector<std::pair<std::string, int>>;
+		REQUIRE( spawned == spawn_log{ { "orc", 1 }, { "orc", 2 }, { "elite orc", 10 }, { "elite orc", 20 } } );
+		REQUIRE( speeds == std::vector<double>{ 2.5 } );
+
+		// Redefinition is picked up by callers
+		REQUIRE( aliases.define( "pair", "spawn $1 $2" ) );
+		spawned.clear();
+		REQUIRE( aliases.execute( "squad goblin 5" ) == conco::result::not_enough_arguments );
+		REQUIRE( spawned == spawn_log{ { "orc", 1 }, { "goblin", 5 } } );
+
+		// Scripts in alias bodies
+		REQUIRE( aliases.define( "row", "for i 0 $2 { spawn $1 $i }" ) );
+		spawned.clear();
+		REQUIRE( aliases.execute( "row imp 3" ) == conco::result::success );
+		REQUIRE( spawned == spawn_log{ { "imp", 0 }, { "imp", 1 }, { "imp", 2 } } );
+
+		// Variables are shared by statements of the body, but not by calls
+		REQUIRE( aliases.define( "twice", "set x $2 * 2; pair $1 7\nspawn $1 $x; set x $x + 1" ) );
+		spawned.clear();
+		REQUIRE( aliases.execute( "twice imp 3" ) == conco::result::success );
+		REQUIRE( aliases.execute( "twice imp 4" ) == conco::result::success );
+		REQUIRE( spawned == spawn_log{ { "imp", 7 }, { "imp", 6 }, { "imp", 7 }, { "imp", 8 } } );
+
+		// Plain commands are executed too
+		REQUIRE( aliases.execute( "speed 4" ) == conco::result::success );
+		REQUIRE( speeds.back() == 4.0 );
+	}
+
+	TEST_CASE( "Console commands and errors" )
+	{
+		int total = 0;
+		auto add = [&]( int x ) { total += x; };
+		std::vector<conco::command> commands = { { add, "add x" } };
+
+		conco::alias_table aliases( commands );
+
+		char buffer[64] = { 0 };
+		REQUIRE( aliases.execute( "alias add3 \"add 1; add 2\"", buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "\"ok\"" );
+		REQUIRE( aliases.execute( "add3" ) == conco::result::success );
+		REQUIRE( total == 3 );
+
+		// Recursion is rejected, the previous definition stays
+		REQUIRE( aliases.define( "outer", "add3; add 10" ) );
+		auto r = aliases.define( "add3", "outer" );
+		REQUIRE( !r );
+		REQUIRE( std::string_view( r.message ) == "alias would call itself" );
+		REQUIRE( !aliases.define( "loop", "loop" ) );
+		REQUIRE( !aliases.contains( "loop" ) );
+
+		total = 0;
+		REQUIRE( aliases.execute( "outer" ) == conco::result::success );
+		REQUIRE( total == 13 );
+
+		// Body errors report the statement line
+		r = aliases.define( "broken", "add 1\nif 1 < { add 2 }" );
+		REQUIRE( !r );
+		REQUIRE( r.line == 2 );
+		REQUIRE( !aliases.define( "bad name", "add 1" ) );
+
+		// Removed aliases fail their callers
+		REQUIRE( aliases.execute( "unalias add3" ) == conco::result::success );
+		REQUIRE( !aliases.contains( "add3" ) );
+		REQUIRE( aliases.execute( "outer" ) == conco::result::command_not_found );
+		REQUIRE( aliases.execute( "add3" ) == conco::result::command_not_found );
+
+		REQUIRE( aliases.define( "add3", "add 3" ) );
+		total = 0;
+		REQUIRE( aliases.execute( "outer" ) == conco::result::success );
+		REQUIRE( total == 13 );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_SUITE( "Variable interpolation" )
+{
+	TEST_CASE( "Console variables" )
+	{
+		conco::cvar<int> difficulty( "difficulty", 3 );
+		conco::cvar<std::string> unit( "unit", "elite orc" );
+
+		conco::cvar_table cvars;
+		cvars.add( difficulty );
+		cvars.add( unit );
+
+		std::vector<std::pair<std::string, int>> spawned;
+		std::string text;
+
+		auto spawn = [&]( std::string_view u, int x ) { spawned.emplace_back( u, x ); };
+		auto print = [&]( const std::string &t ) { text = t; };
+
+		std::vector<conco::command> commands = { { spawn, "spawn unit x=$difficulty" } };
+		commands.push_back( { print, "print text" } );
+
+		auto vars = cvars.variables();
+		using spawn_log = std::vector<std::pair<std::string, int>>;
+
+		REQUIRE( conco::execute( commands, "spawn $unit $difficulty", vars ) == conco::result::success );
+		REQUIRE( conco::execute( commands, "spawn u_${difficulty} ${difficulty}0", vars ) == conco::result::success );
+		REQUIRE( conco::execute( commands, "spawn '$unit' 1", vars ) == conco::result::success );
+		REQUIRE( conco::execute( commands, "spawn \\$unit 2", vars ) == conco::result::success );
+		REQUIRE( spawned == spawn_log{ { "elite orc", 3 }, { "u_3", 30 }, { "$unit", 1 }, { "$unit", 2 } } );
+
+		REQUIRE( conco::execute( commands, "print \"${unit}s: $difficulty!\"", vars ) == conco::result::success );
+		REQUIRE( text == "elite orcs: 3!" );
+
+		// Variables are read when the line is executed
+		difficulty.set( 5 );
+		unit.set( "imp" );
+		REQUIRE( conco::execute( commands, "print $unit$difficulty", vars ) == conco::result::success );
+		REQUIRE( text == "imp5" );
+
+		// Default values are not interpolated, unknown variables are argument errors
+		REQUIRE( conco::execute( commands, "spawn $unit", vars ) == conco::result::argument_parsing_error );
+		REQUIRE( conco::execute( commands, "spawn $nope 1", vars ) == conco::result::argument_parsing_error );
+		REQUIRE( conco::execute( commands, "print $nope", vars ) == conco::result::argument_parsing_error );
+		REQUIRE( conco::execute( commands, "print ${nope}_x", vars ) == conco::result::argument_parsing_error );
+	}
+
+	TEST_CASE( "Typed values" )
+	{
+		struct values
+		{
+			std::map<std::string, int, std::less<>> ints;
+			mutable int text_calls = 0;
+		} source = { { { "a", 20 }, { "b", 22 } } };
+
+		conco::variable_source vars = {
+			.source = &source,
+			.text_func = []( const void *s, std::string_view name, std::span<char> buffer ) -> conco::token {
+				auto &v = *static_cast<const values *>( s );
+				++v.text_calls;
+
+				auto iter = v.ints.find( name );
+				if ( iter == v.ints.end() )
+					return std::nullopt;
+
+				auto [ptr, ec] = std::to_chars( buffer.data(), buffer.data() + buffer.size(), iter->second );
+				return ec == std::errc() ? conco::token( std::string_view( buffer.data(), ptr ) ) : std::nullopt;
+			},
+			.value_func = []( const void *s, std::string_view name, const conco::type_info *ti, void *value ) {
+				auto &v = *static_cast<const values *>( s );
+				auto iter = v.ints.find( name );
+				if ( iter == v.ints.end() || ti != conco::type_info::get<int>() )
+					return false;
+
+				*static_cast<int *>( value ) = iter->second;
+				return true;
+			},
+		};
+
+		std::vector<conco::command> commands = { { +[]( int x, int y ) { return x + y; }, "add x y" } };
+		commands.push_back( { +[]( double x ) { return x * 2; }, "twice x" } );
+
+		char buffer[32] = { 0 };
+
+		REQUIRE( conco::execute( commands, "add $a $b", vars, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "42" );
+		REQUIRE( source.text_calls == 0 );
+
+		REQUIRE( conco::execute( commands, "twice $a", vars, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "40" );
+		REQUIRE( source.text_calls == 1 );
+
+		REQUIRE( conco::execute( commands, "add ${a}1 $b", vars, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "223" );
+		REQUIRE( source.text_calls == 2 );
+
+		// Lines without references do not touch the variables
+		REQUIRE( conco::execute( commands, "add 1 2", vars, buffer ) == conco::result::success );
+		REQUIRE( source.text_calls == 2 );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_SUITE( "Nested commands" )
+{
+	struct handle
+	{
+		int id = 0;
+	};
+
+	int handle_conversions = 0;
+
+	std::optional<handle> from_string( conco::tag<handle>, std::string_view str ) noexcept
+	{
+		++handle_conversions;
+		if ( auto id = conco::from_string( conco::tag<int>{}, str ) )
+			return handle{ *id };
+
+		return std::nullopt;
+	}
+
+	bool to_chars( conco::tag<handle>, std::span<char> buffer, handle h ) noexcept
+	{
+		++handle_conversions;
+		return conco::to_chars( conco::tag<int>{}, buffer, h.id ) != 0;
+	}
+
+	TEST_CASE( "Typed results and text conversions" )
+	{
+		std::string greeting;
+		auto greet = [&]( std::string_view name ) { greeting = name; };
+
+		std::vector<conco::command> commands = { { +[]( int x, int y ) { return x + y; }, "sum x y" } };
+		commands.push_back( { +[]( int x, int y ) { return x * y; }, "mul x y" } );
+		commands.push_back( { +[]( double x ) { return x / 2; }, "half x" } );
+		commands.push_back( { +[]( int id ) { return handle{ id }; }, "entity id" } );
+		commands.push_back( { +[]( handle h ) { return handle{ h.id * 10 }; }, "owner entity" } );
+		commands.push_back( { +[]( handle h ) { return h.id; }, "id entity" } );
+		commands.push_back( { +[]() { return std::string( "Big Boss" ); }, "boss" } );
+		commands.push_back( { greet, "greet name" } );
+
+		conco::variable_source none;
+		char buffer[32] = { 0 };
+
+		REQUIRE( conco::execute( commands, "sum (mul 2 3) 4", none, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "10" );
+
+		REQUIRE( conco::execute( commands, "sum $(mul 2 (sum 1 2)) (sum (sum 1 1) 1)", none, buffer ) ==
+		         conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "9" );
+
+		// Results of the argument storage type are passed as they are
+		handle_conversions = 0;
+		REQUIRE( conco::execute( commands, "id (owner (owner (entity 7)))", none, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "700" );
+		REQUIRE( handle_conversions == 0 );
+
+		// Other results are converted through text
+		REQUIRE( conco::execute( commands, "half (mul 3 5)", none, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "7.5" );
+		REQUIRE( conco::execute( commands, "id (sum 2 3)", none, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "5" );
+		REQUIRE( handle_conversions == 1 );
+
+		REQUIRE( conco::execute( commands, "greet $(boss)", none ) == conco::result::success );
+		REQUIRE( greeting == "Big Boss" );
+		REQUIRE( conco::execute( commands, "greet unit_$(mul 2 3)_$(boss)", none ) == conco::result::success );
+		REQUIRE( greeting == "unit_6_Big Boss" );
+		REQUIRE( conco::execute( commands, "greet '(boss)'", none ) == conco::result::success );
+		REQUIRE( greeting == "(boss)" );
+
+		// Plain `execute()` does not evaluate nested commands
+		REQUIRE( conco::execute( commands, "greet (boss)" ) == conco::result::success );
+		REQUIRE( greeting == "(boss)" );
+	}
+
+	int counter_calls = 0;
+
+	TEST_CASE( "Nested commands are executed once for all overloads" )
+	{
+		std::string label;
+		auto label_n = [&]( std::string_view l, int ) { label = l; };
+		auto label_1 = [&]( std::string_view l ) { label = l; };
+
+		std::vector<conco::command> commands = { { +[]() { return ++counter_calls; }, "counter" } };
+		commands.push_back( { +[]( handle h, int y ) { return h.id + y; }, "show h y" } );
+		commands.push_back( { +[]( double x ) { return x; }, "show x" } );
+		commands.push_back( { +[]( int x, int y ) { return x + y; }, "twice x y" } );
+		commands.push_back( { +[]( int x ) { return x * 2; }, "twice x" } );
+		commands.push_back( { +[]( int x, int y ) { return x - y; }, "half x y" } );
+		commands.push_back( { +[]( double x ) { return x / 2; }, "half x" } );
+		commands.push_back( { label_n, "label l n" } );
+		commands.push_back( { label_1, "label l" } );
+
+		conco::variable_source none;
+		char buffer[32] = { 0 };
+
+		// Text result parsed by each overload
+		REQUIRE( conco::execute( commands, "show (counter)", none, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "1" );
+		REQUIRE( counter_calls == 1 );
+
+		// Typed result reused
+		REQUIRE( conco::execute( commands, "twice (counter)", none, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "4" );
+		REQUIRE( counter_calls == 2 );
+
+		// Typed result stringified for an overload of another type
+		REQUIRE( conco::execute( commands, "half $(counter)", none, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "1.5" );
+		REQUIRE( counter_calls == 3 );
+
+		REQUIRE( conco::execute( commands, "label unit_$(counter)", none ) == conco::result::success );
+		REQUIRE( label == "unit_4" );
+		REQUIRE( counter_calls == 4 );
+	}
+
+	TEST_CASE( "Variables and errors" )
+	{
+		conco::cvar<int> level( "level", 4 );
+		conco::cvar_table cvars;
+		cvars.add( level );
+
+		std::vector<conco::command> commands = { { +[]( int x, int y ) { return x + y; }, "sum x y" } };
+		commands.push_back( { +[]( int x, int y ) { return x * y; }, "mul x y" } );
+
+		char buffer[32] = { 0 };
+
+		REQUIRE( conco::execute( commands, "sum (mul $level $level) ${level}0", cvars.variables(), buffer ) ==
+		         conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "56" );
+
+		auto vars = cvars.variables();
+		REQUIRE( conco::execute( commands, "sum (nope) 1", vars ) == conco::result::argument_parsing_error );
+		REQUIRE( conco::execute( commands, "sum (mul 2) 1", vars ) == conco::result::argument_parsing_error );
+		REQUIRE( conco::execute( commands, "sum (mul 2 3 1", vars ) == conco::result::argument_parsing_error );
+
+		// Nesting depth is limited
+		auto nested = []( int depth ) {
+			std::string line = "sum 1 1";
+			for ( int i = 0; i < depth; ++i )
+				line = "sum 1 (" + line + ")";
+
+			return line;
+		};
+
+		REQUIRE( conco::execute( commands, nested( 15 ), vars, buffer ) == conco::result::success );
+		REQUIRE( std::string_view( buffer ) == "17" );
+		REQUIRE( conco::execute( commands, nested( 20 ), vars, buffer ) == conco::result::argument_parsing_error );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+TEST_SUITE( "Script images" )
+{
+	TEST_CASE( "Compile and execute" )
+	{
+		int volume = 0;
+		float gamma = 0.0f;
+		bool vsync = false;
+		std::string name;
+		std::vector<std::string> log;
+
+		auto set_name = [&]( std::string_view n ) { name = n; };
+		auto echo = [&]( const conco::context &ctx ) { log.emplace_back( ctx.raw_command_line ); };
+
+		const conco::command commands[] = {
+			{ +[]( int x, int y ) { return x + y; }, "sum x y=100" },
+			{ set_name, "name n" },
+			{ echo, "echo" },
+			{ +[]( point p ) { return p.x * p.y; }, "area p" },
+		};
+
+		auto set_volume = [&]( int v ) { volume = v; };
+		auto set_gamma = [&]( float g ) { gamma = g; };
+		auto set_vsync = [&]( bool v ) { vsync = v; };
+
+		std::vector<conco::command> all( std::begin( commands ), std::end( commands ) );
+		all.push_back( { set_volume, "volume v" } );
+		all.push_back( { set_gamma, "gamma g" } );
+		all.push_back( { set_vsync, "vsync v" } );
+
+		std::string_view script = "# Video\r\n"
+		                          "gamma 2.25\r\n"
+		                          "vsync on\n"
+		                          "\n"
+		                          "volume 0x20\n"
+		                          "name \"Player One\"\n"
+		                          "echo hello\n"
+		                          "area {2, 3}\n"
+		                          "sum 1\n"
+		                          "sum x\n"
+		                          "missing 1\n";
+
+		std::vector<std::byte> image;
+		REQUIRE( conco::compile_image( all, script, image ) );
+
+		auto header = conco::read_image_header( image );
+		REQUIRE( header.has_value() );
+		REQUIRE( header->statement_count == 9 );
+
+		char buffer[64] = { 0 };
+		std::vector<std::string> results;
+
+		auto r = conco::execute_image(
+		    all, image,
+		    [&]( size_t, conco::result res, const conco::output & ) {
+			    results.push_back( res == conco::result::success ? std::string( buffer ) : "!" );
+		    },
+		    buffer );
+
+		REQUIRE( r.valid );
+		REQUIRE( !r.text_fallback );
+		REQUIRE( r.executed == 9 );
+		REQUIRE( r.failed == 2 );
+
+		REQUIRE( gamma == 2.25f );
+		REQUIRE( vsync );
+		REQUIRE( volume == 32 );
+		REQUIRE( name == "Player One" ); // String argument is a view into the image
+		REQUIRE( log == std::vector<std::string>{ "echo hello" } );
+		REQUIRE( results[5] == "6" );
+		REQUIRE( results[6] == "101" );
+		REQUIRE( results[7] == "!" );
+		REQUIRE( results[8] == "!" );
+	}
+
+	TEST_CASE( "Changed command table falls back to text" )
+	{
+		int value = 0;
+		auto set = [&]( int v ) { value = v; };
+		auto add = [&]( int v ) { value += v; };
+
+		std::vector<conco::command> commands = { { set, "set v" }, { add, "add v" } };
+
+		std::vector<std::byte> image;
+		REQUIRE( conco::compile_image( commands, "set 5\nadd 2", image ) );
+
+		// A new command shifts the indices the image was compiled with
+		std::vector<conco::command> changed = { { add, "add v" } };
+		changed.push_back( { set, "set v" } );
+		REQUIRE( conco::command_table_hash( changed ) != conco::command_table_hash( commands ) );
+
+		auto r = conco::execute_image( changed, image );
+		REQUIRE( r.valid );
+		REQUIRE( r.text_fallback );
+		REQUIRE( r.executed == 2 );
+		REQUIRE( value == 7 );
+
+		value = 0;
+		r = conco::execute_image( commands, image );
+		REQUIRE( !r.text_fallback );
+		REQUIRE( value == 7 );
+
+		// Truncated and corrupted images are rejected
+		image.resize( image.size() - 1 );
+		REQUIRE( !conco::execute_image( commands, image ).valid );
+		image[0] = std::byte{ 0 };
+		REQUIRE( conco::execute_image( commands, image ).executed == 0 );
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+#if defined( __linux__ )
+
+TEST_SUITE( "Remote console server" )
+{
+	TEST_CASE( "Unix domain socket sessions" )
+	{
+		const conco::command commands[] = {
+			{ +[]( int x, int y ) { return x + y; }, "sum x y" },
+		};
+
+		conco::server *srv_ptr = nullptr;
+		conco::server srv( [&]( conco::server::request &&req ) {
+			char buffer[64] = { 0 };
+			auto r = conco::execute( commands, req.line, buffer );
+			srv_ptr->reply( req.session, r == conco::result::success ? buffer : to_string( r ) );
+		} );
+		srv_ptr = &srv;
+
+		std::string path = "/tmp/conco_test_" + std::to_string( getpid() ) + ".sock";
+		REQUIRE( srv.listen_unix( path.c_str() ) );
+
+		auto connect_client = [&]() {
+			int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+			sockaddr_un addr = {};
+			addr.sun_family = AF_UNIX;
+			std::strcpy( addr.sun_path, path.c_str() );
+			REQUIRE( connect( fd, reinterpret_cast<sockaddr *>( &addr ), sizeof( addr ) ) == 0 );
+			return fd;
+		};
+
+		auto receive = [&]( int fd, size_t lines ) {
+			std::string text;
+			char chunk[256];
+			for ( int i = 0; i < 100 && size_t( std::ranges::count( text, '\n' ) ) < lines; ++i )
+			{
+				srv.poll( 10 );
+				ssize_t len = recv( fd, chunk, sizeof( chunk ), MSG_DONTWAIT );
+				if ( len > 0 )
+					text.append( chunk, len );
+			}
+			return text;
+		};
+
+		int a = connect_client();
+		int b = connect_client();
+
+		std::string_view request_a = "# comment\nsum 1 2\nsum {3\n} 4\n  // sum 5 5\nfoo\n";
+		send( a, request_a.data(), request_a.size(), 0 );
+		send( b, "sum 10 ", 7, 0 );
+		srv.poll( 10 );
+		send( b, "20\r\n", 4, 0 );
+
+		REQUIRE( receive( a, 3 ) == "3\n7\ncommand_not_found\n" );
+		REQUIRE( receive( b, 1 ) == "30\n" );
+		REQUIRE( srv.session_count() == 2 );
+
+		// Replies are still delivered after the client has finished sending, the last line needs no newline
+		int c = connect_client();
+		send( c, "sum 5 6\nsum 1 1", 15, 0 );
+		shutdown( c, SHUT_WR );
+
+		REQUIRE( receive( c, 2 ) == "11\n2\n" );
+		srv.poll( 10 );
+		REQUIRE( srv.session_count() == 2 );
+
+		close( a );
+		close( b );
+		close( c );
+		receive( a, 1 );
+		REQUIRE( srv.session_count() == 0 );
+
+		// A socket another server is listening on is not replaced, a stale one is
+		conco::server other( [&]( conco::server::request && ) {} );
+		REQUIRE( !other.listen_unix( path.c_str() ) );
+		close( connect_client() );
+
+		srv.close();
+		REQUIRE( other.listen_unix( path.c_str() ) );
+		close( connect_client() );
+
+		unlink( path.c_str() );
+
+		// Only stale sockets are replaced, not other files
+		std::string file_path = path + ".txt";
+		close( open( file_path.c_str(), O_CREAT | O_WRONLY, 0600 ) );
+		REQUIRE( !srv.listen_unix( file_path.c_str() ) );
+		REQUIRE( access( file_path.c_str(), F_OK ) == 0 );
+		unlink( file_path.c_str() );
+	}
+}
+
+TEST_SUITE( "Shared-memory command ring" )
+{
+	TEST_CASE( "Requests and responses" )
+	{
+		const conco::command commands[] = {
+			{ +[]( int x, int y ) { return x + y; }, "sum x y" },
+		};
+
+		conco::shm_channel host;
+		REQUIRE( host.create_memfd( 4096 ) );
+
+		conco::shm_channel client; // Separate mapping of the same segment, as in another process
+		REQUIRE( client.attach( dup( host.fd() ) ) );
+
+		std::byte request[64];
+		conco::binary_writer writer{ request };
+		REQUIRE( writer.request( "sum", 30, 40 ) );
+
+		REQUIRE( client.submit( "sum 1 2", 1 ) );
+		REQUIRE( client.submit( "xsum 1 2", 2 ) );
+		REQUIRE( client.submit_binary( writer.bytes(), 3 ) );
+
+		char buffer[64] = { 0 };
+		REQUIRE( host.requests.wait( 0 ) );
+		REQUIRE( host.drain( commands, 2, buffer ) == 2 );
+		REQUIRE( host.drain( commands, 2, buffer ) == 1 );
+		REQUIRE( host.requests.empty() );
+
+		std::string received;
+		REQUIRE( client.responses.wait( 0 ) );
+		client.receive( [&]( conco::result r, uint64_t id, std::string_view text ) {
+			received += std::to_string( id ) + ":" + std::string( to_string( r ) ) + ":" + std::string( text ) + " ";
+		} );
+
+		REQUIRE( received == "1:success:3 2:command_not_found: 3:success:70 " );
+	}
+
+	TEST_CASE( "Wrap-around and wake-up" )
+	{
+		const conco::command commands[] = {
+			{ +[]( int x ) { return x; }, "echo x" },
+		};
+
+		conco::shm_channel host;
+		REQUIRE( host.create_memfd( 4096 ) );
+
+		constexpr int count = 2000;
+
+		conco::shm_channel client;
+		REQUIRE( client.attach( dup( host.fd() ) ) );
+
+		std::thread producer( [&]() {
+			for ( int i = 0; i < count; ++i )
+			{
+				std::string line = "echo " + std::to_string( i );
+				while ( !client.submit( line, i ) )
+					std::this_thread::yield();
+			}
+		} );
+
+		char buffer[64] = { 0 };
+		int received = 0;
+		int expected_id = 0;
+
+		while ( received < count )
+		{
+			host.requests.wait( 100 );
+			host.drain( commands, 100, buffer );
+
+			host.receive( [&]( conco::result r, uint64_t id, std::string_view text ) {
+				CHECK( r == conco::result::success );
+				CHECK( id == uint64_t( expected_id ) );
+				CHECK( text == std::to_string( expected_id ) );
+				++expected_id;
+				++received;
+			} );
+		}
+
+		producer.join();
+		REQUIRE( received == count );
+	}
+
+	TEST_CASE( "Named segments and corrupted records" )
+	{
+		const conco::command commands[] = {
+			{ +[]( int x ) { return x; }, "echo x" },
+		};
+
+		std::string name = "/conco_test_" + std::to_string( getpid() );
+		conco::shm_channel::remove( name.c_str() );
+
+		conco::shm_channel host;
+		REQUIRE( host.create( name.c_str(), 4096 ) );
+
+		conco::shm_channel other; // Existing segments are never reused
+		REQUIRE( !other.create( name.c_str(), 4096 ) );
+
+		conco::shm_channel client;
+		REQUIRE( client.open( name.c_str() ) );
+		REQUIRE( conco::shm_channel::remove( name.c_str() ) );
+
+		// Record size reaching past the end of the ring
+		REQUIRE( client.submit( "echo 1", 1 ) );
+		reinterpret_cast<conco::shm_record *>( client.requests.data )->size.store( 100000 );
+
+		char buffer[64] = { 0 };
+		REQUIRE( host.drain( commands, 10, buffer ) == 0 );
+		REQUIRE( host.is_corrupted() );
+		REQUIRE( !client.is_corrupted() );
+	}
+
+	TEST_CASE( "Single client and segment size" )
+	{
+		conco::shm_channel host;
+		REQUIRE( host.create_memfd( 4096 ) );
+
+		conco::shm_channel client, other;
+		REQUIRE( client.attach( dup( host.fd() ) ) );
+		REQUIRE( !other.attach( dup( host.fd() ) ) );
+
+		client.close();
+		REQUIRE( other.attach( dup( host.fd() ) ) );
+
+		// Client which exited without closing the channel
+		other.close();
+		uint32_t dead_pid = 0x7FFFFFFF;
+		REQUIRE( pwrite( host.fd(), &dead_pid, sizeof( dead_pid ), 4 ) == sizeof( dead_pid ) );
+		REQUIRE( client.attach( dup( host.fd() ) ) );
+		client.close();
+
+		// Segment smaller than its header claims is never mapped
+		REQUIRE( ftruncate( host.fd(), 4096 ) == 0 );
+		REQUIRE( !client.attach( dup( host.fd() ) ) );
+	}
+}
+
+TEST_SUITE( "Memory-mapped files" )
+{
+	TEST_CASE( "Mapped script image" )
+	{
+		int value = 0;
+		auto add = [&]( int v ) { value += v; };
+		const conco::command commands[] = { { add, "add v" } };
+
+		std::vector<std::byte> image;
+		REQUIRE( conco::compile_image( commands, "add 1\nadd 2\nadd 3\n", image ) );
+
+		auto path = std::filesystem::temp_directory_path() / "conco_mapped_image.cci";
+		std::ofstream( path, std::ios::binary ).write( reinterpret_cast<const char *>( image.data() ), image.size() );
+
+		conco::mapped_file file( path.c_str() );
+		REQUIRE( file );
+		REQUIRE( file.bytes().size() == image.size() );
+
+		auto r = conco::execute_image( commands, file.bytes() );
+		REQUIRE( r.valid );
+		REQUIRE( r.executed == 3 );
+		REQUIRE( value == 6 );
+
+		conco::mapped_file moved = std::move( file );
+		REQUIRE( !file );
+		REQUIRE( moved.text().size() == image.size() );
+
+		moved.close();
+		std::filesystem::remove( path );
+
+		REQUIRE( !conco::mapped_file( path.c_str() ) );
+	}
+
+	TEST_CASE( "Execute file" )
+	{
+		std::vector<std::string> executed;
+		auto sink = [&]( std::string_view statement, conco::result r, const conco::output & ) {
+			executed.push_back( std::string( statement ) + ( r == conco::result::success ? "" : " !" ) );
+		};
+
+		const conco::command commands[] = {
+			{ +[]( int x, int y ) { return x + y; }, "sum x y" },
+			{ +[]( point p ) { return p.x * p.y; }, "area p" },
+		};
+
+		auto path = std::filesystem::temp_directory_path() / "conco_execute_file.cfg";
+		std::ofstream( path, std::ios::binary ) << "# Don't touch\r\nsum 1 2\r\n\narea {\n  2,\n  3\n}\nnope\nsum 3 4";
+
+		char buffer[32] = { 0 };
+		auto r = conco::execute_file( commands, path.c_str(), sink, buffer );
+		REQUIRE( r.opened );
+		REQUIRE( r.mapped );
+		REQUIRE( r.executed == 4 );
+		REQUIRE( r.failed == 1 );
+		REQUIRE( executed == std::vector<std::string>{ "sum 1 2", "area {\n  2,\n  3\n}", "nope !", "sum 3 4" } );
+		REQUIRE( std::string_view( buffer ) == "7" );
+
+		std::filesystem::remove( path );
+		REQUIRE( !conco::execute_file( commands, path.c_str(), sink ).opened );
+	}
+
+	TEST_CASE( "Stream through a fixed-size buffer" )
+	{
+		int total = 0;
+		auto add = [&]( int x ) { total += x; };
+		const conco::command commands[] = { { add, "add x" } };
+
+		int fds[2];
+		REQUIRE( ::pipe( fds ) == 0 );
+
+		std::thread writer( [&]() {
+			std::string text;
+			for ( int i = 1; i <= 1000; ++i )
+				text += "add " + std::to_string( i ) + "\n";
+
+			text += "add \"" + std::string( 100, '1' ) + "\"\nadd 5";
+
+			for ( size_t i = 0; i < text.size(); i += 7 ) // Small chunks
+				(void)::write( fds[1], text.data() + i, std::min<size_t>( 7, text.size() - i ) );
+
+			::close( fds[1] );
+		} );
+
+		size_t count = 0;
+		auto r = conco::execute_stream(
+		    commands, fds[0], [&]( std::string_view, conco::result, const conco::output & ) { ++count; }, {}, 32 );
+
+		writer.join();
+		::close( fds[0] );
+
+		REQUIRE( r.opened );
+		REQUIRE( !r.mapped );
+		REQUIRE( r.too_long == 1 );
+		REQUIRE( r.executed == 1001 );
+		REQUIRE( count == 1001 );
+		REQUIRE( total == 500500 + 5 );
+	}
+}
+
+#endif